@@ -0,0 +1,123 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/cont.h"
+#include "../src/utils/stopwatch.c"
+#include "../src/utils/hash.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*  This program simulates the routing of replies in XREP socket. Peers are
+    assigned consecutive keys and added to the hash table, then replies are
+    routed to randomly chosen peers. The time of the slowest insertion is
+    reported along with the average lookup time. */
+
+struct peer {
+    struct nn_hash_item item;
+    uint32_t flags;
+};
+
+/*  Simple deterministic generator so that the runs are comparable. */
+static uint32_t seed = 0x12345678;
+static uint32_t next_random (void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+int main (int argc, char *argv [])
+{
+    int i;
+    int peers;
+    int lookups;
+    uint32_t sum;
+    struct peer *peer;
+    struct nn_hash_item *item;
+    struct nn_hash hash;
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    uint64_t insert_total;
+    uint64_t insert_max;
+
+    if (argc != 3) {
+        printf ("usage: hash_lat <peers> <lookups>\n");
+        return 1;
+    }
+
+    peers = atoi (argv [1]);
+    lookups = atoi (argv [2]);
+    assert (peers > 0 && lookups > 0);
+
+    nn_alloc_init ();
+    nn_hash_init (&hash);
+
+    /*  Connect the peers. */
+    insert_total = 0;
+    insert_max = 0;
+    for (i = 0; i != peers; ++i) {
+        peer = malloc (sizeof (struct peer));
+        assert (peer);
+        nn_hash_item_init (&peer->item);
+        peer->flags = 1;
+        nn_stopwatch_init (&stopwatch);
+        nn_hash_insert (&hash, i, &peer->item);
+        elapsed = nn_stopwatch_term (&stopwatch);
+        insert_total += elapsed;
+        if (elapsed > insert_max)
+            insert_max = elapsed;
+    }
+
+    /*  Route the replies. */
+    sum = 0;
+    nn_stopwatch_init (&stopwatch);
+    for (i = 0; i != lookups; ++i) {
+        item = nn_hash_get (&hash, next_random () % peers);
+        peer = nn_cont (item, struct peer, item);
+        sum += peer->flags;
+    }
+    elapsed = nn_stopwatch_term (&stopwatch);
+    assert (sum == (uint32_t) lookups);
+
+    /*  Disconnect the peers. */
+    for (i = 0; i != peers; ++i) {
+        item = nn_hash_get (&hash, i);
+        peer = nn_cont (item, struct peer, item);
+        nn_hash_erase (&hash, &peer->item);
+        nn_hash_item_term (&peer->item);
+        free (peer);
+    }
+    nn_hash_term (&hash);
+    nn_alloc_term ();
+
+    printf ("peers: %d\n", peers);
+    printf ("lookups: %d\n", lookups);
+    printf ("total insertion time: %d [us]\n", (int) insert_total);
+    printf ("slowest insertion: %d [us]\n", (int) insert_max);
+    printf ("average lookup time: %.1f [ns]\n",
+        (double) elapsed * 1000 / lookups);
+
+    return 0;
+}
@@ -34,6 +34,24 @@
 
 static size_t message_size;
 static int message_count;
+static int batch;
+
+static struct nn_mmsghdr *alloc_hdrs (struct nn_iovec *iov, void *buf)
+{
+    int i;
+    struct nn_mmsghdr *hdrs;
+
+    /*  All the messages in the batch use the same buffer. */
+    iov->iov_base = buf;
+    iov->iov_len = message_size;
+    hdrs = calloc (batch, sizeof (struct nn_mmsghdr));
+    assert (hdrs);
+    for (i = 0; i != batch; i++) {
+        hdrs [i].msg_hdr.msg_iov = iov;
+        hdrs [i].msg_hdr.msg_iovlen = 1;
+    }
+    return hdrs;
+}
 
 void worker (void *arg)
 {
@@ -41,6 +59,8 @@ void worker (void *arg)
     int s;
     int i;
     char *buf;
+    struct nn_iovec iov;
+    struct nn_mmsghdr *hdrs;
 
     s = nn_socket (AF_SP, NN_PAIR);
     assert (s != -1);
@@ -54,9 +74,20 @@ void worker (void *arg)
     rc = nn_send (s, NULL, 0, 0);
     assert (rc == 0);
 
-    for (i = 0; i != message_count; i++) {
-        rc = nn_send (s, buf, message_size, 0);
-        assert (rc == message_size);
+    if (batch > 1) {
+        hdrs = alloc_hdrs (&iov, buf);
+        for (i = 0; i != message_count; i += rc) {
+            rc = nn_sendmmsg (s, hdrs, message_count - i < batch ?
+                message_count - i : batch, 0);
+            assert (rc > 0);
+        }
+        free (hdrs);
+    }
+    else {
+        for (i = 0; i != message_count; i++) {
+            rc = nn_send (s, buf, message_size, 0);
+            assert (rc == message_size);
+        }
     }
 
     free (buf);
@@ -70,19 +101,23 @@ int main (int argc, char *argv [])
     int s;
     int i;
     char *buf;
+    struct nn_iovec iov;
+    struct nn_mmsghdr *hdrs;
     struct nn_thread thread;
     struct nn_stopwatch stopwatch;
     uint64_t elapsed;
     unsigned long throughput;
     double megabits;
 
-    if (argc != 3) {
-        printf ("usage: thread_thr <message-size> <message-count>\n");
+    if (argc != 3 && argc != 4) {
+        printf ("usage: thread_thr <message-size> <message-count> "
+            "[batch]\n");
         return 1;
     }
 
     message_size = atoi (argv [1]);
     message_count = atoi (argv [2]);
+    batch = argc == 4 ? atoi (argv [3]) : 1;
 
     s = nn_socket (AF_SP, NN_PAIR);
     assert (s != -1);
@@ -100,9 +135,20 @@ int main (int argc, char *argv [])
 
     nn_stopwatch_init (&stopwatch);
 
-    for (i = 0; i != message_count; i++) {
-        rc = nn_recv (s, buf, message_size, 0);
-        assert (rc == message_size);
+    if (batch > 1) {
+        hdrs = alloc_hdrs (&iov, buf);
+        for (i = 0; i != message_count; i += rc) {
+            rc = nn_recvmmsg (s, hdrs, message_count - i < batch ?
+                message_count - i : batch, 0);
+            assert (rc > 0);
+        }
+        free (hdrs);
+    }
+    else {
+        for (i = 0; i != message_count; i++) {
+            rc = nn_recv (s, buf, message_size, 0);
+            assert (rc == message_size);
+        }
     }
 
     elapsed = nn_stopwatch_term (&stopwatch);
@@ -41,8 +41,9 @@ int main (int argc, char *argv [])
     int i;
     int opt;
 
-    if (argc != 4) {
-        printf ("usage: local_lat <bind-to> <msg-size> <roundtrips>\n");
+    if (argc != 4 && argc != 5) {
+        printf ("usage: local_lat <bind-to> <msg-size> <roundtrips> "
+            "[busy-poll-us]\n");
         return 1;
     }
     bind_to = argv [1];
@@ -54,6 +55,12 @@ int main (int argc, char *argv [])
     opt = 1;
     rc = nn_setsockopt (s, NN_TCP, NN_TCP_NODELAY, &opt, sizeof (opt));
     assert (rc == 0);
+    if (argc == 5) {
+        opt = atoi (argv [4]);
+        rc = nn_setsockopt (s, NN_SOL_SOCKET, NN_BUSY_POLL, &opt,
+            sizeof (opt));
+        assert (rc == 0);
+    }
     rc = nn_bind (s, bind_to);
     assert (rc >= 0);
 
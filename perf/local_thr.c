@@ -39,18 +39,24 @@ int main (int argc, char *argv [])
     int s;
     int rc;
     int i;
+    int batch;
+    struct nn_iovec iov;
+    struct nn_mmsghdr *hdrs;
     struct nn_stopwatch sw;
     uint64_t total;
     uint64_t thr;
     double mbs;
+    uint64_t efdcalls;
 
-    if (argc != 4) {
-        printf ("usage: local_thr <bind-to> <msg-size> <msg-count>\n");
+    if (argc != 4 && argc != 5) {
+        printf ("usage: local_thr <bind-to> <msg-size> <msg-count> "
+            "[batch]\n");
         return 1;
     }
     bind_to = argv [1];
     sz = atoi (argv [2]);
     count = atoi (argv [3]);
+    batch = argc == 5 ? atoi (argv [4]) : 1;
 
     s = nn_socket (AF_SP, NN_PAIR);
     assert (s != -1);
@@ -60,13 +66,35 @@ int main (int argc, char *argv [])
     buf = malloc (sz);
     assert (buf);
 
+    /*  All the messages in the batch are received into the same buffer. */
+    hdrs = NULL;
+    if (batch > 1) {
+        iov.iov_base = buf;
+        iov.iov_len = sz;
+        hdrs = calloc (batch, sizeof (struct nn_mmsghdr));
+        assert (hdrs);
+        for (i = 0; i != batch; i++) {
+            hdrs [i].msg_hdr.msg_iov = &iov;
+            hdrs [i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
     nbytes = nn_recv (s, buf, sz, 0);
     assert (nbytes == 0);
 
     nn_stopwatch_init (&sw);
-    for (i = 0; i != count; i++) {
-        nbytes = nn_recv (s, buf, sz, 0);
-        assert (nbytes == sz);
+    if (hdrs) {
+        for (i = 0; i != count; i += rc) {
+            rc = nn_recvmmsg (s, hdrs, count - i < batch ? count - i : batch,
+                0);
+            assert (rc > 0);
+        }
+    }
+    else {
+        for (i = 0; i != count; i++) {
+            nbytes = nn_recv (s, buf, sz, 0);
+            assert (nbytes == sz);
+        }
     }
     total = nn_stopwatch_term (&sw);
     if (total == 0)
@@ -80,6 +108,12 @@ int main (int argc, char *argv [])
     printf ("throughput: %d [msg/s]\n", (int) thr);
     printf ("throughput: %.3f [Mb/s]\n", (double) mbs);
 
+    sz = sizeof (efdcalls);
+    rc = nn_getsockopt (s, NN_SOL_SOCKET, NN_EFDCALLS, &efdcalls, &sz);
+    assert (rc == 0);
+    printf ("efd syscalls: %d\n", (int) efdcalls);
+
+    free (hdrs);
     free (buf);
 
     rc = nn_close (s);
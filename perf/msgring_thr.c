@@ -0,0 +1,206 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/mutex.c"
+#include "../src/utils/atomic.c"
+#include "../src/utils/glock.c"
+#include "../src/utils/sem.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/wire.c"
+#include "../src/utils/slab.c"
+#include "../src/utils/chunk.c"
+#include "../src/utils/chunkref.c"
+#include "../src/utils/msg.c"
+#include "../src/utils/stopwatch.c"
+#include "../src/transports/inproc/msgqueue.c"
+#include "../src/transports/inproc/msgring.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*  This program compares the throughput of passing messages between two
+    threads using mutex-guarded nn_msgqueue and using wait-free nn_msgring.
+    In both cases, the receiving thread is woken up by a semaphore when it
+    finds the queue empty. */
+
+#define RING_SIZE 1024
+
+/*  The writer publishes the messages to the ring in batches of this size. */
+#define RING_BATCH 32
+
+static size_t message_size;
+static int message_count;
+
+static struct nn_mutex queue_sync;
+static struct nn_msgqueue queue;
+static int sleeping;
+
+static struct nn_msgring ring;
+
+static struct nn_sem readable;
+static struct nn_sem writable;
+
+static void msgqueue_writer (void *arg)
+{
+    int rc;
+    int i;
+    int wake;
+    struct nn_msg msg;
+
+    for (i = 0; i != message_count; ++i) {
+        nn_msg_init (&msg, message_size);
+        nn_mutex_lock (&queue_sync);
+        rc = nn_msgqueue_send (&queue, &msg);
+        assert (rc == 0);
+        wake = sleeping;
+        sleeping = 0;
+        nn_mutex_unlock (&queue_sync);
+        if (wake)
+            nn_sem_post (&readable);
+    }
+}
+
+static void msgqueue_reader (void)
+{
+    int rc;
+    int i;
+    struct nn_msg msg;
+
+    for (i = 0; i != message_count;) {
+        nn_mutex_lock (&queue_sync);
+        rc = nn_msgqueue_recv (&queue, &msg);
+        if (rc == -EAGAIN)
+            sleeping = 1;
+        nn_mutex_unlock (&queue_sync);
+        if (rc == -EAGAIN) {
+            nn_sem_wait (&readable);
+            continue;
+        }
+        assert (rc == 0);
+        nn_msg_term (&msg);
+        ++i;
+    }
+}
+
+static void msgring_writer (void *arg)
+{
+    int rc;
+    int i;
+    struct nn_msg msg;
+
+    for (i = 0; i != message_count; ++i) {
+        nn_msg_init (&msg, message_size);
+        while (1) {
+            rc = nn_msgring_write (&ring, &msg);
+            if (rc == 0)
+                break;
+
+            /*  The ring is full. Wait till the reader drains it. */
+            assert (rc == -EAGAIN);
+            if (!nn_msgring_flush (&ring))
+                nn_sem_post (&readable);
+            nn_sem_wait (&writable);
+        }
+        if (i % RING_BATCH == RING_BATCH - 1 || i == message_count - 1) {
+            if (!nn_msgring_flush (&ring))
+                nn_sem_post (&readable);
+        }
+    }
+}
+
+static void msgring_reader (void)
+{
+    int rc;
+    int i;
+    struct nn_msg msg;
+
+    for (i = 0; i != message_count;) {
+        rc = nn_msgring_read (&ring, &msg);
+        if (rc == -EAGAIN) {
+            nn_sem_post (&writable);
+            nn_sem_wait (&readable);
+            continue;
+        }
+        assert (rc == 0);
+        nn_msg_term (&msg);
+        ++i;
+    }
+}
+
+static void run (const char *name, nn_thread_routine *writer,
+    void (*reader) (void))
+{
+    struct nn_thread thread;
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    unsigned long throughput;
+
+    nn_stopwatch_init (&stopwatch);
+    nn_thread_init (&thread, writer, NULL);
+    reader ();
+    nn_thread_term (&thread);
+    elapsed = nn_stopwatch_term (&stopwatch);
+
+    if (elapsed == 0)
+        elapsed = 1;
+    throughput = (unsigned long)
+        ((double) message_count / (double) elapsed * 1000000);
+    printf ("%s throughput: %d [msg/s]\n", name, (int) throughput);
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 3) {
+        printf ("usage: msgring_thr <message-size> <message-count>\n");
+        return 1;
+    }
+
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    assert (message_count > 0);
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", message_count);
+
+    nn_sem_init (&readable);
+    nn_sem_init (&writable);
+
+    nn_mutex_init (&queue_sync);
+    nn_msgqueue_init (&queue, (size_t) -1);
+    sleeping = 0;
+    run ("msgqueue", msgqueue_writer, msgqueue_reader);
+    nn_msgqueue_term (&queue);
+    nn_mutex_term (&queue_sync);
+
+    nn_msgring_init (&ring, RING_SIZE);
+    run ("msgring", msgring_writer, msgring_reader);
+    nn_msgring_term (&ring);
+
+    nn_sem_term (&writable);
+    nn_sem_term (&readable);
+
+    return 0;
+}
+
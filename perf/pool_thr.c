@@ -0,0 +1,164 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/pair.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  This program measures the aggregate throughput of several independent
+    TCP connections within a single process. Running it with different values
+    of NN_WORKERS environment variable shows how the throughput scales with
+    the size of the worker thread pool. */
+
+#define MAX_PAIRS 64
+#define BASE_PORT 5560
+
+static size_t message_size;
+static int message_count;
+
+void sender (void *arg)
+{
+    int rc;
+    int s;
+    int i;
+    char *buf;
+
+    s = *(int*) arg;
+
+    buf = malloc (message_size);
+    assert (buf);
+    memset (buf, 111, message_size);
+
+    for (i = 0; i != message_count; i++) {
+        rc = nn_send (s, buf, message_size, 0);
+        assert (rc == (int) message_size);
+    }
+
+    free (buf);
+}
+
+void receiver (void *arg)
+{
+    int rc;
+    int s;
+    int i;
+    char *buf;
+
+    s = *(int*) arg;
+
+    buf = malloc (message_size);
+    assert (buf);
+
+    for (i = 0; i != message_count; i++) {
+        rc = nn_recv (s, buf, message_size, 0);
+        assert (rc == (int) message_size);
+    }
+
+    free (buf);
+}
+
+int main (int argc, char *argv [])
+{
+    int rc;
+    int i;
+    int pairs;
+    char addr [64];
+    int bound [MAX_PAIRS];
+    int connected [MAX_PAIRS];
+    struct nn_thread senders [MAX_PAIRS];
+    struct nn_thread receivers [MAX_PAIRS];
+    char buf [1];
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    unsigned long throughput;
+    double megabits;
+
+    if (argc != 4) {
+        printf ("usage: pool_thr <message-size> <message-count> <pairs>\n");
+        return 1;
+    }
+
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    pairs = atoi (argv [3]);
+    assert (pairs > 0 && pairs <= MAX_PAIRS);
+
+    /*  Set up the connections. The initial message makes sure that
+        the connection is established before the measurement starts. */
+    for (i = 0; i != pairs; i++) {
+        sprintf (addr, "tcp://127.0.0.1:%d", BASE_PORT + i);
+        bound [i] = nn_socket (AF_SP, NN_PAIR);
+        assert (bound [i] != -1);
+        rc = nn_bind (bound [i], addr);
+        assert (rc >= 0);
+        connected [i] = nn_socket (AF_SP, NN_PAIR);
+        assert (connected [i] != -1);
+        rc = nn_connect (connected [i], addr);
+        assert (rc >= 0);
+        rc = nn_send (connected [i], "A", 1, 0);
+        assert (rc == 1);
+        rc = nn_recv (bound [i], buf, sizeof (buf), 0);
+        assert (rc == 1);
+    }
+
+    nn_stopwatch_init (&stopwatch);
+
+    for (i = 0; i != pairs; i++) {
+        nn_thread_init (&receivers [i], receiver, &bound [i]);
+        nn_thread_init (&senders [i], sender, &connected [i]);
+    }
+    for (i = 0; i != pairs; i++)
+        nn_thread_term (&receivers [i]);
+
+    elapsed = nn_stopwatch_term (&stopwatch);
+
+    for (i = 0; i != pairs; i++) {
+        nn_thread_term (&senders [i]);
+        rc = nn_close (connected [i]);
+        assert (rc == 0);
+        rc = nn_close (bound [i]);
+        assert (rc == 0);
+    }
+
+    if (elapsed == 0)
+        elapsed = 1;
+    throughput = (unsigned long)
+        ((double) message_count * pairs / (double) elapsed * 1000000);
+    megabits = (double) (throughput * message_size * 8) / 1000000;
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", (int) message_count);
+    printf ("connections: %d\n", (int) pairs);
+    printf ("aggregate throughput: %d [msg/s]\n", (int) throughput);
+    printf ("aggregate throughput: %.3f [Mb/s]\n", (double) megabits);
+
+    return 0;
+}
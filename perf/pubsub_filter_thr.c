@@ -0,0 +1,184 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/pubsub.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/sleep.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*  This program measures the cost of publishing messages to many subscribers
+    each of which is interested in a different topic. If forwarding is
+    switched on, subscribers send their subscriptions to the publisher which
+    then sends each message only to the matching subscriber. Otherwise, each
+    message is sent to all the subscribers and dropped by all but one of them.
+    Each round publishes one message per subscriber. Note that to use more
+    than 511 subscribers, NN_MAX_SOCKETS environment variable has to be set. */
+
+#define SOCKET_ADDRESS "tcp://127.0.0.1:5571"
+
+#define TOPIC_SIZE 6
+
+int main (int argc, char *argv [])
+{
+    int rc;
+    int i;
+    int k;
+    size_t message_size;
+    int message_count;
+    int subscribers;
+    int forward;
+    int pub;
+    int *subs;
+    int ready;
+    int *isready;
+    char topic [16];
+    char *buf;
+    void *msg;
+    struct nn_stopwatch stopwatch;
+    clock_t cpu;
+    uint64_t elapsed;
+    unsigned long throughput;
+
+    if (argc != 5) {
+        printf ("usage: pubsub_filter_thr <message-size> <message-count> "
+            "<subscribers> <forward>\n");
+        return 1;
+    }
+
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    subscribers = atoi (argv [3]);
+    forward = atoi (argv [4]) ? 1 : 0;
+    assert (message_size >= TOPIC_SIZE && message_count > 0 &&
+        subscribers > 0 && subscribers < 100000);
+
+    pub = nn_socket (AF_SP, NN_PUB);
+    assert (pub != -1);
+    rc = nn_bind (pub, SOCKET_ADDRESS);
+    assert (rc >= 0);
+
+    subs = malloc (subscribers * sizeof (int));
+    assert (subs);
+    isready = malloc (subscribers * sizeof (int));
+    assert (isready);
+    for (i = 0; i != subscribers; i++) {
+        subs [i] = nn_socket (AF_SP, NN_SUB);
+        assert (subs [i] != -1);
+        rc = nn_setsockopt (subs [i], NN_SUB, NN_SUB_FORWARD,
+            &forward, sizeof (forward));
+        assert (rc == 0);
+        rc = nn_setsockopt (subs [i], NN_SUB, NN_SUB_SUBSCRIBE, "P", 1);
+        assert (rc == 0);
+        sprintf (topic, "T%05d", i);
+        rc = nn_setsockopt (subs [i], NN_SUB, NN_SUB_SUBSCRIBE,
+            topic, TOPIC_SIZE);
+        assert (rc == 0);
+        rc = nn_connect (subs [i], SOCKET_ADDRESS);
+        assert (rc >= 0);
+        isready [i] = 0;
+    }
+
+    /*  Publish 1-byte probes till all the subscribers are connected. Then
+        drain any remaining probes. */
+    ready = 0;
+    while (ready != subscribers) {
+        rc = nn_send (pub, "P", 1, 0);
+        assert (rc == 1);
+        nn_sleep (10);
+        for (i = 0; i != subscribers; i++) {
+            while (nn_recv (subs [i], &msg, NN_MSG, NN_DONTWAIT) >= 0) {
+                nn_freemsg (msg);
+                if (!isready [i]) {
+                    isready [i] = 1;
+                    ++ready;
+                }
+            }
+            assert (nn_errno () == EAGAIN);
+        }
+    }
+    nn_sleep (100);
+    for (i = 0; i != subscribers; i++) {
+        while (nn_recv (subs [i], &msg, NN_MSG, NN_DONTWAIT) >= 0)
+            nn_freemsg (msg);
+    }
+
+    buf = malloc (message_size + 1);
+    assert (buf);
+    memset (buf, 111, message_size);
+
+    nn_stopwatch_init (&stopwatch);
+    cpu = clock ();
+
+    for (i = 0; i < message_count; i += subscribers) {
+        for (k = 0; k != subscribers; k++) {
+            sprintf (topic, "T%05d", k);
+            memcpy (buf, topic, TOPIC_SIZE);
+            rc = nn_send (pub, buf, message_size, 0);
+            assert (rc == (int) message_size);
+        }
+        for (k = 0; k != subscribers; k++) {
+            rc = nn_recv (subs [k], &msg, NN_MSG, 0);
+            assert (rc == (int) message_size);
+            nn_freemsg (msg);
+        }
+    }
+
+    cpu = clock () - cpu;
+    elapsed = nn_stopwatch_term (&stopwatch);
+
+    free (buf);
+    for (i = 0; i != subscribers; i++) {
+        rc = nn_close (subs [i]);
+        assert (rc == 0);
+    }
+    rc = nn_close (pub);
+    assert (rc == 0);
+    free (isready);
+    free (subs);
+
+    /*  The last round may have been rounded up. */
+    message_count = ((message_count + subscribers - 1) / subscribers) *
+        subscribers;
+
+    if (elapsed == 0)
+        elapsed = 1;
+    throughput = (unsigned long)
+        ((double) message_count / (double) elapsed * 1000000);
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", (int) message_count);
+    printf ("subscribers: %d\n", (int) subscribers);
+    printf ("forwarding: %s\n", forward ? "on" : "off");
+    printf ("throughput: %d [msg/s]\n", (int) throughput);
+    printf ("cpu time: %.3f [s]\n", (double) cpu / CLOCKS_PER_SEC);
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "../src/nn.h"
+#include "../src/fanout.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/mutex.c"
+#include "../src/utils/atomic.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/sleep.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  This program measures the throughput of a single PUSH socket used by many
+    threads at the same time. Each thread sends the same number of messages
+    to the socket. Optionally, the socket is split into several send lanes
+    using NN_SNDLANES option. There's one PULL socket per lane and each of
+    them is read by a separate thread. */
+
+#define PORT 5576
+
+static int push;
+static size_t message_size;
+static int message_count;
+static int thread_count;
+static struct nn_atomic received;
+static struct nn_stopwatch stopwatch;
+static uint64_t elapsed;
+
+static void sender (void *arg)
+{
+    int rc;
+    int i;
+    char *buf;
+
+    buf = malloc (message_size);
+    assert (buf);
+    memset (buf, 111, message_size);
+
+    for (i = 0; i != message_count; i++) {
+        rc = nn_send (push, buf, message_size, 0);
+        assert (rc == (int) message_size);
+    }
+
+    free (buf);
+}
+
+static void receiver (void *arg)
+{
+    int rc;
+    int pull;
+    uint32_t total;
+    char *buf;
+
+    pull = *(int*) arg;
+    total = thread_count * message_count;
+    buf = malloc (message_size);
+    assert (buf);
+
+    /*  The receive timeout is short so that the threads with no messages
+        left to receive notice that all the messages have arrived. */
+    while (nn_atomic_get (&received) != total) {
+        rc = nn_recv (pull, buf, message_size, 0);
+        if (rc < 0) {
+            assert (nn_errno () == EAGAIN);
+            continue;
+        }
+        assert (rc == (int) message_size);
+        if (nn_atomic_inc (&received, 1) + 1 == total)
+            elapsed = nn_stopwatch_term (&stopwatch);
+    }
+
+    free (buf);
+}
+
+int main (int argc, char *argv [])
+{
+    int rc;
+    int i;
+    int lanes;
+    int opt;
+    int *pulls;
+    char addr [32];
+    struct nn_thread *senders;
+    struct nn_thread *receivers;
+    double throughput;
+
+    if (argc != 4 && argc != 5) {
+        printf ("usage: push_thr <message-size> <message-count> "
+            "<thread-count> [lanes]\n");
+        return 1;
+    }
+
+    message_size = atoi (argv [1]);
+    message_count = atoi (argv [2]);
+    thread_count = atoi (argv [3]);
+    lanes = argc == 5 ? atoi (argv [4]) : 1;
+    assert (message_size > 0 && message_count > 0 && thread_count > 0 &&
+        lanes > 0);
+
+    push = nn_socket (AF_SP, NN_PUSH);
+    assert (push != -1);
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_SNDLANES, &lanes,
+        sizeof (lanes));
+    assert (rc == 0);
+
+    /*  Connecting endpoints are distributed among the lanes, thus each lane
+        gets one of the PULL sockets. */
+    pulls = malloc (lanes * sizeof (int));
+    assert (pulls);
+    opt = 100;
+    for (i = 0; i != lanes; i++) {
+        sprintf (addr, "tcp://127.0.0.1:%d", PORT + i);
+        pulls [i] = nn_socket (AF_SP, NN_PULL);
+        assert (pulls [i] != -1);
+        rc = nn_setsockopt (pulls [i], NN_SOL_SOCKET, NN_RCVTIMEO, &opt,
+            sizeof (opt));
+        assert (rc == 0);
+        rc = nn_bind (pulls [i], addr);
+        assert (rc >= 0);
+        rc = nn_connect (push, addr);
+        assert (rc >= 0);
+    }
+
+    /*  Give the connections time to be established. */
+    nn_sleep (500);
+
+    senders = malloc (thread_count * sizeof (struct nn_thread));
+    assert (senders);
+    receivers = malloc (lanes * sizeof (struct nn_thread));
+    assert (receivers);
+
+    nn_atomic_init (&received, 0);
+    nn_stopwatch_init (&stopwatch);
+    for (i = 0; i != lanes; i++)
+        nn_thread_init (&receivers [i], receiver, &pulls [i]);
+    for (i = 0; i != thread_count; i++)
+        nn_thread_init (&senders [i], sender, NULL);
+    for (i = 0; i != thread_count; i++)
+        nn_thread_term (&senders [i]);
+    for (i = 0; i != lanes; i++)
+        nn_thread_term (&receivers [i]);
+    nn_atomic_term (&received);
+
+    rc = nn_close (push);
+    assert (rc == 0);
+    for (i = 0; i != lanes; i++) {
+        rc = nn_close (pulls [i]);
+        assert (rc == 0);
+    }
+    free (receivers);
+    free (senders);
+    free (pulls);
+
+    if (elapsed == 0)
+        elapsed = 1;
+    throughput = (double) thread_count * message_count / (double) elapsed *
+        1000000;
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", (int) message_count);
+    printf ("thread count: %d\n", (int) thread_count);
+    printf ("lanes: %d\n", (int) lanes);
+    printf ("throughput: %.0f [msg/s]\n", throughput);
+
+    return 0;
+}
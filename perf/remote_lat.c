@@ -47,8 +47,9 @@ int main (int argc, char *argv [])
     double lat;
     
 
-    if (argc != 4) {
-        printf ("usage: remote_lat <connect-to> <msg-size> <roundtrips>\n");
+    if (argc != 4 && argc != 5) {
+        printf ("usage: remote_lat <connect-to> <msg-size> <roundtrips> "
+            "[busy-poll-us]\n");
         return 1;
     }
     connect_to = argv [1];
@@ -60,6 +61,12 @@ int main (int argc, char *argv [])
     opt = 1;
     rc = nn_setsockopt (s, NN_TCP, NN_TCP_NODELAY, &opt, sizeof (opt));
     assert (rc == 0);
+    if (argc == 5) {
+        opt = atoi (argv [4]);
+        rc = nn_setsockopt (s, NN_SOL_SOCKET, NN_BUSY_POLL, &opt,
+            sizeof (opt));
+        assert (rc == 0);
+    }
     rc = nn_connect (s, connect_to);
     assert (rc >= 0);
 
@@ -38,14 +38,19 @@ int main (int argc, char *argv [])
     int s;
     int rc;
     int i;
+    int batch;
+    struct nn_iovec iov;
+    struct nn_mmsghdr *hdrs;
 
-    if (argc != 4) {
-        printf ("usage: remote_thr <connect-to> <msg-size> <msg-count>\n");
+    if (argc != 4 && argc != 5) {
+        printf ("usage: remote_thr <connect-to> <msg-size> <msg-count> "
+            "[batch]\n");
         return 1;
     }
     connect_to = argv [1];
     sz = atoi (argv [2]);
     count = atoi (argv [3]);
+    batch = argc == 5 ? atoi (argv [4]) : 1;
 
     s = nn_socket (AF_SP, NN_PAIR);
     assert (s != -1);
@@ -59,9 +64,29 @@ int main (int argc, char *argv [])
     nbytes = nn_send (s, buf, 0, 0);
     assert (nbytes == 0);
 
-    for (i = 0; i != count; i++) {
-        nbytes = nn_send (s, buf, sz, 0);
-        assert (nbytes == sz);
+    if (batch > 1) {
+
+        /*  All the messages in the batch are sent from the same buffer. */
+        iov.iov_base = buf;
+        iov.iov_len = sz;
+        hdrs = calloc (batch, sizeof (struct nn_mmsghdr));
+        assert (hdrs);
+        for (i = 0; i != batch; i++) {
+            hdrs [i].msg_hdr.msg_iov = &iov;
+            hdrs [i].msg_hdr.msg_iovlen = 1;
+        }
+        for (i = 0; i != count; i += rc) {
+            rc = nn_sendmmsg (s, hdrs, count - i < batch ? count - i : batch,
+                0);
+            assert (rc > 0);
+        }
+        free (hdrs);
+    }
+    else {
+        for (i = 0; i != count; i++) {
+            nbytes = nn_send (s, buf, sz, 0);
+            assert (nbytes == sz);
+        }
     }
 
     free (buf);
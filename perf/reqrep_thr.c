@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/reqrep.h"
+#include "../src/tcp.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  This program measures the cost of request/reply round-trips when many
+    REQ sockets talk to a single REP socket within a single process. In each
+    round every REQ socket sends a request, the REP socket answers all of them
+    and then every REQ socket receives its reply. Thus, each REQ socket arms
+    and cancels its re-send deadline once per round. Optionally, each REQ
+    socket sends several requests per round using NN_REQ_WINDOW. Note that to use more
+    than 510 REQ sockets, NN_MAX_SOCKETS environment variable has to be set. */
+
+#define SOCKET_ADDRESS "tcp://127.0.0.1:5575"
+
+int main (int argc, char *argv [])
+{
+    int rc;
+    int i;
+    int j;
+    int k;
+    int window;
+    int opt;
+    size_t message_size;
+    int rounds;
+    int requesters;
+    int rep;
+    int *reqs;
+    char *buf;
+    void *msg;
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    double throughput;
+
+    if (argc != 4 && argc != 5) {
+        printf ("usage: reqrep_thr <message-size> <roundtrip-count> "
+            "<requesters> [window]\n");
+        return 1;
+    }
+
+    message_size = atoi (argv [1]);
+    rounds = atoi (argv [2]);
+    requesters = atoi (argv [3]);
+    window = argc == 5 ? atoi (argv [4]) : 1;
+    assert (message_size > 0 && rounds > 0 && requesters > 0 && window > 0);
+
+    rep = nn_socket (AF_SP, NN_REP);
+    assert (rep != -1);
+    opt = 1;
+    rc = nn_setsockopt (rep, NN_TCP, NN_TCP_NODELAY, &opt, sizeof (opt));
+    assert (rc == 0);
+    rc = nn_bind (rep, SOCKET_ADDRESS);
+    assert (rc >= 0);
+
+    reqs = malloc (requesters * sizeof (int));
+    assert (reqs);
+    for (i = 0; i != requesters; i++) {
+        reqs [i] = nn_socket (AF_SP, NN_REQ);
+        assert (reqs [i] != -1);
+        rc = nn_setsockopt (reqs [i], NN_TCP, NN_TCP_NODELAY, &opt,
+            sizeof (opt));
+        assert (rc == 0);
+        rc = nn_setsockopt (reqs [i], NN_REQ, NN_REQ_WINDOW, &window,
+            sizeof (window));
+        assert (rc == 0);
+        rc = nn_connect (reqs [i], SOCKET_ADDRESS);
+        assert (rc >= 0);
+    }
+
+    buf = malloc (message_size);
+    assert (buf);
+    memset (buf, 111, message_size);
+
+    /*  The first round is not measured. Requests are delayed till
+        the connections are established. */
+    for (j = 0; j != rounds + 1; j++) {
+        if (j == 1)
+            nn_stopwatch_init (&stopwatch);
+        for (i = 0; i != requesters; i++) {
+            for (k = 0; k != window; k++) {
+                rc = nn_send (reqs [i], buf, message_size, 0);
+                assert (rc == (int) message_size);
+            }
+        }
+        for (i = 0; i != requesters * window; i++) {
+            rc = nn_recv (rep, &msg, NN_MSG, 0);
+            assert (rc == (int) message_size);
+            rc = nn_send (rep, &msg, NN_MSG, 0);
+            assert (rc == (int) message_size);
+        }
+        for (i = 0; i != requesters; i++) {
+            for (k = 0; k != window; k++) {
+                rc = nn_recv (reqs [i], &msg, NN_MSG, 0);
+                assert (rc == (int) message_size);
+                nn_freemsg (msg);
+            }
+        }
+    }
+
+    elapsed = nn_stopwatch_term (&stopwatch);
+
+    free (buf);
+    for (i = 0; i != requesters; i++) {
+        rc = nn_close (reqs [i]);
+        assert (rc == 0);
+    }
+    rc = nn_close (rep);
+    assert (rc == 0);
+    free (reqs);
+
+    if (elapsed == 0)
+        elapsed = 1;
+    throughput = (double) rounds * requesters * window / (double) elapsed *
+        1000000;
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("roundtrip count: %d\n", (int) rounds);
+    printf ("requesters: %d\n", (int) requesters);
+    printf ("window: %d\n", (int) window);
+    printf ("throughput: %.0f [roundtrips/s]\n", throughput);
+    printf ("average cost: %.3f [us/roundtrip]\n", 1000000 / throughput);
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/mutex.c"
+#include "../src/utils/atomic.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/efd.c"
+#include "../src/utils/queue.c"
+#include "../src/utils/mpsc.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+/*  This program compares the throughput of posting tasks from many threads
+    to a single worker thread using mutex-guarded nn_queue that signals
+    the worker's efd for each task, and using lock-free nn_mpsc that signals
+    the efd only when the queue becomes non-empty. */
+
+static int thread_count;
+static int task_count;
+
+static struct nn_efd efd;
+static struct nn_mutex queue_sync;
+static struct nn_queue queue;
+static struct nn_mpsc mpsc;
+
+/*  Each posting thread owns a range of tasks. */
+static struct nn_queue_item *tasks;
+
+static void queue_writer (void *arg)
+{
+    int i;
+    struct nn_queue_item *items;
+
+    items = (struct nn_queue_item*) arg;
+    for (i = 0; i != task_count; ++i) {
+        nn_mutex_lock (&queue_sync);
+        nn_queue_push (&queue, &items [i]);
+        nn_efd_signal (&efd);
+        nn_mutex_unlock (&queue_sync);
+    }
+}
+
+static void queue_reader (void)
+{
+    int i;
+    struct nn_queue local;
+
+    for (i = 0; i != thread_count * task_count;) {
+        nn_efd_wait (&efd, -1);
+        nn_mutex_lock (&queue_sync);
+        nn_efd_unsignal (&efd);
+        memcpy (&local, &queue, sizeof (local));
+        nn_queue_init (&queue);
+        nn_mutex_unlock (&queue_sync);
+        while (nn_queue_pop (&local))
+            ++i;
+    }
+}
+
+static void mpsc_writer (void *arg)
+{
+    int i;
+    struct nn_queue_item *items;
+
+    items = (struct nn_queue_item*) arg;
+    for (i = 0; i != task_count; ++i) {
+        if (nn_mpsc_push (&mpsc, &items [i]))
+            nn_efd_signal (&efd);
+    }
+}
+
+static void mpsc_reader (void)
+{
+    int i;
+    struct nn_queue local;
+
+    for (i = 0; i != thread_count * task_count;) {
+        nn_efd_wait (&efd, -1);
+        nn_efd_unsignal (&efd);
+        nn_queue_init (&local);
+        nn_mpsc_grab (&mpsc, &local);
+        while (nn_queue_pop (&local))
+            ++i;
+    }
+}
+
+static void run (const char *name, nn_thread_routine *writer,
+    void (*reader) (void))
+{
+    int i;
+    struct nn_thread *threads;
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    unsigned long throughput;
+
+    for (i = 0; i != thread_count * task_count; ++i)
+        nn_queue_item_init (&tasks [i]);
+
+    threads = malloc (thread_count * sizeof (struct nn_thread));
+    assert (threads);
+    nn_stopwatch_init (&stopwatch);
+    for (i = 0; i != thread_count; ++i)
+        nn_thread_init (&threads [i], writer, &tasks [i * task_count]);
+    reader ();
+    for (i = 0; i != thread_count; ++i)
+        nn_thread_term (&threads [i]);
+    elapsed = nn_stopwatch_term (&stopwatch);
+    free (threads);
+
+    if (elapsed == 0)
+        elapsed = 1;
+    throughput = (unsigned long)
+        ((double) thread_count * task_count / (double) elapsed * 1000000);
+    printf ("%s throughput: %d [tasks/s]\n", name, (int) throughput);
+}
+
+int main (int argc, char *argv [])
+{
+    int rc;
+
+    if (argc != 2 && argc != 3) {
+        printf ("usage: taskqueue_thr <task-count> [thread-count]\n");
+        return 1;
+    }
+
+    task_count = atoi (argv [1]);
+    thread_count = argc == 3 ? atoi (argv [2]) : 16;
+    assert (task_count > 0 && thread_count > 0);
+
+    printf ("task count: %d\n", task_count);
+    printf ("thread count: %d\n", thread_count);
+
+    tasks = malloc (thread_count * task_count * sizeof (struct nn_queue_item));
+    assert (tasks);
+    rc = nn_efd_init (&efd);
+    assert (rc == 0);
+
+    nn_mutex_init (&queue_sync);
+    nn_queue_init (&queue);
+    run ("queue", queue_writer, queue_reader);
+    nn_queue_term (&queue);
+    nn_mutex_term (&queue_sync);
+
+    nn_mpsc_init (&mpsc);
+    run ("mpsc", mpsc_writer, mpsc_reader);
+    nn_mpsc_term (&mpsc);
+
+    nn_efd_term (&efd);
+    free (tasks);
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/clock.c"
+#include "../src/utils/stopwatch.c"
+#include "../src/aio/timerset.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*  This program measures the cost of arming and cancelling timers when
+    a large number of timers is already armed on a single worker, e.g. REQ
+    resend timers for many outstanding requests. */
+
+int main (int argc, char *argv [])
+{
+    int i;
+    int round;
+    int timer_count;
+    int round_count;
+    struct nn_timerset timerset;
+    struct nn_timerset_hndl *hndls;
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    double ops;
+
+    if (argc != 3) {
+        printf ("usage: timerset_thr <timer-count> <round-count>\n");
+        return 1;
+    }
+
+    timer_count = atoi (argv [1]);
+    round_count = atoi (argv [2]);
+    assert (timer_count > 0 && round_count > 0);
+
+    hndls = malloc (timer_count * sizeof (struct nn_timerset_hndl));
+    assert (hndls);
+    nn_timerset_init (&timerset);
+    for (i = 0; i != timer_count; i++)
+        nn_timerset_hndl_init (&hndls [i]);
+
+    /*  Arm all the timers. Timeouts are spread over a minute so that no timer
+        expires during the measurement. */
+    nn_stopwatch_init (&stopwatch);
+    for (i = 0; i != timer_count; i++)
+        nn_timerset_add (&timerset, 60000 + rand () % 60000, &hndls [i]);
+    elapsed = nn_stopwatch_term (&stopwatch);
+    printf ("timer count: %d\n", timer_count);
+    printf ("arm: %.3f [us/timer]\n", (double) elapsed / timer_count);
+
+    /*  Re-arm the timers repeatedly, which is what happens to resend timers
+        and reconnect timers in steady state. */
+    nn_stopwatch_init (&stopwatch);
+    for (round = 0; round != round_count; round++) {
+        for (i = 0; i != timer_count; i++) {
+            nn_timerset_rm (&timerset, &hndls [i]);
+            nn_timerset_add (&timerset, 60000 + rand () % 60000, &hndls [i]);
+            nn_timerset_timeout (&timerset);
+        }
+    }
+    elapsed = nn_stopwatch_term (&stopwatch);
+    if (elapsed == 0)
+        elapsed = 1;
+    ops = (double) timer_count * round_count;
+    printf ("rearm: %.3f [us/timer]\n", (double) elapsed / ops);
+    printf ("rearm throughput: %d [timers/s]\n",
+        (int) (ops / (double) elapsed * 1000000));
+
+    /*  Cancel all the timers. */
+    nn_stopwatch_init (&stopwatch);
+    for (i = 0; i != timer_count; i++)
+        nn_timerset_rm (&timerset, &hndls [i]);
+    elapsed = nn_stopwatch_term (&stopwatch);
+    printf ("cancel: %.3f [us/timer]\n", (double) elapsed / timer_count);
+
+    for (i = 0; i != timer_count; i++)
+        nn_timerset_hndl_term (&hndls [i]);
+    nn_timerset_term (&timerset);
+    free (hndls);
+
+    return 0;
+}
+
@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/stopwatch.c"
+#include "../src/protocols/pubsub/trie.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+/*  This program measures the time needed to match a message against a trie
+    containing many subscriptions. The subscriptions are random strings over
+    a small alphabet, so that the trie contains both long prefixes and nodes
+    with many children. Half of the messages start with one of the
+    subscriptions, the other half are random. If batch size is greater than
+    one, the messages are matched in batches using nn_trie_match_many. */
+
+#define MIN_TOPIC 4
+#define MAX_TOPIC 16
+#define MSG_SIZE 32
+#define ALPHABET "abcdefghijklmnopqrstuvwxyz0123456789"
+
+/*  Returns the memory used by the nodes of the trie, not including
+    the allocator overhead. */
+static size_t trie_size (struct nn_trie_node *node)
+{
+    int i;
+    size_t size;
+
+    if (!node)
+        return 0;
+    size = sizeof (struct nn_trie_node) +
+        nn_node_children (node) * sizeof (struct nn_trie_node*);
+    for (i = 0; i != nn_node_children (node); ++i)
+        size += trie_size (*nn_node_child (node, i));
+    return size;
+}
+
+/*  Simple deterministic generator so that the runs are comparable. */
+static uint32_t seed = 0x12345678;
+static uint32_t next_random (void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void random_string (uint8_t *buf, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i != size; ++i)
+        buf [i] = ALPHABET [next_random () % (sizeof (ALPHABET) - 1)];
+}
+
+int main (int argc, char *argv [])
+{
+    int i;
+    int subscriptions;
+    int matches;
+    int matched;
+    int batch;
+    int j;
+    const uint8_t *bdata [256];
+    size_t bsizes [256];
+    int bresults [256];
+    uint8_t *topics;
+    size_t *topiclens;
+    uint8_t *msgs;
+    struct nn_trie trie;
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+    size_t nodes;
+    size_t tree;
+    size_t flat;
+
+    if (argc != 4) {
+        printf ("usage: trie_lat <subscriptions> <match-count> "
+            "<batch-size>\n");
+        return 1;
+    }
+
+    subscriptions = atoi (argv [1]);
+    matches = atoi (argv [2]);
+    batch = atoi (argv [3]);
+    assert (subscriptions > 0 && matches > 0 && batch > 0 && batch <= 256 &&
+        4096 % batch == 0 && matches % batch == 0);
+
+    nn_alloc_init ();
+
+    /*  Generate the subscriptions. */
+    topics = malloc (subscriptions * MAX_TOPIC);
+    assert (topics);
+    topiclens = malloc (subscriptions * sizeof (size_t));
+    assert (topiclens);
+    nn_trie_init (&trie);
+    for (i = 0; i != subscriptions; ++i) {
+        topiclens [i] = MIN_TOPIC + next_random () % (MAX_TOPIC - MIN_TOPIC);
+        random_string (topics + i * MAX_TOPIC, topiclens [i]);
+        nn_trie_subscribe (&trie, topics + i * MAX_TOPIC, topiclens [i]);
+    }
+
+    /*  Generate the messages to match. Only 4096 distinct messages are used
+        so that they fit into the cache. */
+    msgs = malloc (4096 * MSG_SIZE);
+    assert (msgs);
+    for (i = 0; i != 4096; ++i) {
+        random_string (msgs + i * MSG_SIZE, MSG_SIZE);
+        if (i % 2 == 0) {
+            matched = next_random () % subscriptions;
+            memcpy (msgs + i * MSG_SIZE, topics + matched * MAX_TOPIC,
+                topiclens [matched]);
+        }
+    }
+
+    for (j = 0; j != 256; ++j)
+        bsizes [j] = MSG_SIZE;
+
+    /*  Warm up. This also builds the flat copy of the trie. */
+    for (i = 0; i != 4096; ++i)
+        nn_trie_match (&trie, msgs + i * MSG_SIZE, MSG_SIZE);
+
+    matched = 0;
+    nn_stopwatch_init (&stopwatch);
+    if (batch == 1) {
+        for (i = 0; i != matches; ++i)
+            matched += nn_trie_match (&trie, msgs + (i % 4096) * MSG_SIZE,
+                MSG_SIZE);
+    }
+    else {
+        for (i = 0; i != matches; i += batch) {
+            for (j = 0; j != batch; ++j)
+                bdata [j] = msgs + ((i + j) % 4096) * MSG_SIZE;
+            nn_trie_match_many (&trie, bdata, bsizes, batch, bresults);
+            for (j = 0; j != batch; ++j)
+                matched += bresults [j];
+        }
+    }
+    elapsed = nn_stopwatch_term (&stopwatch);
+
+    /*  The flat copy is in use by now. */
+    assert (trie.flat_valid);
+    tree = trie_size (trie.root);
+    nodes = 0;
+    flat = nn_node_flat_size (trie.root, &nodes);
+
+    nn_trie_term (&trie);
+    free (msgs);
+    free (topiclens);
+    free (topics);
+    nn_alloc_term ();
+
+    printf ("subscriptions: %d\n", subscriptions);
+    printf ("match count: %d\n", matches);
+    printf ("batch size: %d\n", batch);
+    printf ("nodes: %d\n", (int) nodes);
+    printf ("trie memory: %.1f [B/subscription]\n",
+        (double) tree / subscriptions);
+    printf ("flat copy memory: %.1f [B/subscription]\n",
+        (double) flat / subscriptions);
+    printf ("matched: %d\n", matched);
+    printf ("average match time: %.1f [ns]\n",
+        (double) elapsed * 1000 / matches);
+
+    return 0;
+}
@@ -26,6 +26,12 @@
 #include "../utils/cont.h"
 #include "../utils/fast.h"
 
+/*  Number of attempts to lock the context or to find the operation executed
+    by another thread before blocking on the context's mutex. */
+#define NN_CTX_SPIN 100
+
+static void nn_ctx_combine (struct nn_ctx *self);
+
 void nn_ctx_init (struct nn_ctx *self, struct nn_pool *pool,
     nn_ctx_onleave onleave)
 {
@@ -34,10 +40,12 @@ void nn_ctx_init (struct nn_ctx *self, struct nn_pool *pool,
     nn_queue_init (&self->events);
     nn_queue_init (&self->eventsto);
     self->onleave = onleave;
+    nn_mpsc_init (&self->ops);
 }
 
 void nn_ctx_term (struct nn_ctx *self)
 {
+    nn_mpsc_term (&self->ops);
     nn_queue_term (&self->eventsto);
     nn_queue_term (&self->events);
     nn_mutex_term (&self->sync);
@@ -63,6 +71,17 @@ void nn_ctx_leave (struct nn_ctx *self)
         nn_fsm_event_process (event);
     }
 
+    /*  Execute the operations handed over by other threads, if any. They
+        may have raised new events so process those as well. */
+    nn_ctx_combine (self);
+    while (1) {
+        item = nn_queue_pop (&self->events);
+        event = nn_cont (item, struct nn_fsm_event, item);
+        if (!event)
+            break;
+        nn_fsm_event_process (event);
+    }
+
     /*  Notify the owner that we are leaving the context. */
     if (nn_fast (self->onleave != NULL))
         self->onleave (self);
@@ -95,6 +114,69 @@ void nn_ctx_leave (struct nn_ctx *self)
     nn_queue_term (&eventsto);
 }
 
+void nn_ctx_execute (struct nn_ctx *self, struct nn_ctx_op *op,
+    nn_ctx_opfn fn)
+{
+    int i;
+
+    /*  Uncontended case. Execute the operation straight away. */
+    if (nn_fast (nn_mutex_trylock (&self->sync))) {
+        fn (op);
+        nn_ctx_leave (self);
+        return;
+    }
+
+    /*  Hand the operation over to the thread holding the context. */
+    op->fn = fn;
+    nn_atomic_init (&op->done, 0);
+    nn_queue_item_init (&op->item);
+    nn_mpsc_push (&self->ops, &op->item);
+
+    /*  Wait till the operation is executed. If the context was left before
+        the operation was posted, lock it and execute the operation here. */
+    for (i = 0; i != NN_CTX_SPIN; ++i) {
+        if (nn_atomic_get (&op->done))
+            break;
+        if (nn_mutex_trylock (&self->sync)) {
+            nn_ctx_leave (self);
+            break;
+        }
+        nn_relax ();
+    }
+    if (i == NN_CTX_SPIN && !nn_atomic_get (&op->done)) {
+        nn_mutex_lock (&self->sync);
+        nn_ctx_leave (self);
+    }
+
+    /*  Any thread that executes the operations does so while holding the
+        context, thus once we have held it the operation is done. */
+    nn_assert (nn_atomic_get (&op->done));
+    nn_atomic_term (&op->done);
+    nn_queue_item_term (&op->item);
+}
+
+static void nn_ctx_combine (struct nn_ctx *self)
+{
+    struct nn_queue ops;
+    struct nn_queue_item *item;
+    struct nn_ctx_op *op;
+
+    nn_queue_init (&ops);
+    nn_mpsc_grab (&self->ops, &ops);
+    while (1) {
+        item = nn_queue_pop (&ops);
+        if (!item)
+            break;
+        op = nn_cont (item, struct nn_ctx_op, item);
+
+        /*  The operation object may be deallocated as soon as it is marked
+            as done. Do not touch it afterwards. */
+        op->fn (op);
+        nn_atomic_set (&op->done, 1);
+    }
+    nn_queue_term (&ops);
+}
+
 struct nn_worker *nn_ctx_choose_worker (struct nn_ctx *self)
 {
     return nn_pool_choose_worker (self->pool);
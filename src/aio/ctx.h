@@ -25,6 +25,8 @@
 
 #include "../utils/mutex.h"
 #include "../utils/queue.h"
+#include "../utils/mpsc.h"
+#include "../utils/atomic.h"
 
 #include "worker.h"
 #include "pool.h"
@@ -34,12 +36,32 @@
 
 typedef void (*nn_ctx_onleave) (struct nn_ctx *self);
 
+/*  Operation to be executed within the context. It is meant to be embedded
+    into a larger structure holding the arguments and the results. */
+
+struct nn_ctx_op;
+
+typedef void (*nn_ctx_opfn) (struct nn_ctx_op *self);
+
+struct nn_ctx_op {
+    struct nn_queue_item item;
+    nn_ctx_opfn fn;
+
+    /*  Set to 1 once the operation was executed. */
+    struct nn_atomic done;
+};
+
 struct nn_ctx {
     struct nn_mutex sync;
     struct nn_pool *pool;
     struct nn_queue events;
     struct nn_queue eventsto;
     nn_ctx_onleave onleave;
+
+    /*  Operations posted by the threads that found the context locked.
+        They are executed by the thread holding the context when it is
+        leaving it. */
+    struct nn_mpsc ops;
 };
 
 void nn_ctx_init (struct nn_ctx *self, struct nn_pool *pool,
@@ -49,6 +71,14 @@ void nn_ctx_term (struct nn_ctx *self);
 void nn_ctx_enter (struct nn_ctx *self);
 void nn_ctx_leave (struct nn_ctx *self);
 
+/*  Executes the operation within the context. If the context is locked by
+    another thread at the moment, the operation is handed over to that thread
+    rather than waiting for the context to become available. Either way,
+    the function returns only after the operation was executed. The
+    operation should be short and must never block. */
+void nn_ctx_execute (struct nn_ctx *self, struct nn_ctx_op *op,
+    nn_ctx_opfn fn);
+
 struct nn_worker *nn_ctx_choose_worker (struct nn_ctx *self);
 
 void nn_ctx_raise (struct nn_ctx *self, struct nn_fsm_event *event);
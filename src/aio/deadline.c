@@ -0,0 +1,216 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "deadline.h"
+
+#include "../utils/cont.h"
+#include "../utils/fast.h"
+#include "../utils/err.h"
+
+#define NN_DEADLINE_STATE_IDLE 1
+#define NN_DEADLINE_STATE_ACTIVE 2
+#define NN_DEADLINE_STATE_STOPPING 3
+
+/*  Private functions. */
+static void nn_deadline_handler (struct nn_fsm *self, void *source, int type);
+static void nn_deadline_arm (struct nn_deadline *self);
+
+void nn_deadline_init (struct nn_deadline *self, struct nn_fsm *owner)
+{
+    nn_fsm_init (&self->fsm, nn_deadline_handler, owner);
+    self->state = NN_DEADLINE_STATE_IDLE;
+    nn_worker_task_init (&self->start_task, &self->fsm);
+    nn_worker_task_init (&self->stop_task, &self->fsm);
+    nn_worker_timer_init (&self->wtimer, &self->fsm);
+    nn_fsm_event_init (&self->done);
+    self->worker = nn_fsm_choose_worker (&self->fsm);
+    nn_clock_init (&self->clock);
+    self->due = 0;
+    self->expiry = 0;
+    self->armed = 0;
+    self->pending = 0;
+}
+
+void nn_deadline_term (struct nn_deadline *self)
+{
+    nn_assert (self->state == NN_DEADLINE_STATE_IDLE);
+
+    nn_clock_term (&self->clock);
+    nn_fsm_event_term (&self->done);
+    nn_worker_timer_term (&self->wtimer);
+    nn_worker_task_term (&self->stop_task);
+    nn_worker_task_term (&self->start_task);
+    nn_fsm_term (&self->fsm);
+}
+
+int nn_deadline_isidle (struct nn_deadline *self)
+{
+    return nn_fsm_isidle (&self->fsm);
+}
+
+void nn_deadline_set (struct nn_deadline *self, int timeout)
+{
+    /*  Negative timeout make no sense. */
+    nn_assert (timeout >= 0);
+
+    /*  The state machine is started when the deadline is set for the first
+        time. */
+    if (nn_slow (self->state == NN_DEADLINE_STATE_IDLE))
+        nn_fsm_start (&self->fsm);
+    nn_assert (self->state == NN_DEADLINE_STATE_ACTIVE);
+
+    self->due = nn_clock_now (&self->clock) + timeout;
+
+    /*  If the worker timer fires no later than the new deadline, it will be
+        re-armed once it fires. There's no need to bother the worker thread
+        now. Same applies if the worker is about to arm the timer anyway. */
+    if (nn_fast (self->pending ||
+          (self->armed && self->expiry <= self->due)))
+        return;
+
+    self->pending = 1;
+    nn_worker_execute (self->worker, &self->start_task);
+}
+
+void nn_deadline_clear (struct nn_deadline *self)
+{
+    /*  The worker timer is left as is. It will be ignored when it fires. */
+    self->due = 0;
+}
+
+void nn_deadline_stop (struct nn_deadline *self)
+{
+    nn_fsm_stop (&self->fsm);
+}
+
+static void nn_deadline_handler (struct nn_fsm *self, void *source, int type)
+{
+    struct nn_deadline *deadline;
+
+    deadline = nn_cont (self, struct nn_deadline, fsm);
+
+/******************************************************************************/
+/*  STOP procedure.                                                           */
+/******************************************************************************/
+    if (nn_slow (source == &deadline->fsm && type == NN_FSM_STOP)) {
+        deadline->due = 0;
+        nn_worker_execute (deadline->worker, &deadline->stop_task);
+        deadline->state = NN_DEADLINE_STATE_STOPPING;
+        return;
+    }
+    if (nn_slow (deadline->state == NN_DEADLINE_STATE_STOPPING)) {
+        if (source != &deadline->stop_task)
+            return;
+        nn_assert (type == NN_WORKER_TASK_EXECUTE);
+
+        /*  Tasks are executed in order so 'start_task' has been already
+            processed (and ignored) at this point. */
+        nn_worker_rm_timer (deadline->worker, &deadline->wtimer);
+        deadline->armed = 0;
+        deadline->pending = 0;
+        deadline->state = NN_DEADLINE_STATE_IDLE;
+        nn_fsm_stopped (&deadline->fsm, deadline, NN_DEADLINE_STOPPED);
+        return;
+    }
+
+    switch (deadline->state) {
+
+/******************************************************************************/
+/*  IDLE state.                                                               */
+/******************************************************************************/
+    case NN_DEADLINE_STATE_IDLE:
+        if (source == &deadline->fsm) {
+            switch (type) {
+            case NN_FSM_START:
+                deadline->state = NN_DEADLINE_STATE_ACTIVE;
+                return;
+            default:
+                nn_assert (0);
+            }
+        }
+        nn_assert (0);
+
+/******************************************************************************/
+/*  ACTIVE state.                                                             */
+/*  Both events below are processed in the worker thread.                     */
+/******************************************************************************/
+    case NN_DEADLINE_STATE_ACTIVE:
+        if (source == &deadline->start_task) {
+            nn_assert (type == NN_WORKER_TASK_EXECUTE);
+            nn_assert (deadline->pending);
+            deadline->pending = 0;
+
+            /*  Replace the worker timer, if any, by one that fires exactly
+                when the deadline expires. */
+            nn_worker_rm_timer (deadline->worker, &deadline->wtimer);
+            deadline->armed = 0;
+            if (deadline->due)
+                nn_deadline_arm (deadline);
+            return;
+        }
+        if (source == &deadline->wtimer) {
+            switch (type) {
+            case NN_WORKER_TIMER_TIMEOUT:
+                deadline->armed = 0;
+
+                /*  The deadline was cleared in the meantime or the worker
+                    timer is going to be re-armed anyway. */
+                if (!deadline->due || deadline->pending)
+                    return;
+
+                /*  The deadline was moved further. Re-arm the timer. */
+                if (deadline->due > nn_clock_now (&deadline->clock)) {
+                    nn_deadline_arm (deadline);
+                    return;
+                }
+
+                /*  Notify the user about the timeout. */
+                deadline->due = 0;
+                nn_fsm_raise (&deadline->fsm, &deadline->done, deadline,
+                    NN_DEADLINE_TIMEOUT);
+                return;
+
+            default:
+                nn_assert (0);
+            }
+        }
+        nn_assert (0);
+
+/******************************************************************************/
+/*  Invalid state.                                                            */
+/******************************************************************************/
+    default:
+        nn_assert (0);
+    }
+}
+
+static void nn_deadline_arm (struct nn_deadline *self)
+{
+    uint64_t now;
+
+    /*  Must be called from the worker thread. */
+    now = nn_clock_now (&self->clock);
+    nn_worker_add_timer (self->worker,
+        self->due > now ? (int) (self->due - now) : 0, &self->wtimer);
+    self->expiry = self->due;
+    self->armed = 1;
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_DEADLINE_INCLUDED
+#define NN_DEADLINE_INCLUDED
+
+#include "fsm.h"
+#include "worker.h"
+
+#include "../utils/clock.h"
+
+#include <stdint.h>
+
+#define NN_DEADLINE_TIMEOUT 1
+#define NN_DEADLINE_STOPPED 2
+
+/*  Deadline is a timer optimised for timeouts that are set and cleared
+    frequently but rarely expire, such as re-send intervals. Setting and
+    clearing the deadline doesn't communicate with the worker thread.
+    Instead, the worker timer is armed lazily and stays armed when the
+    deadline is cleared. When it fires and the deadline was moved further
+    in the meantime, it is re-armed from within the worker thread. Thus,
+    the worker is involved at most once per timeout interval rather than
+    twice per each set/clear pair. */
+
+struct nn_deadline {
+    struct nn_fsm fsm;
+    int state;
+    struct nn_worker_task start_task;
+    struct nn_worker_task stop_task;
+    struct nn_worker_timer wtimer;
+    struct nn_fsm_event done;
+    struct nn_worker *worker;
+    struct nn_clock clock;
+
+    /*  The instant (in milliseconds) when the deadline expires. Zero if no
+        deadline is set. */
+    uint64_t due;
+
+    /*  The instant when the worker timer is going to fire. Valid only if
+        'armed' is set. */
+    uint64_t expiry;
+
+    /*  1 if the worker timer is armed, 0 otherwise. */
+    int armed;
+
+    /*  1 if 'start_task' was posted to the worker thread but was not yet
+        executed. */
+    int pending;
+};
+
+void nn_deadline_init (struct nn_deadline *self, struct nn_fsm *owner);
+void nn_deadline_term (struct nn_deadline *self);
+
+int nn_deadline_isidle (struct nn_deadline *self);
+
+/*  Sets the deadline to 'timeout' milliseconds from now. Any previously set
+    deadline is replaced. NN_DEADLINE_TIMEOUT event is raised when the
+    deadline expires. */
+void nn_deadline_set (struct nn_deadline *self, int timeout);
+
+/*  Clears the deadline. No event is raised after this call, unless
+    the deadline is set anew. */
+void nn_deadline_clear (struct nn_deadline *self);
+
+/*  Stops the object. NN_DEADLINE_STOPPED event is raised once the worker
+    timer is disarmed. */
+void nn_deadline_stop (struct nn_deadline *self);
+
+#endif
@@ -142,6 +142,15 @@ void nn_fsm_raise (struct nn_fsm *self, struct nn_fsm_event *event,
     nn_ctx_raise (self->ctx, event);
 }
 
+void nn_fsm_raiseself (struct nn_fsm *self, struct nn_fsm_event *event,
+    int type)
+{
+    event->fsm = self;
+    event->source = self;
+    event->type = type;
+    nn_ctx_raise (self->ctx, event);
+}
+
 void nn_fsm_raiseto (struct nn_fsm *self, struct nn_fsm *dst,
     struct nn_fsm_event *event, void *source, int type)
 {
@@ -84,6 +84,11 @@ struct nn_worker *nn_fsm_choose_worker (struct nn_fsm *self);
 void nn_fsm_raise (struct nn_fsm *self, struct nn_fsm_event *event,
     void *source, int type);
 
+/*  Send event from the state machine to itself. The event is processed once
+    the current event handler or the operation that raised it returns. */
+void nn_fsm_raiseself (struct nn_fsm *self, struct nn_fsm_event *event,
+    int type);
+
 /*  Send event to the specified state machine. It's caller's responsibility
     to ensure that the destination state machine will still exist when the
     event is delivered.
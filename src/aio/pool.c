@@ -22,20 +22,74 @@
 
 #include "pool.h"
 
-/*  TODO: The dummy implementation of a thread pool. As for now there's only
-    one worker thread created. */
+#include "../utils/alloc.h"
+#include "../utils/err.h"
+
+#include <stdlib.h>
+
+/*  Private functions. */
+static int nn_pool_nworkers (void);
 
 int nn_pool_init (struct nn_pool *self)
 {
-    return nn_worker_init (&self->worker);
+    int rc;
+    int i;
+
+    self->nworkers = nn_pool_nworkers ();
+    self->workers = nn_alloc (sizeof (struct nn_worker) * self->nworkers,
+        "worker threads");
+    alloc_assert (self->workers);
+
+    for (i = 0; i != self->nworkers; ++i) {
+        rc = nn_worker_init (&self->workers [i]);
+        if (nn_slow (rc < 0)) {
+            while (i > 0)
+                nn_worker_term (&self->workers [--i]);
+            nn_free (self->workers);
+            self->workers = NULL;
+            return rc;
+        }
+    }
+    nn_atomic_init (&self->next, 0);
+
+    return 0;
 }
 
 void nn_pool_term (struct nn_pool *self)
 {
-    nn_worker_term (&self->worker);
+    int i;
+
+    nn_atomic_term (&self->next);
+    for (i = 0; i != self->nworkers; ++i)
+        nn_worker_term (&self->workers [i]);
+    nn_free (self->workers);
 }
 
 struct nn_worker *nn_pool_choose_worker (struct nn_pool *self)
 {
-    return &self->worker;
+    /*  Shortcut for the default case of a single worker thread. */
+    if (nn_fast (self->nworkers == 1))
+        return &self->workers [0];
+
+    /*  Spread the objects among the worker threads in round-robin fashion.
+        The counter wraps around at 2^32 which, given that the number of
+        workers is small, causes only a negligible skew. */
+    return &self->workers [nn_atomic_inc (&self->next, 1) %
+        (uint32_t) self->nworkers];
+}
+
+static int nn_pool_nworkers (void)
+{
+    const char *env;
+    int nworkers;
+
+    env = getenv (NN_POOL_ENV);
+    if (!env)
+        return 1;
+    nworkers = atoi (env);
+    if (nworkers < 1)
+        return 1;
+    if (nworkers > NN_POOL_MAX_WORKERS)
+        return NN_POOL_MAX_WORKERS;
+    return nworkers;
 }
@@ -25,10 +25,26 @@
 
 #include "worker.h"
 
+#include "../utils/atomic.h"
+
+/*  Name of the environment variable that specifies how many worker threads
+    should be launched. If not set, single worker thread is used. */
+#define NN_POOL_ENV "NN_WORKERS"
+
+/*  Maximum number of worker threads in the pool. */
+#define NN_POOL_MAX_WORKERS 64
+
 /*  Worker thread pool. */
 
 struct nn_pool {
-    struct nn_worker worker;
+
+    /*  Array of worker threads. */
+    struct nn_worker *workers;
+    int nworkers;
+
+    /*  Counter used to assign new objects to the workers in round-robin
+        fashion. */
+    struct nn_atomic next;
 };
 
 int nn_pool_init (struct nn_pool *self);
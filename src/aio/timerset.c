@@ -22,60 +22,89 @@
 
 #include "timerset.h"
 
+#include "../utils/alloc.h"
 #include "../utils/fast.h"
-#include "../utils/cont.h"
 #include "../utils/err.h"
 
+/*  Number of children of each node in the heap. */
+#define NN_TIMERSET_ARITY 4
+
+/*  Initial number of slots in the heap. */
+#define NN_TIMERSET_INITIAL_CAPACITY 16
+
+/*  Returns 1 if timeout 'a' should be reported before timeout 'b'. */
+static int nn_timerset_before (struct nn_timerset_hndl *a,
+    struct nn_timerset_hndl *b);
+
+/*  Move the handle at the specified position towards the root/leaves
+    of the heap until the heap property is restored. */
+static void nn_timerset_up (struct nn_timerset *self, size_t index);
+static void nn_timerset_down (struct nn_timerset *self, size_t index);
+
+/*  Removes the handle at the specified position from the heap. */
+static void nn_timerset_erase (struct nn_timerset *self, size_t index);
+
 void nn_timerset_init (struct nn_timerset *self)
 {
     nn_clock_init (&self->clock);
-    nn_list_init (&self->timeouts);
+    self->heap = nn_alloc (NN_TIMERSET_INITIAL_CAPACITY *
+        sizeof (struct nn_timerset_hndl*), "timerset");
+    alloc_assert (self->heap);
+    self->size = 0;
+    self->capacity = NN_TIMERSET_INITIAL_CAPACITY;
+    self->seq = 0;
 }
 
 void nn_timerset_term (struct nn_timerset *self)
 {
-    nn_list_term (&self->timeouts);
+    nn_free (self->heap);
     nn_clock_term (&self->clock);
 }
 
 int nn_timerset_add (struct nn_timerset *self, int timeout,
     struct nn_timerset_hndl *hndl)
 {
-    struct nn_list_item *it;
-    struct nn_timerset_hndl *ith;
-    int first;
+    struct nn_timerset_hndl **heap;
+
+    /*  The handle must not be already in the heap. */
+    nn_assert (hndl->index < 0);
 
     /*  Compute the instant when the timeout will be due. */
     hndl->timeout = nn_clock_now (&self->clock) + timeout;
-
-    /*  Insert it into the ordered list of timeouts. */
-    for (it = nn_list_begin (&self->timeouts);
-          it != nn_list_end (&self->timeouts);
-          it = nn_list_next (&self->timeouts, it)) {
-        ith = nn_cont (it, struct nn_timerset_hndl, list);
-        if (hndl->timeout < ith->timeout)
-            break;
+    hndl->seq = self->seq++;
+
+    /*  Make sure there's a free slot at the end of the heap. */
+    if (nn_slow (self->size == self->capacity)) {
+        heap = nn_realloc (self->heap,
+            self->capacity * 2 * sizeof (struct nn_timerset_hndl*));
+        alloc_assert (heap);
+        self->heap = heap;
+        self->capacity *= 2;
     }
 
+    /*  Insert it into the heap. */
+    hndl->index = (int) self->size;
+    self->heap [self->size] = hndl;
+    ++self->size;
+    nn_timerset_up (self, hndl->index);
+
     /*  If the new timeout happens to be the first one to expire, let the user
         know that the current waiting interval has to be changed. */
-    first = nn_list_begin (&self->timeouts) == it ? 1 : 0;
-    nn_list_insert (&self->timeouts, &hndl->list, it);
-    return first;
+    return hndl->index == 0 ? 1 : 0;
 }
 
 int nn_timerset_rm (struct nn_timerset *self, struct nn_timerset_hndl *hndl)
 {
     int first;
 
-    /*  Ignore if handle is not in the timeouts list. */
-    if (!nn_list_item_isinlist (&hndl->list))
+    /*  Ignore if handle is not in the heap. */
+    if (hndl->index < 0)
         return 0;
 
     /*  If it was the first timeout that was removed, the actual waiting time
         may have changed. We'll thus return 1 to let the user know. */
-    first = nn_list_begin (&self->timeouts) == &hndl->list ? 1 : 0;
-    nn_list_erase (&self->timeouts, &hndl->list);
+    first = hndl->index == 0 ? 1 : 0;
+    nn_timerset_erase (self, hndl->index);
     return first;
 }
 
@@ -83,11 +112,10 @@ int nn_timerset_timeout (struct nn_timerset *self)
 {
     int timeout;
 
-    if (nn_fast (nn_list_empty (&self->timeouts)))
+    if (nn_fast (self->size == 0))
         return -1;
 
-    timeout = (int) (nn_cont (nn_list_begin (&self->timeouts),
-        struct nn_timerset_hndl, list)->timeout - nn_clock_now (&self->clock));
+    timeout = (int) (self->heap [0]->timeout - nn_clock_now (&self->clock));
     return timeout < 0 ? 0 : timeout;
 }
 
@@ -96,34 +124,112 @@ int nn_timerset_event (struct nn_timerset *self, struct nn_timerset_hndl **hndl)
     struct nn_timerset_hndl *first;
 
     /*  If there's no timeout, there's no event to report. */
-    if (nn_fast (nn_list_empty (&self->timeouts)))
+    if (nn_fast (self->size == 0))
         return -EAGAIN;
 
     /*  If no timeout have expired yet, there's no event to return. */
-    first = nn_cont (nn_list_begin (&self->timeouts),
-        struct nn_timerset_hndl, list);
+    first = self->heap [0];
     if (first->timeout > nn_clock_now (&self->clock))
         return -EAGAIN;
 
-    /*  Return the first timeout and remove it from the list of active
+    /*  Return the first timeout and remove it from the set of active
         timeouts. */
-    nn_list_erase (&self->timeouts, &first->list);
+    nn_timerset_erase (self, 0);
     *hndl = first;
     return 0;
 }
 
 void nn_timerset_hndl_init (struct nn_timerset_hndl *self)
 {
-    nn_list_item_init (&self->list);
+    self->index = -1;
 }
 
 void nn_timerset_hndl_term (struct nn_timerset_hndl *self)
 {
-    nn_list_item_term (&self->list);
+    nn_assert (self->index < 0);
 }
 
 int nn_timerset_hndl_isactive (struct nn_timerset_hndl *self)
 {
-    return nn_list_item_isinlist (&self->list);
+    return self->index >= 0 ? 1 : 0;
+}
+
+static int nn_timerset_before (struct nn_timerset_hndl *a,
+    struct nn_timerset_hndl *b)
+{
+    if (a->timeout != b->timeout)
+        return a->timeout < b->timeout ? 1 : 0;
+    return a->seq < b->seq ? 1 : 0;
+}
+
+static void nn_timerset_up (struct nn_timerset *self, size_t index)
+{
+    struct nn_timerset_hndl *hndl;
+    size_t parent;
+
+    hndl = self->heap [index];
+    while (index > 0) {
+        parent = (index - 1) / NN_TIMERSET_ARITY;
+        if (!nn_timerset_before (hndl, self->heap [parent]))
+            break;
+        self->heap [index] = self->heap [parent];
+        self->heap [index]->index = (int) index;
+        index = parent;
+    }
+    self->heap [index] = hndl;
+    hndl->index = (int) index;
+}
+
+static void nn_timerset_down (struct nn_timerset *self, size_t index)
+{
+    struct nn_timerset_hndl *hndl;
+    size_t child;
+    size_t last;
+    size_t best;
+
+    hndl = self->heap [index];
+    while (1) {
+
+        /*  Find the child that expires first. */
+        child = index * NN_TIMERSET_ARITY + 1;
+        if (child >= self->size)
+            break;
+        last = child + NN_TIMERSET_ARITY;
+        if (last > self->size)
+            last = self->size;
+        best = child;
+        for (++child; child < last; ++child)
+            if (nn_timerset_before (self->heap [child], self->heap [best]))
+                best = child;
+
+        if (!nn_timerset_before (self->heap [best], hndl))
+            break;
+        self->heap [index] = self->heap [best];
+        self->heap [index]->index = (int) index;
+        index = best;
+    }
+    self->heap [index] = hndl;
+    hndl->index = (int) index;
+}
+
+static void nn_timerset_erase (struct nn_timerset *self, size_t index)
+{
+    struct nn_timerset_hndl *removed;
+
+    removed = self->heap [index];
+    removed->index = -1;
+    --self->size;
+
+    /*  Fill the hole with the last element of the heap and restore the heap
+        property. The element may have to move either way. */
+    if (index == self->size)
+        return;
+    self->heap [index] = self->heap [self->size];
+    self->heap [index]->index = (int) index;
+    if (index > 0 && nn_timerset_before (self->heap [index],
+          self->heap [(index - 1) / NN_TIMERSET_ARITY]))
+        nn_timerset_up (self, index);
+    else
+        nn_timerset_down (self, index);
 }
 
@@ -24,19 +24,33 @@
 #define NN_TIMERSET_INCLUDED
 
 #include "../utils/clock.h"
-#include "../utils/list.h"
 
-/*  This class stores a list of timeouts and reports the next one to expire
-    along with the time till it happens. */
+#include <stddef.h>
+
+/*  This class stores a set of timeouts and reports the next one to expire
+    along with the time till it happens. Timeouts are kept in an implicit
+    4-ary min-heap so that adding and removing a timeout is O(log n) and
+    retrieving the nearest one is O(1). Timeouts with the same expiry time
+    are reported in the order they were added. */
 
 struct nn_timerset_hndl {
-    struct nn_list_item list;
+
+    /*  Position of the handle in the heap, -1 if the handle is not active. */
+    int index;
+
+    /*  Instant when the timeout expires. */
     uint64_t timeout;
+
+    /*  Sequence number used to order timeouts with the same expiry time. */
+    uint64_t seq;
 };
 
 struct nn_timerset {
     struct nn_clock clock;
-    struct nn_list timeouts;
+    struct nn_timerset_hndl **heap;
+    size_t size;
+    size_t capacity;
+    uint64_t seq;
 };
 
 void nn_timerset_init (struct nn_timerset *self);
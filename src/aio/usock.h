@@ -36,12 +36,17 @@
 #define NN_USOCK_ERROR 5
 #define NN_USOCK_STOPPED 6
 
-/*  Maximum number of iovecs that can be passed to nn_usock_send function. */
-#define NN_USOCK_MAX_IOVCNT 3
-
-/*  Size of the buffer used for batch-reads of inbound data. To keep the
-    performance optimal make sure that this value is larger than network MTU. */
+/*  Maximum number of iovecs that can be passed to nn_usock_send function.
+    The value is high enough to allow sending a batch of messages using
+    a single system call. */
+#define NN_USOCK_MAX_IOVCNT 96
+
+/*  Initial size of the buffer used for batch-reads of inbound data. To keep
+    the performance optimal make sure that this value is larger than network
+    MTU. Whenever a batch-read fills the whole buffer, the buffer is doubled
+    up to NN_USOCK_MAX_BATCH_SIZE. */
 #define NN_USOCK_BATCH_SIZE 2048
+#define NN_USOCK_MAX_BATCH_SIZE 65536
 
 #if defined NN_HAVE_WINDOWS
 #include "usock_win.h"
@@ -86,4 +91,12 @@ void nn_usock_send (struct nn_usock *self, const struct nn_iovec *iov,
     int iovcnt);
 void nn_usock_recv (struct nn_usock *self, void *buf, size_t len);
 
+/*  Returns the data that were already read from the socket but not yet
+    received by the user. It's not allowed to call this function while
+    a receive operation is in progress. */
+size_t nn_usock_buffered (struct nn_usock *self, const void **data);
+
+/*  Drops 'len' bytes of the data returned by nn_usock_buffered. */
+void nn_usock_consume (struct nn_usock *self, size_t len);
+
 #endif
@@ -49,6 +49,9 @@ struct nn_usock {
         /*  Buffer for batch-reading inbound data. */
         uint8_t *batch;
 
+        /*  Allocated size of the batch buffer. */
+        size_t batch_size;
+
         /*  Size of the batch buffer. */
         size_t batch_len;
 
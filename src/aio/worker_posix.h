@@ -21,7 +21,7 @@
 */
 
 #include "../utils/queue.h"
-#include "../utils/mutex.h"
+#include "../utils/mpsc.h"
 #include "../utils/thread.h"
 #include "../utils/efd.h"
 
@@ -45,8 +45,10 @@ struct nn_worker_task {
 };
 
 struct nn_worker {
-    struct nn_mutex sync;
-    struct nn_queue tasks;
+
+    /*  Tasks posted to the worker thread. The efd is signaled only when
+        the first task is posted to an empty queue. */
+    struct nn_mpsc tasks;
     struct nn_queue_item stop;
     struct nn_efd efd;
     struct nn_poller poller;
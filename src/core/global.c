@@ -68,44 +68,90 @@
 #include "../protocols/bus/xbus.h"
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if defined NN_HAVE_WINDOWS
 #include "../utils/win.h"
 #endif
 
-/*  Max number of concurrent SP sockets. */
+/*  Name of the environment variable that specifies the maximal number of
+    concurrent SP sockets. */
+#define NN_MAX_SOCKETS_ENV "NN_MAX_SOCKETS"
+
+/*  Default max number of concurrent SP sockets. */
 #define NN_MAX_SOCKETS 512
 
-/*  To save some space, list of unused socket slots uses uint16_t integers to
-    refer to individual sockets. If there's a need to more that 0x10000 sockets,
-    the type should be changed to uint32_t or int. */
-CT_ASSERT (NN_MAX_SOCKETS <= 0x10000);
+/*  The socket table is split into shards of 2^NN_SHARD_BITS slots each.
+    Shards are allocated as needed and never moved so that sockets can be
+    looked up without locking. Together with NN_MAX_SHARDS it limits the
+    number of concurrent SP sockets to 2^20. */
+#define NN_SHARD_BITS 10
+#define NN_SHARD_SIZE (1 << NN_SHARD_BITS)
+#define NN_MAX_SHARDS 1024
+
+/*  Socket descriptor consists of the index to the socket table (lower 20
+    bits) and the generation of the slot (next 11 bits). The generation
+    is incremented each time the slot is reused so that a stale descriptor
+    of a closed socket doesn't refer to a new socket. */
+#define NN_INDEX_BITS 20
+#define NN_INDEX_MASK ((1 << NN_INDEX_BITS) - 1)
+#define NN_GEN_MASK 0x7ff
+CT_ASSERT (NN_SHARD_SIZE * NN_MAX_SHARDS == 1 << NN_INDEX_BITS);
 
 /*  This check is performed at the beginning of each socket operation to make
-    sure that the library was initialised and the socket actually exists. */
+    sure that the library was initialised and the socket actually exists.
+    It also retrieves the socket object. */
 #define NN_BASIC_CHECKS \
-    if (nn_slow (!self.socks || !self.socks [s])) {\
+    sock = nn_global_getsock (s);\
+    if (nn_slow (!sock)) {\
         errno = EBADF;\
         return -1;\
     }
 
 #define NN_CTX_FLAG_ZOMBIE 1
 
+/*  Maximum number of messages nn_sendmmsg and nn_recvmmsg pass to the socket
+    in a single batch. */
+#define NN_MMSG_BATCH 32
+
+struct nn_global_slot {
+
+    /*  The socket occupying the slot, NULL if the slot is unused. */
+    struct nn_sock *volatile sock;
+
+    /*  Descriptor of the socket occupying the slot, -1 if the slot is
+        unused. */
+    volatile int s;
+
+    /*  Generation of the slot. Used to create the next descriptor. */
+    int gen;
+
+    /*  Next slot in the list of unused slots, -1 if there's none. */
+    int next;
+};
+
 struct nn_global {
 
     /*  The global table of existing sockets. The descriptor representing
-        the socket is the index to this table. This pointer is also used to
-        find out whether context is initialised. If it is NULL, context is
-        uninitialised. */
-    struct nn_sock **socks;
+        the socket refers to a slot in this table. The first shard is also
+        used to find out whether context is initialised. If it is NULL,
+        context is uninitialised. */
+    struct nn_global_slot *volatile shards [NN_MAX_SHARDS];
 
-    /*  Stack of unused file descriptors. */
-    uint16_t *unused;
+    /*  Number of shards allocated. */
+    int nshards;
+
+    /*  List of unused slots, -1 if there's none. */
+    int unused;
 
     /*  Number of actual open sockets in the socket table. */
     size_t nsocks;
 
+    /*  Max number of sockets as specified by NN_MAX_SOCKETS environment
+        variable. */
+    size_t maxsocks;
+
     /*  Combination of the flags listed above. */
     int flags;
 
@@ -126,13 +172,28 @@ static struct nn_global self = {0};
 static void nn_global_init (void);
 static void nn_global_term (void);
 
+/*  Socket table-related private functions. */
+static size_t nn_global_maxsocks (void);
+static int nn_global_hdrtomsg (const struct nn_msghdr *msghdr,
+    struct nn_msg *msg, int addref);
+static void nn_global_hdrunref (const struct nn_msghdr *msghdr);
+static int nn_global_checkhdr (const struct nn_msghdr *msghdr);
+static int nn_global_msgtohdr (struct nn_sock *sock, struct nn_msg *msg,
+    struct nn_msghdr *msghdr);
+static struct nn_global_slot *nn_global_getslot (int index);
+static struct nn_sock *nn_global_getsock (int s);
+static int nn_global_add_shard (void);
+static int nn_global_alloc_slot (void);
+static void nn_global_free_slot (int s);
+
 /*  Transport-related private functions. */
 static void nn_global_add_transport (struct nn_transport *transport);
 static void nn_global_add_socktype (struct nn_socktype *socktype);
 
 /*  Private function that unifies nn_bind and nn_connect functionality.
     It returns the ID of the newly created endpoint. */
-static int nn_global_create_ep (int s, const char *addr, int bind);
+static int nn_global_create_ep (struct nn_sock *sock, const char *addr,
+    int bind);
 
 int nn_errno (void)
 {
@@ -158,14 +219,13 @@ struct nn_cmsghdr *nn_cmsg_nexthdr (const struct nn_msghdr *mhdr,
 
 static void nn_global_init (void)
 {
-    int i;
+    int rc;
 #if defined NN_HAVE_WINDOWS
     WSADATA data;
-    int rc;
 #endif
 
     /*  Check whether the library was already initialised. If so, do nothing. */
-    if (self.socks)
+    if (self.shards [0])
         return;
 
     /*  On Windows, initialise the socket library. */
@@ -182,20 +242,14 @@ static void nn_global_init (void)
     /*  Seed the pseudo-random number generator. */
     nn_random_seed ();
 
-    /*  Allocate the global table of SP sockets. */
-    self.socks = nn_alloc ((sizeof (struct nn_sock*) * NN_MAX_SOCKETS) +
-        (sizeof (uint16_t) * NN_MAX_SOCKETS), "socket table");
-    alloc_assert (self.socks);
-    for (i = 0; i != NN_MAX_SOCKETS; ++i)
-        self.socks [i] = NULL;
+    /*  Allocate the first shard of the global table of SP sockets. */
+    self.nshards = 0;
+    self.unused = -1;
     self.nsocks = 0;
+    self.maxsocks = nn_global_maxsocks ();
     self.flags = 0;
-
-    /*  Allocate the stack of unused file descriptors. */
-    self.unused = (uint16_t*) (self.socks + NN_MAX_SOCKETS);
-    alloc_assert (self.unused);
-    for (i = 0; i != NN_MAX_SOCKETS; ++i)
-        self.unused [i] = NN_MAX_SOCKETS - i - 1;
+    rc = nn_global_add_shard ();
+    errnum_assert (rc == 0, -rc);
 
     /*  Initialise other parts of the global state. */
     nn_list_init (&self.transports);
@@ -241,11 +295,12 @@ static void nn_global_term (void)
 #if defined NN_HAVE_WINDOWS
     int rc;
 #endif
+    int i;
     struct nn_list_item *it;
     struct nn_transport *tp;
 
     /*  If there are no sockets remaining, uninitialise the global context. */
-    nn_assert (self.socks);
+    nn_assert (self.shards [0]);
     if (self.nsocks > 0)
         return;
 
@@ -269,10 +324,14 @@ static void nn_global_term (void)
     /*  Final deallocation of the nn_global object itself. */
     nn_list_term (&self.socktypes);
     nn_list_term (&self.transports);
-    nn_free (self.socks);
+    for (i = self.nshards - 1; i >= 0; --i) {
+        nn_free (self.shards [i]);
 
-    /*  This marks the global state as uninitialised. */
-    self.socks = NULL;
+        /*  Resetting the first shard marks the global state as
+            uninitialised. */
+        self.shards [i] = NULL;
+    }
+    self.nshards = 0;
 
     /*  Shut down the memory allocation subsystem. */
     nn_alloc_term ();
@@ -287,6 +346,7 @@ static void nn_global_term (void)
 void nn_term (void)
 {
     int i;
+    int j;
 
     nn_glock_lock ();
 
@@ -294,10 +354,11 @@ void nn_term (void)
     self.flags |= NN_CTX_FLAG_ZOMBIE;
 
     /*  Mark all open sockets as terminating. */
-    if (self.socks && self.nsocks) {
-        for (i = 0; i != NN_MAX_SOCKETS; ++i)
-            if (self.socks [i])
-                nn_sock_zombify (self.socks [i]);
+    if (self.nsocks) {
+        for (i = 0; i != self.nshards; ++i)
+            for (j = 0; j != NN_SHARD_SIZE; ++j)
+                if (self.shards [i][j].sock)
+                    nn_sock_zombify (self.shards [i][j].sock);
     }
 
     nn_glock_unlock ();
@@ -305,7 +366,23 @@ void nn_term (void)
 
 void *nn_allocmsg (size_t size, int type)
 {
-    return nn_chunk_alloc (size, type);
+    void *msg;
+
+    msg = nn_chunk_alloc (size, type);
+    if (nn_slow (!msg))
+        errno = EINVAL;
+    return msg;
+}
+
+void *nn_wrapmsg (void *buf, size_t size,
+    void (*ffn) (void *buf, void *hint), void *hint)
+{
+    if (nn_slow (!buf && size)) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    return nn_chunk_wrap (buf, size, ffn, hint);
 }
 
 int nn_freemsg (void *msg)
@@ -343,56 +420,74 @@ int nn_socket (int domain, int protocol)
         return -1;
     }
 
-    /*  If socket limit was reached, report error. */
-    if (nn_slow (self.nsocks >= NN_MAX_SOCKETS)) {
+    /*  Find the appropriate socket type. */
+    socktype = NULL;
+    for (it = nn_list_begin (&self.socktypes);
+          it != nn_list_end (&self.socktypes);
+          it = nn_list_next (&self.socktypes, it)) {
+        socktype = nn_cont (it, struct nn_socktype, item);
+        if (socktype->domain == domain && socktype->protocol == protocol)
+            break;
+        socktype = NULL;
+    }
+    if (nn_slow (!socktype)) {
         nn_global_term ();
         nn_glock_unlock ();
-        errno = EMFILE;
+        errno = EINVAL;
         return -1;
     }
 
-    /*  Find an empty socket slot. */
-    s = self.unused [NN_MAX_SOCKETS - self.nsocks - 1];
+    /*  Find an empty socket slot. If socket limit was reached, report
+        error. */
+    s = nn_global_alloc_slot ();
+    if (nn_slow (s < 0)) {
+        nn_global_term ();
+        nn_glock_unlock ();
+        errno = -s;
+        return -1;
+    }
+    ++self.nsocks;
+    nn_glock_unlock ();
 
-    /*  Find the appropriate socket type. */
-    for (it = nn_list_begin (&self.socktypes);
-          it != nn_list_end (&self.socktypes);
-          it = nn_list_next (&self.socktypes, it)) {
-        socktype = nn_cont (it, struct nn_socktype, item);
-        if (socktype->domain == domain && socktype->protocol == protocol) {
-
-            /*  Instantiate the socket. */
-            sock = nn_alloc (sizeof (struct nn_sock), "sock");
-            alloc_assert (sock);
-            rc = nn_sock_init (sock, socktype);
-            if (rc < 0)
-                goto error;
-
-            /*  Adjust the global socket table. */
-            self.socks [s] = sock;
-            ++self.nsocks;
-            nn_glock_unlock ();
-            return s;
-        }
+    /*  Instantiate the socket. This is done outside of the global critical
+        section so that creating sockets in parallel doesn't serialise on
+        the socket initialisation. The slot is reserved meanwhile so that
+        the global state is not deallocated. */
+    sock = nn_alloc (sizeof (struct nn_sock), "sock");
+    alloc_assert (sock);
+    rc = nn_sock_init (sock, socktype);
+
+    nn_glock_lock ();
+    if (nn_slow (rc < 0)) {
+        nn_free (sock);
+        nn_global_free_slot (s);
+        --self.nsocks;
+        nn_global_term ();
+        nn_glock_unlock ();
+        errno = -rc;
+        return -1;
     }
-    rc = -EINVAL;
 
-    /*  Specified socket type wasn't found. */
-error:
-    nn_global_term ();
+    /*  Make the socket visible to the socket operations. If nn_term() was
+        called in the meantime, the socket has to be marked as terminating
+        straight away. */
+    nn_global_getslot (s & NN_INDEX_MASK)->sock = sock;
+    if (nn_slow (self.flags & NN_CTX_FLAG_ZOMBIE))
+        nn_sock_zombify (sock);
     nn_glock_unlock ();
-    errno = -rc;
-    return -1;
+
+    return s;
 }
 
 int nn_close (int s)
 {
     int rc;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
     /*  Deallocate the socket object. */
-    rc = nn_sock_term (self.socks [s]);
+    rc = nn_sock_term (sock);
     if (nn_slow (rc == -EINTR)) {
         errno = EINTR;
         return -1;
@@ -400,11 +495,10 @@ int nn_close (int s)
 
     nn_glock_lock ();
 
-    /*  Remove the socket from the socket table, add it to unused socket
-        table. */
-    nn_free (self.socks [s]);
-    self.socks [s] = NULL;
-    self.unused [NN_MAX_SOCKETS - self.nsocks] = s;
+    /*  Remove the socket from the socket table, add the slot to the list of
+        unused slots. */
+    nn_global_free_slot (s);
+    nn_free (sock);
     --self.nsocks;
 
     /*  Destroy the global context if there's no socket remaining. */
@@ -419,6 +513,7 @@ int nn_setsockopt (int s, int level, int option, const void *optval,
     size_t optvallen)
 {
     int rc;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
@@ -427,7 +522,7 @@ int nn_setsockopt (int s, int level, int option, const void *optval,
         return -1;
     }
 
-    rc = nn_sock_setopt (self.socks [s], level, option, optval, optvallen);
+    rc = nn_sock_setopt (sock, level, option, optval, optvallen);
     if (nn_slow (rc < 0)) {
         errno = -rc;
         return -1;
@@ -441,6 +536,7 @@ int nn_getsockopt (int s, int level, int option, void *optval,
     size_t *optvallen)
 {
     int rc;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
@@ -449,7 +545,7 @@ int nn_getsockopt (int s, int level, int option, void *optval,
         return -1;
     }
 
-    rc = nn_sock_getopt (self.socks [s], level, option, optval, optvallen);
+    rc = nn_sock_getopt (sock, level, option, optval, optvallen);
     if (nn_slow (rc < 0)) {
         errno = -rc;
         return -1;
@@ -462,10 +558,11 @@ int nn_getsockopt (int s, int level, int option, void *optval,
 int nn_bind (int s, const char *addr)
 {
     int rc;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
-    rc = nn_global_create_ep (s, addr, 1);
+    rc = nn_global_create_ep (sock, addr, 1);
     if (rc < 0) {
         errno = -rc;
         return -1;
@@ -477,10 +574,11 @@ int nn_bind (int s, const char *addr)
 int nn_connect (int s, const char *addr)
 {
     int rc;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
-    rc = nn_global_create_ep (s, addr, 0);
+    rc = nn_global_create_ep (sock, addr, 0);
     if (rc < 0) {
         errno = -rc;
         return -1;
@@ -492,10 +590,11 @@ int nn_connect (int s, const char *addr)
 int nn_shutdown (int s, int how)
 {
     int rc;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
-    rc = nn_sock_rm_ep (self.socks [s], how);
+    rc = nn_sock_rm_ep (sock, how);
     if (nn_slow (rc < 0)) {
         errno = -rc;
         return -1;
@@ -510,6 +609,7 @@ int nn_send (int s, const void *buf, size_t len, int flags)
     int rc;
     struct nn_msg msg;
     void *chunk;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
@@ -534,7 +634,7 @@ int nn_send (int s, const void *buf, size_t len, int flags)
     }
 
     /*  Send it further down the stack. */
-    rc = nn_sock_send (self.socks [s], &msg, flags);
+    rc = nn_sock_send (sock, &msg, flags);
     if (nn_slow (rc < 0)) {
         nn_msg_term (&msg);
         errno = -rc;
@@ -550,6 +650,8 @@ int nn_recv (int s, void *buf, size_t len, int flags)
     struct nn_msg msg;
     size_t sz;
     void *chunk;
+    void *data;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
@@ -558,20 +660,27 @@ int nn_recv (int s, void *buf, size_t len, int flags)
         return -1;
     }
 
-    rc = nn_sock_recv (self.socks [s], &msg, flags);
+    rc = nn_sock_recv (sock, &msg, flags);
     if (nn_slow (rc < 0)) {
         errno = -rc;
         return -1;
     }
 
     if (len == NN_MSG) {
+        data = nn_chunkref_data (&msg.body);
         chunk = nn_chunkref_getchunk (&msg.body);
         *(void**) buf = chunk;
         sz = nn_chunk_size (chunk);
+
+        /*  Small messages are not stored in a chunk of their own. Such
+            messages have to be copied to a newly allocated chunk. */
+        if (nn_slow (chunk != data))
+            nn_sock_copied (sock, sz);
     }
     else {
         sz = nn_chunkref_size (&msg.body);
         memcpy (buf, nn_chunkref_data (&msg.body), len < sz ? len : sz);
+        nn_sock_copied (sock, len < sz ? len : sz);
     }
     nn_msg_term (&msg);
 
@@ -581,32 +690,190 @@ int nn_recv (int s, void *buf, size_t len, int flags)
 int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags)
 {
     int rc;
-    size_t sz;
-    int i;
-    struct nn_iovec *iov;
+    int sz;
     struct nn_msg msg;
-    void *chunk;
+    struct nn_sock *sock;
 
     NN_BASIC_CHECKS;
 
-    if (nn_slow (!msghdr)) {
+    /*  Create a message object from the supplied scatter array. */
+    sz = nn_global_hdrtomsg (msghdr, &msg, 0);
+    if (nn_slow (sz < 0)) {
+        errno = -sz;
+        return -1;
+    }
+
+    /*  Send it further down the stack. */
+    rc = nn_sock_send (sock, &msg, flags);
+    if (nn_slow (rc < 0)) {
+        nn_msg_term (&msg);
+        errno = -rc;
+        return -1;
+    }
+
+    return sz;
+}
+
+int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags)
+{
+    int rc;
+    struct nn_msg msg;
+    struct nn_sock *sock;
+
+    NN_BASIC_CHECKS;
+
+    rc = nn_global_checkhdr (msghdr);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+
+    /*  Get a message. */
+    rc = nn_sock_recv (sock, &msg, flags);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+
+    return nn_global_msgtohdr (sock, &msg, msghdr);
+}
+
+int nn_sendmmsg (int s, struct nn_mmsghdr *msgvec, int vlen, int flags)
+{
+    int rc;
+    int i;
+    int n;
+    int sent;
+    struct nn_msg msgs [NN_MMSG_BATCH];
+    struct nn_sock *sock;
+
+    NN_BASIC_CHECKS;
+
+    if (nn_slow (vlen < 0 || (!msgvec && vlen))) {
         errno = EINVAL;
         return -1;
     }
 
-    if (nn_slow (msghdr->msg_iovlen < 0)) {
-        errno = EMSGSIZE;
+    sent = 0;
+    rc = 0;
+    while (sent != vlen) {
+
+        /*  Create message objects for the next batch. Chunks supplied by
+            the user are not consumed until the message is actually sent. */
+        for (n = 0; n != NN_MMSG_BATCH && sent + n != vlen; ++n) {
+            rc = nn_global_hdrtomsg (&msgvec [sent + n].msg_hdr, &msgs [n], 1);
+            if (nn_slow (rc < 0))
+                break;
+            msgvec [sent + n].msg_len = rc;
+        }
+        if (nn_slow (n == 0))
+            break;
+
+        /*  Pass the whole batch to the socket at once. Only the first batch
+            is allowed to block. */
+        rc = nn_sock_sendmany (sock, msgs, n,
+            sent ? flags | NN_DONTWAIT : flags);
+        if (nn_slow (rc < 0)) {
+            for (i = 0; i != n; ++i)
+                nn_msg_term (&msgs [i]);
+            break;
+        }
+
+        /*  Ownership of the chunks of the sent messages is passed to the
+            library. The messages that weren't sent are dropped while the
+            user keeps their chunks. */
+        for (i = 0; i != rc; ++i)
+            nn_global_hdrunref (&msgvec [sent + i].msg_hdr);
+        for (i = rc; i != n; ++i)
+            nn_msg_term (&msgs [i]);
+        sent += rc;
+        if (rc != n)
+            break;
+    }
+
+    /*  The error is reported only if no message was sent at all. */
+    if (nn_slow (sent == 0 && rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+
+    return sent;
+}
+
+int nn_recvmmsg (int s, struct nn_mmsghdr *msgvec, int vlen, int flags)
+{
+    int rc;
+    int i;
+    int n;
+    int received;
+    struct nn_msg msgs [NN_MMSG_BATCH];
+    struct nn_sock *sock;
+
+    NN_BASIC_CHECKS;
+
+    if (nn_slow (vlen < 0 || (!msgvec && vlen))) {
+        errno = EINVAL;
         return -1;
     }
 
-    if (msghdr->msg_iovlen == 1 && msghdr->msg_iov [0].iov_len == NN_MSG) {
-        chunk = *(void**) msghdr->msg_iov [0].iov_base;
-        if (nn_slow (chunk == NULL)) {
-            errno = EFAULT;
+    /*  Check all the gather arrays in advance so that no message is lost
+        because of an invalid one. */
+    for (i = 0; i != vlen; ++i) {
+        rc = nn_global_checkhdr (&msgvec [i].msg_hdr);
+        if (nn_slow (rc < 0)) {
+            errno = -rc;
+            return -1;
+        }
+    }
+
+    received = 0;
+    while (received != vlen) {
+
+        /*  Get the next batch of messages. Only the first batch is allowed
+            to block. */
+        n = vlen - received < NN_MMSG_BATCH ? vlen - received : NN_MMSG_BATCH;
+        rc = nn_sock_recvmany (sock, msgs, n,
+            received ? flags | NN_DONTWAIT : flags);
+        if (nn_slow (rc < 0)) {
+            if (received)
+                break;
+            errno = -rc;
             return -1;
         }
+
+        for (i = 0; i != rc; ++i)
+            msgvec [received + i].msg_len = nn_global_msgtohdr (sock,
+                &msgs [i], &msgvec [received + i].msg_hdr);
+        received += rc;
+        if (rc != n)
+            break;
+    }
+
+    return received;
+}
+
+static int nn_global_hdrtomsg (const struct nn_msghdr *msghdr,
+    struct nn_msg *msg, int addref)
+{
+    size_t sz;
+    int i;
+    struct nn_iovec *iov;
+    void *chunk;
+
+    if (nn_slow (!msghdr))
+        return -EINVAL;
+
+    if (nn_slow (msghdr->msg_iovlen < 0))
+        return -EMSGSIZE;
+
+    if (msghdr->msg_iovlen == 1 && msghdr->msg_iov [0].iov_len == NN_MSG) {
+        chunk = *(void**) msghdr->msg_iov [0].iov_base;
+        if (nn_slow (chunk == NULL))
+            return -EFAULT;
+        if (addref)
+            nn_chunk_addref (chunk, 1);
         sz = nn_chunk_size (chunk);
-        nn_msg_init_chunk (&msg, chunk);
+        nn_msg_init_chunk (msg, chunk);
     }
     else {
 
@@ -614,27 +881,21 @@ int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags)
         sz = 0;
         for (i = 0; i != msghdr->msg_iovlen; ++i) {
             iov = &msghdr->msg_iov [i];
-            if (nn_slow (iov->iov_len == NN_MSG)) {
-               errno = EINVAL;
-               return -1;
-            }
-            if (nn_slow (!iov->iov_base && iov->iov_len)) {
-                errno = EFAULT;
-                return -1;
-            }
-            if (nn_slow (sz + iov->iov_len < sz)) {
-                errno = EINVAL;
-                return -1;
-            }
+            if (nn_slow (iov->iov_len == NN_MSG))
+               return -EINVAL;
+            if (nn_slow (!iov->iov_base && iov->iov_len))
+                return -EFAULT;
+            if (nn_slow (sz + iov->iov_len < sz))
+                return -EINVAL;
             sz += iov->iov_len;
         }
 
         /*  Create a message object from the supplied scatter array. */
-        nn_msg_init (&msg, sz);
+        nn_msg_init (msg, sz);
         sz = 0;
         for (i = 0; i != msghdr->msg_iovlen; ++i) {
             iov = &msghdr->msg_iov [i];
-            memcpy (((uint8_t*) nn_chunkref_data (&msg.body)) + sz,
+            memcpy (((uint8_t*) nn_chunkref_data (&msg->body)) + sz,
                 iov->iov_base, iov->iov_len);
             sz += iov->iov_len;
         }
@@ -644,8 +905,10 @@ int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags)
     if (msghdr->msg_control) {
         if (msghdr->msg_controllen == NN_MSG) {
             chunk = *((void**) msghdr->msg_control);
-            nn_chunkref_term (&msg.hdr);
-            nn_chunkref_init_chunk (&msg.hdr, chunk);
+            if (addref)
+                nn_chunk_addref (chunk, 1);
+            nn_chunkref_term (&msg->hdr);
+            nn_chunkref_init_chunk (&msg->hdr, chunk);
         }
         else {
 
@@ -654,78 +917,80 @@ int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags)
         }
     }
 
-    /*  Send it further down the stack. */
-    rc = nn_sock_send (self.socks [s], &msg, flags);
-    if (nn_slow (rc < 0)) {
-        nn_msg_term (&msg);
-        errno = -rc;
-        return -1;
-    }
-
     return (int) sz;
 }
 
-int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags)
+static void nn_global_hdrunref (const struct nn_msghdr *msghdr)
+{
+    /*  Drops the references taken by nn_global_hdrtomsg on the chunks
+        supplied by the user. */
+    if (msghdr->msg_iovlen == 1 && msghdr->msg_iov [0].iov_len == NN_MSG)
+        nn_chunk_free (*(void**) msghdr->msg_iov [0].iov_base);
+    if (msghdr->msg_control && msghdr->msg_controllen == NN_MSG)
+        nn_chunk_free (*((void**) msghdr->msg_control));
+}
+
+static int nn_global_checkhdr (const struct nn_msghdr *msghdr)
 {
-    int rc;
-    struct nn_msg msg;
-    uint8_t *data;
-    size_t sz;
     int i;
-    struct nn_iovec *iov;
-    void *chunk;
 
-    NN_BASIC_CHECKS;
+    if (nn_slow (!msghdr))
+        return -EINVAL;
 
-    if (nn_slow (!msghdr)) {
-        errno = EINVAL;
-        return -1;
-    }
+    if (nn_slow (msghdr->msg_iovlen < 0))
+        return -EMSGSIZE;
 
-    if (nn_slow (msghdr->msg_iovlen < 0)) {
-        errno = EMSGSIZE;
-        return -1;
-    }
+    if (msghdr->msg_iovlen == 1 && msghdr->msg_iov [0].iov_len == NN_MSG)
+        return 0;
 
-    /*  Get a message. */
-    rc = nn_sock_recv (self.socks [s], &msg, flags);
-    if (nn_slow (rc < 0)) {
-        errno = -rc;
-        return -1;
-    }
+    for (i = 0; i != msghdr->msg_iovlen; ++i)
+        if (nn_slow (msghdr->msg_iov [i].iov_len == NN_MSG))
+            return -EINVAL;
+
+    return 0;
+}
+
+static int nn_global_msgtohdr (struct nn_sock *sock, struct nn_msg *msg,
+    struct nn_msghdr *msghdr)
+{
+    uint8_t *data;
+    size_t sz;
+    int i;
+    struct nn_iovec *iov;
+    void *chunk;
 
     if (msghdr->msg_iovlen == 1 && msghdr->msg_iov [0].iov_len == NN_MSG) {
-        chunk = nn_chunkref_getchunk (&msg.body);
+        data = nn_chunkref_data (&msg->body);
+        chunk = nn_chunkref_getchunk (&msg->body);
         *(void**) (msghdr->msg_iov [0].iov_base) = chunk;
         sz = nn_chunk_size (chunk);
+        if (nn_slow (chunk != data))
+            nn_sock_copied (sock, sz);
     }
     else {
 
         /*  Copy the message content into the supplied gather array. */
-        data = nn_chunkref_data (&msg.body);
-        sz = nn_chunkref_size (&msg.body);
+        data = nn_chunkref_data (&msg->body);
+        sz = nn_chunkref_size (&msg->body);
         for (i = 0; i != msghdr->msg_iovlen; ++i) {
             iov = &msghdr->msg_iov [i];
-            if (nn_slow (iov->iov_len == NN_MSG)) {
-                nn_msg_term (&msg);
-                errno = EINVAL;
-                return -1;
-            }
             if (iov->iov_len > sz) {
                 memcpy (iov->iov_base, data, sz);
+                sz = 0;
                 break;
             }
             memcpy (iov->iov_base, data, iov->iov_len);
             data += iov->iov_len;
             sz -= iov->iov_len;
         }
-        sz = nn_chunkref_size (&msg.body);
+        nn_sock_copied (sock, nn_chunkref_size (&msg->body) - sz);
+        sz = nn_chunkref_size (&msg->body);
     }
 
     /*  Retrieve the ancillary data from the message. */
     if (msghdr->msg_control) {
         if (msghdr->msg_controllen == NN_MSG) {
-            chunk = nn_chunkref_getchunk (&msg.hdr);
+            chunk = nn_chunkref_getchunk (&msg->hdr);
             *((void**) msghdr->msg_control) = chunk;
         }
         else {
@@ -736,11 +1001,118 @@ int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags)
         }   
     }
 
-    nn_msg_term (&msg);
+    nn_msg_term (msg);
 
     return (int) sz;
 }
 
+static size_t nn_global_maxsocks (void)
+{
+    const char *env;
+    int maxsocks;
+
+    env = getenv (NN_MAX_SOCKETS_ENV);
+    if (!env)
+        return NN_MAX_SOCKETS;
+    maxsocks = atoi (env);
+    if (maxsocks < 1)
+        return NN_MAX_SOCKETS;
+    if (maxsocks > NN_MAX_SHARDS * NN_SHARD_SIZE)
+        return NN_MAX_SHARDS * NN_SHARD_SIZE;
+    return maxsocks;
+}
+
+static struct nn_global_slot *nn_global_getslot (int index)
+{
+    return &self.shards [index >> NN_SHARD_BITS][index & (NN_SHARD_SIZE - 1)];
+}
+
+static struct nn_sock *nn_global_getsock (int s)
+{
+    struct nn_global_slot *shard;
+    struct nn_global_slot *slot;
+    struct nn_sock *sock;
+
+    /*  Shards are never deallocated while there are open sockets, so the
+        lookup needs no locking. The socket pointer is re-checked against the
+        descriptor to make sure it belongs to this generation of the slot. */
+    if (nn_slow (s < 0))
+        return NULL;
+    shard = self.shards [(s & NN_INDEX_MASK) >> NN_SHARD_BITS];
+    if (nn_slow (!shard))
+        return NULL;
+    slot = &shard [s & (NN_SHARD_SIZE - 1)];
+    sock = slot->sock;
+    if (nn_slow (slot->s != s))
+        return NULL;
+    return sock;
+}
+
+static int nn_global_add_shard (void)
+{
+    int i;
+    struct nn_global_slot *shard;
+
+    if (nn_slow (self.nshards == NN_MAX_SHARDS))
+        return -EMFILE;
+    shard = nn_alloc (sizeof (struct nn_global_slot) * NN_SHARD_SIZE,
+        "socket table shard");
+    if (nn_slow (!shard))
+        return -ENOMEM;
+
+    /*  Add the new slots to the list of unused slots in such a way that lower
+        indices are used first. */
+    for (i = NN_SHARD_SIZE - 1; i >= 0; --i) {
+        shard [i].sock = NULL;
+        shard [i].s = -1;
+        shard [i].gen = 0;
+        shard [i].next = self.unused;
+        self.unused = self.nshards * NN_SHARD_SIZE + i;
+    }
+    self.shards [self.nshards] = shard;
+    ++self.nshards;
+
+    return 0;
+}
+
+static int nn_global_alloc_slot (void)
+{
+    int rc;
+    int index;
+    struct nn_global_slot *slot;
+
+    if (nn_slow (self.nsocks >= self.maxsocks))
+        return -EMFILE;
+
+    /*  If there are no unused slots, grow the socket table. */
+    if (nn_slow (self.unused < 0)) {
+        rc = nn_global_add_shard ();
+        if (nn_slow (rc < 0))
+            return rc;
+    }
+
+    index = self.unused;
+    slot = nn_global_getslot (index);
+    self.unused = slot->next;
+    slot->s = (slot->gen << NN_INDEX_BITS) | index;
+
+    return slot->s;
+}
+
+static void nn_global_free_slot (int s)
+{
+    struct nn_global_slot *slot;
+
+    /*  Invalidate the descriptor before the socket pointer so that
+        nn_global_getsock doesn't return the socket being deallocated. */
+    slot = nn_global_getslot (s & NN_INDEX_MASK);
+    slot->s = -1;
+    slot->sock = NULL;
+    slot->gen = (slot->gen + 1) & NN_GEN_MASK;
+    slot->next = self.unused;
+    self.unused = s & NN_INDEX_MASK;
+}
+
 static void nn_global_add_transport (struct nn_transport *transport)
 {
     if (transport->init)
@@ -756,7 +1128,8 @@ static void nn_global_add_socktype (struct nn_socktype *socktype)
         nn_list_end (&self.socktypes));
 }
 
-static int nn_global_create_ep (int s, const char *addr, int bind)
+static int nn_global_create_ep (struct nn_sock *sock, const char *addr,
+    int bind)
 {
     int rc;
     const char *proto;
@@ -801,7 +1174,7 @@ static int nn_global_create_ep (int s, const char *addr, int bind)
     }
 
     /*  Ask the socket to create the endpoint. */
-    rc = nn_sock_add_ep (self.socks [s], tp, bind, addr);
+    rc = nn_sock_add_ep (sock, tp, bind, addr);
     nn_glock_unlock ();
     return rc;
 }
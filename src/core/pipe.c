@@ -122,6 +122,11 @@ void nn_pipebase_sent (struct nn_pipebase *self)
             (struct nn_pipe*) self, NN_PIPE_OUT);
 }
 
+void nn_pipebase_copied (struct nn_pipebase *self, size_t bytes)
+{
+    self->sock->rcvcopied += bytes;
+}
+
 struct nn_ctx *nn_pipebase_getctx (struct nn_pipebase *self)
 {
     return nn_sock_getctx (self->sock);
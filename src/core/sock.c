@@ -32,6 +32,8 @@
 #include "../utils/fast.h"
 #include "../utils/alloc.h"
 #include "../utils/msg.h"
+#include "../utils/stopwatch.h"
+#include "../utils/thread.h"
 
 /*  These bits specify whether individual efds are signalled or not at
     the moment. Storing this information allows us to avoid redundant signalling
@@ -39,6 +41,26 @@
 #define NN_SOCK_FLAG_IN 1
 #define NN_SOCK_FLAG_OUT 2
 
+/*  Set once the user has retrieved NN_SNDFD or NN_RCVFD. Until then the efds
+    are waited for only by nn_send() and nn_recv() themselves and the efd can
+    be left signalled even though the socket is no longer readable (writeable).
+    It is unsignalled only when a thread is actually about to wait for it.
+    That way a receiver that keeps up with the incoming messages doesn't
+    have to touch the efd for every single message. Any stale signal is
+    removed when the context is left after the flag is set. */
+#define NN_SOCK_FLAG_EXPORTED 4
+
+/*  Maximum value of NN_BUSY_POLL option, in microseconds. Keeps the adaptive
+    polling interval from overflowing when it's doubled. */
+#define NN_SOCK_MAX_BUSY_POLL 1000000
+
+/*  Maximum number of send lanes. */
+#define NN_SOCK_MAX_LANES 64
+
+/*  Protocol-specific options with IDs below this value are copied to
+    the send lanes when they are created. */
+#define NN_SOCK_MAX_PROTOOPT 16
+
 /*  Possible states of the socket. */
 #define NN_SOCK_STATE_INIT 1
 #define NN_SOCK_STATE_ACTIVE 2
@@ -53,12 +75,33 @@
 #define NN_SOCK_ACTION_CLOSE 3
 #define NN_SOCK_ACTION_STOPPED 4
 
+/*  Non-blocking send or recv of a batch of messages. It is executed within
+    the socket's context, possibly by a different thread. */
+struct nn_sock_xfer {
+    struct nn_ctx_op op;
+    struct nn_sock *sock;
+    struct nn_msg *msgs;
+    int count;
+    int send;
+    int rc;
+};
+
 /*  Private functions. */
 void nn_sock_adjust_events (struct nn_sock *self);
 struct nn_optset *nn_sock_optset (struct nn_sock *self, int id);
 static int nn_sock_setopt_inner (struct nn_sock *self, int level,
     int option, const void *optval, size_t optvallen);
+static int nn_sock_setlanes (struct nn_sock *self, int nlanes);
+static int nn_sock_sendlanes (struct nn_sock *self, struct nn_msg *msgs,
+    int count, int flags);
+static int nn_sock_sendlane (struct nn_sock *self, struct nn_msg *msgs,
+    int count, int flags);
+static void nn_sock_lanesout (struct nn_sock *self, int delta);
 static void nn_sock_onleave (struct nn_ctx *self);
+static void nn_sock_foldcopied (struct nn_sock *self);
+static void nn_sock_doxfer (struct nn_ctx_op *self);
+static int nn_sock_spin (struct nn_sock *self, struct nn_msg *msg, int send,
+    int *spin, int timeout);
 static void nn_sock_handler (struct nn_fsm *self, void *source, int type);
 
 int nn_sock_init (struct nn_sock *self, struct nn_socktype *socktype)
@@ -120,12 +163,25 @@ int nn_sock_init (struct nn_sock *self, struct nn_socktype *socktype)
     self->reconnect_ivl = 100;
     self->reconnect_ivl_max = 0;
     self->sndprio = 8;
+    self->busy_poll = 0;
+    self->sndspin = 0;
+    self->rcvspin = 0;
+    self->rcvcopied = 0;
+    nn_atomic_init (&self->usrcopied, 0);
+    self->efdcalls = 0;
 
     /*  The transport-specific options are not initialised immediately,
         rather, they are allocated later on when needed. */
     for (i = 0; i != NN_MAX_TRANSPORT; ++i)
         self->optsets [i] = NULL;
 
+    /*  Send lanes are created only if requested by the user. */
+    self->nlanes = 1;
+    self->lanes = NULL;
+    self->laneconnects = 0;
+    self->owner = NULL;
+    self->laneout = 0;
+
     /*  Create the specific socket type itself. */
     rc = socktype->create ((void*) self, &self->sockbase);
     errnum_assert (rc == 0, -rc);
@@ -150,9 +206,24 @@ void nn_sock_stopped (struct nn_sock *self)
 
 void nn_sock_zombify (struct nn_sock *self)
 {
+    int i;
+
     nn_ctx_enter (&self->ctx);
     nn_sock_handler (&self->fsm, NULL, NN_SOCK_ACTION_ZOMBIFY);
     nn_ctx_leave (&self->ctx);
+
+    for (i = 0; i != self->nlanes - 1; ++i)
+        nn_sock_zombify (self->lanes [i]);
+
+    /*  Unblock any thread waiting for one of the lanes to become
+        writeable. */
+    if (self->nlanes > 1) {
+        nn_mutex_lock (&self->lanesync);
+        if (!self->laneszombie && !self->lanesout)
+            nn_efd_signal (&self->lanefd);
+        self->laneszombie = 1;
+        nn_mutex_unlock (&self->lanesync);
+    }
 }
 
 int nn_sock_term (struct nn_sock *self)
@@ -160,6 +231,28 @@ int nn_sock_term (struct nn_sock *self)
     int rc;
     int i;
 
+    /*  Close the send lanes first. If interrupted, the lanes that were
+        already closed won't be closed again when nn_close() is retried. */
+    while (self->nlanes > 1) {
+        rc = nn_sock_term (self->lanes [self->nlanes - 2]);
+        if (nn_slow (rc == -EINTR))
+            return -EINTR;
+        errnum_assert (rc == 0, -rc);
+        nn_free (self->lanes [self->nlanes - 2]);
+        --self->nlanes;
+    }
+    if (self->lanes) {
+        nn_free (self->lanes);
+        self->lanes = NULL;
+
+        /*  No lane reports to this socket any more. */
+        nn_ctx_enter (&self->ctx);
+        self->owner = NULL;
+        nn_ctx_leave (&self->ctx);
+        nn_mutex_term (&self->lanesync);
+        nn_efd_term (&self->lanefd);
+    }
+
     /*  Ask the state machine to start closing the socket. */
     nn_ctx_enter (&self->ctx);
     nn_sock_handler (&self->fsm, NULL, NN_SOCK_ACTION_CLOSE);
@@ -185,6 +278,7 @@ int nn_sock_term (struct nn_sock *self)
     nn_sem_term (&self->termsem);
     nn_list_term (&self->eps);
     nn_clock_term (&self->clock);
+    nn_atomic_term (&self->usrcopied);
     nn_ctx_term (&self->ctx);
 
     /*  Destroy any optsets associated with the socket. */
@@ -218,6 +312,7 @@ int nn_sock_setopt (struct nn_sock *self, int level, int option,
     const void *optval, size_t optvallen)
 {
     int rc;
+    int i;
 
     nn_ctx_enter (&self->ctx);
     if (nn_slow (self->state == NN_SOCK_STATE_ZOMBIE)) {
@@ -227,6 +322,17 @@ int nn_sock_setopt (struct nn_sock *self, int level, int option,
     rc = nn_sock_setopt_inner (self, level, option, optval, optvallen);
     nn_ctx_leave (&self->ctx);
 
+    /*  The options apply to all the send lanes. */
+    if (rc == 0 && !(level == NN_SOL_SOCKET && option == NN_SNDLANES)) {
+        for (i = 0; i != self->nlanes - 1; ++i) {
+            rc = nn_sock_setopt (self->lanes [i], level, option, optval,
+                optvallen);
+            if (nn_slow (rc == -ETERM))
+                return rc;
+            errnum_assert (rc == 0, -rc);
+        }
+    }
+
     return rc;
 }
 
@@ -292,6 +398,15 @@ static int nn_sock_setopt_inner (struct nn_sock *self, int level,
                 return -EINVAL;
             dst = &self->sndprio;
             break;
+        case NN_BUSY_POLL:
+            if (nn_slow (val < 0 || val > NN_SOCK_MAX_BUSY_POLL))
+                return -EINVAL;
+            self->busy_poll = val;
+            self->sndspin = val;
+            self->rcvspin = val;
+            return 0;
+        case NN_SNDLANES:
+            return nn_sock_setlanes (self, val);
         default:
             return -ENOPROTOOPT;
         }
@@ -360,10 +475,23 @@ int nn_sock_getopt_inner (struct nn_sock *self, int level,
         case NN_SNDPRIO:
             intval = self->sndprio;
             break;
+        case NN_BUSY_POLL:
+            intval = self->busy_poll;
+            break;
+        case NN_SNDLANES:
+            if (!(self->socktype->flags & NN_SOCKTYPE_FLAG_LANES))
+                return -ENOPROTOOPT;
+            intval = self->nlanes;
+            break;
         case NN_SNDFD:
             if (self->socktype->flags & NN_SOCKTYPE_FLAG_NOSEND)
                 return -ENOPROTOOPT;
-            fd = nn_efd_getfd (&self->sndfd);
+            self->flags |= NN_SOCK_FLAG_EXPORTED;
+
+            /*  With multiple lanes, the socket is writeable if any of
+                the lanes is. */
+            fd = nn_efd_getfd (self->nlanes > 1 ? &self->lanefd :
+                &self->sndfd);
             memcpy (optval, &fd,
                 *optvallen < sizeof (nn_fd) ? *optvallen : sizeof (nn_fd));
             *optvallen = sizeof (nn_fd);
@@ -371,11 +499,23 @@ int nn_sock_getopt_inner (struct nn_sock *self, int level,
         case NN_RCVFD:
             if (self->socktype->flags & NN_SOCKTYPE_FLAG_NORECV)
                 return -ENOPROTOOPT;
+            self->flags |= NN_SOCK_FLAG_EXPORTED;
             fd = nn_efd_getfd (&self->rcvfd);
             memcpy (optval, &fd,
                 *optvallen < sizeof (nn_fd) ? *optvallen : sizeof (nn_fd));
             *optvallen = sizeof (nn_fd);
             return 0;
+        case NN_RCVCOPIED:
+            nn_sock_foldcopied (self);
+            memcpy (optval, &self->rcvcopied, *optvallen < sizeof (uint64_t) ?
+                *optvallen : sizeof (uint64_t));
+            *optvallen = sizeof (uint64_t);
+            return 0;
+        case NN_EFDCALLS:
+            memcpy (optval, &self->efdcalls, *optvallen < sizeof (uint64_t) ?
+                *optvallen : sizeof (uint64_t));
+            *optvallen = sizeof (uint64_t);
+            return 0;
         default:
             return -ENOPROTOOPT;
         }
@@ -409,9 +549,39 @@ int nn_sock_add_ep (struct nn_sock *self, struct nn_transport *transport,
     int rc;
     struct nn_ep *ep;
     int eid;
+    int index;
+    int i;
     
     nn_ctx_enter (&self->ctx);
 
+    /*  With multiple send lanes, connecting endpoints are distributed among
+        the lanes so that each lane has its own subset of the peers. The
+        endpoint ID is allocated by the socket itself. All the connections
+        accepted by a bound endpoint would end up in a single lane, thus
+        binding is not supported. */
+    if (self->nlanes > 1) {
+        if (bind) {
+            nn_ctx_leave (&self->ctx);
+            return -ENOTSUP;
+        }
+        i = self->laneconnects % self->nlanes;
+        ++self->laneconnects;
+        if (i) {
+            eid = self->eid;
+            ++self->eid;
+            nn_ctx_leave (&self->ctx);
+            self->lanes [i - 1]->eid = eid;
+            return nn_sock_add_ep (self->lanes [i - 1], transport, bind, addr);
+        }
+    }
+
+    /*  Create the transport's option set in advance so that the endpoint
+        can retrieve transport-specific options. The global lock is held by
+        the caller, thus nn_sock_optset() can't be used later on. */
+    index = (-transport->id) - 1;
+    if (transport->optset && !self->optsets [index])
+        self->optsets [index] = transport->optset ();
+
     /*  Instantiate the endpoint. */
     ep = nn_alloc (sizeof (struct nn_ep), "endpoint");
     rc = nn_ep_init (ep, self, self->eid, transport, bind, addr);
@@ -438,8 +608,14 @@ int nn_sock_rm_ep (struct nn_sock *self, int eid)
 {
     struct nn_list_item *it;
     struct nn_ep *ep;
+    int i;
 
-    nn_ctx_leave (&self->ctx);
+    /*  The endpoint may belong to one of the send lanes. */
+    for (i = 0; i != self->nlanes - 1; ++i)
+        if (nn_sock_rm_ep (self->lanes [i], eid) == 0)
+            return 0;
+
+    nn_ctx_enter (&self->ctx);
 
     /*  Find the specified enpoint. */
     ep = NULL;
@@ -470,14 +646,89 @@ int nn_sock_rm_ep (struct nn_sock *self, int eid)
 int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags)
 {
     int rc;
+
+    rc = nn_sock_sendmany (self, msg, 1, flags);
+    return rc < 0 ? rc : 0;
+}
+
+int nn_sock_sendmany (struct nn_sock *self, struct nn_msg *msgs, int count,
+    int flags)
+{
+    if (nn_slow (self->nlanes > 1))
+        return nn_sock_sendlanes (self, msgs, count, flags);
+    return nn_sock_sendlane (self, msgs, count, flags);
+}
+
+static int nn_sock_sendlanes (struct nn_sock *self, struct nn_msg *msgs,
+    int count, int flags)
+{
+    int rc;
+    int i;
+    int first;
+    int timeout;
+    uint64_t elapsed;
+    struct nn_stopwatch stopwatch;
+
+    /*  Each thread sends via the lane chosen by its identity. Threads using
+        different lanes don't contend for the same context. If the lane is
+        not writeable, e.g. because it has no peers, the other lanes are
+        tried in turn. */
+    first = nn_thread_hash () % self->nlanes;
+    timeout = self->sndtimeo;
+    if (timeout >= 0)
+        nn_stopwatch_init (&stopwatch);
+    while (1) {
+        for (i = 0; i != self->nlanes; ++i) {
+            rc = nn_sock_sendlane ((first + i) % self->nlanes ?
+                self->lanes [(first + i) % self->nlanes - 1] : self,
+                msgs, count, NN_DONTWAIT);
+            if (rc != -EAGAIN)
+                return rc;
+        }
+        if (flags & NN_DONTWAIT)
+            return -EAGAIN;
+
+        /*  Wait till one of the lanes becomes writeable. */
+        rc = nn_efd_wait (&self->lanefd, timeout);
+        if (nn_slow (rc == -ETIMEDOUT))
+            return -EAGAIN;
+        if (nn_slow (rc == -EINTR))
+            return -EINTR;
+        errnum_assert (rc == 0, rc);
+
+        if (self->sndtimeo >= 0) {
+            elapsed = nn_stopwatch_term (&stopwatch) / 1000;
+            timeout = elapsed >= (uint64_t) self->sndtimeo ? 0 :
+                self->sndtimeo - (int) elapsed;
+        }
+    }
+}
+
+static int nn_sock_sendlane (struct nn_sock *self, struct nn_msg *msgs,
+    int count, int flags)
+{
+    int rc;
+    int i;
     uint64_t deadline;
     uint64_t now;
     int timeout;
+    struct nn_sock_xfer xfer;
 
     /*  Some sockets types cannot be used for sending messages. */
     if (nn_slow (self->socktype->flags & NN_SOCKTYPE_FLAG_NOSEND))
         return -ENOTSUP;
 
+    /*  Try to send the messages without blocking first. If the socket is
+        being used by another thread at the moment, that thread does the
+        work on our behalf. */
+    xfer.sock = self;
+    xfer.msgs = msgs;
+    xfer.count = count;
+    xfer.send = 1;
+    nn_ctx_execute (&self->ctx, &xfer.op, nn_sock_doxfer);
+    if (nn_fast (xfer.rc != -EAGAIN) || flags & NN_DONTWAIT)
+        return xfer.rc;
+
     nn_ctx_enter (&self->ctx);
 
     /*  Compute the deadline for SNDTIMEO timer. */
@@ -497,11 +748,9 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags)
         }
 
         /*  Try to send the message in a non-blocking way. */
-        rc = self->sockbase->vfptr->send (self->sockbase, msg);
-        if (nn_fast (rc == 0)) {
-            nn_ctx_leave (&self->ctx);
-            return 0;
-        }
+        rc = self->sockbase->vfptr->send (self->sockbase, msgs);
+        if (nn_fast (rc == 0))
+            break;
         nn_assert (rc < 0);
 
         /*  Any unexpected error is forwarded to the caller. */
@@ -517,8 +766,32 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags)
             return -EAGAIN;
         }
 
+        /*  With busy polling, keep trying for a while before going to
+            sleep. */
+        if (self->sndspin) {
+            rc = nn_sock_spin (self, msgs, 1, &self->sndspin, timeout);
+            if (rc == 0)
+                break;
+            if (rc != -EAGAIN) {
+                nn_ctx_leave (&self->ctx);
+                return rc;
+            }
+
+            /*  The time spent busy polling counts towards SNDTIMEO. */
+            if (self->sndtimeo >= 0) {
+                now = nn_clock_now (&self->clock);
+                timeout = (int) (now > deadline ? 0 : deadline - now);
+            }
+        }
+
         /*  With blocking send, wait while there are new pipes available
-            for sending. */
+            for sending. The efd may have been left signalled, get rid of
+            the stale signal first. */
+        if (self->flags & NN_SOCK_FLAG_OUT) {
+            self->flags &= ~NN_SOCK_FLAG_OUT;
+            ++self->efdcalls;
+            nn_efd_unsignal (&self->sndfd);
+        }
         nn_ctx_leave (&self->ctx);
         rc = nn_efd_wait (&self->sndfd, timeout);
         if (nn_slow (rc == -ETIMEDOUT))
@@ -534,16 +807,39 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags)
             now = nn_clock_now (&self->clock);
             timeout = (int) (now > deadline ? 0 : deadline - now);
         }
-    }   
+    }
+
+    /*  The first message was sent. Send as many of the remaining
+        messages as possible without blocking and without leaving the
+        context. */
+    for (i = 1; i < count; ++i) {
+        rc = self->sockbase->vfptr->send (self->sockbase, &msgs [i]);
+        if (rc < 0)
+            break;
+    }
+    nn_ctx_leave (&self->ctx);
+
+    return i;
 }
 
 int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags)
 {
     int rc;
+
+    rc = nn_sock_recvmany (self, msg, 1, flags);
+    return rc < 0 ? rc : 0;
+}
+
+int nn_sock_recvmany (struct nn_sock *self, struct nn_msg *msgs, int count,
+    int flags)
+{
+    int rc;
+    int i;
     struct nn_sockbase *sockbase;
     uint64_t deadline;
     uint64_t now;
     int timeout;
+    struct nn_sock_xfer xfer;
 
     sockbase = (struct nn_sockbase*) self;
 
@@ -551,6 +847,17 @@ int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags)
     if (nn_slow (self->socktype->flags & NN_SOCKTYPE_FLAG_NORECV))
         return -ENOTSUP;
 
+    /*  Try to receive the messages without blocking first. If the socket is
+        being used by another thread at the moment, that thread does the
+        work on our behalf. */
+    xfer.sock = self;
+    xfer.msgs = msgs;
+    xfer.count = count;
+    xfer.send = 0;
+    nn_ctx_execute (&self->ctx, &xfer.op, nn_sock_doxfer);
+    if (nn_fast (xfer.rc != -EAGAIN) || flags & NN_DONTWAIT)
+        return xfer.rc;
+
     nn_ctx_enter (&self->ctx);
 
     /*  Compute the deadline for RCVTIMEO timer. */
@@ -570,11 +877,9 @@ int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags)
         }
 
         /*  Try to receive the message in a non-blocking way. */
-        rc = self->sockbase->vfptr->recv (self->sockbase, msg);
-        if (nn_fast (rc == 0)) {
-            nn_ctx_leave (&self->ctx);
-            return 0;
-        }
+        rc = self->sockbase->vfptr->recv (self->sockbase, msgs);
+        if (nn_fast (rc == 0))
+            break;
         nn_assert (rc < 0);
 
         /*  Any unexpected error is forwarded to the caller. */
@@ -590,8 +895,32 @@ int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags)
             return -EAGAIN;
         }
 
+        /*  With busy polling, keep trying for a while before going to
+            sleep. */
+        if (self->rcvspin) {
+            rc = nn_sock_spin (self, msgs, 0, &self->rcvspin, timeout);
+            if (rc == 0)
+                break;
+            if (rc != -EAGAIN) {
+                nn_ctx_leave (&self->ctx);
+                return rc;
+            }
+
+            /*  The time spent busy polling counts towards RCVTIMEO. */
+            if (self->rcvtimeo >= 0) {
+                now = nn_clock_now (&self->clock);
+                timeout = (int) (now > deadline ? 0 : deadline - now);
+            }
+        }
+
         /*  With blocking recv, wait while there are new pipes available
-            for receiving. */
+            for receiving. The efd may have been left signalled, get rid of
+            the stale signal first. */
+        if (self->flags & NN_SOCK_FLAG_IN) {
+            self->flags &= ~NN_SOCK_FLAG_IN;
+            ++self->efdcalls;
+            nn_efd_unsignal (&self->rcvfd);
+        }
         nn_ctx_leave (&self->ctx);
         rc = nn_efd_wait (&self->rcvfd, timeout);
         if (nn_slow (rc == -ETIMEDOUT))
@@ -607,7 +936,199 @@ int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags)
             now = nn_clock_now (&self->clock);
             timeout = (int) (now > deadline ? 0 : deadline - now);
         }
-    }  
+    }
+
+    /*  The first message was received. Receive as many of the remaining
+        messages as possible without blocking and without leaving the
+        context. */
+    for (i = 1; i < count; ++i) {
+        rc = self->sockbase->vfptr->recv (self->sockbase, &msgs [i]);
+        if (rc < 0)
+            break;
+    }
+    nn_ctx_leave (&self->ctx);
+
+    return i;
+}
+
+static int nn_sock_setlanes (struct nn_sock *self, int nlanes)
+{
+    int rc;
+    int err;
+    int i;
+    int opt;
+    int val;
+    size_t sz;
+    struct nn_sock *lane;
+
+    if (!(self->socktype->flags & NN_SOCKTYPE_FLAG_LANES))
+        return -ENOPROTOOPT;
+    if (nn_slow (nlanes < 1 || nlanes > NN_SOCK_MAX_LANES))
+        return -EINVAL;
+
+    /*  Endpoints and transport-specific options are not copied to the lanes,
+        thus the lanes have to be created before any of those exist. */
+    if (self->nlanes > 1 || !nn_list_empty (&self->eps))
+        return -EFSM;
+    for (i = 0; i != NN_MAX_TRANSPORT; ++i)
+        if (self->optsets [i])
+            return -EFSM;
+    if (nlanes == 1)
+        return 0;
+
+    err = nn_efd_init (&self->lanefd);
+    if (nn_slow (err < 0))
+        return err;
+    nn_mutex_init (&self->lanesync);
+    self->lanesout = 0;
+    self->laneszombie = 0;
+
+    self->lanes = nn_alloc (sizeof (struct nn_sock*) * (nlanes - 1),
+        "send lanes");
+    alloc_assert (self->lanes);
+    for (i = 0; i != nlanes - 1; ++i) {
+        lane = nn_alloc (sizeof (struct nn_sock), "sock");
+        alloc_assert (lane);
+        err = nn_sock_init (lane, self->socktype);
+        if (nn_slow (err < 0)) {
+            nn_free (lane);
+            while (i) {
+                --i;
+                rc = nn_sock_term (self->lanes [i]);
+                errnum_assert (rc == 0, -rc);
+                nn_free (self->lanes [i]);
+            }
+            nn_free (self->lanes);
+            self->lanes = NULL;
+            nn_mutex_term (&self->lanesync);
+            nn_efd_term (&self->lanefd);
+            return err;
+        }
+
+        /*  Copy the generic socket options. The lane is not used by anyone
+            else yet so there's no need to lock it. */
+        lane->linger = self->linger;
+        lane->sndbuf = self->sndbuf;
+        lane->rcvbuf = self->rcvbuf;
+        lane->sndtimeo = self->sndtimeo;
+        lane->rcvtimeo = self->rcvtimeo;
+        lane->reconnect_ivl = self->reconnect_ivl;
+        lane->reconnect_ivl_max = self->reconnect_ivl_max;
+        lane->sndprio = self->sndprio;
+        lane->busy_poll = self->busy_poll;
+        lane->sndspin = self->sndspin;
+        lane->rcvspin = self->rcvspin;
+
+        /*  Copy the integer protocol-specific options. Those the protocol
+            doesn't know are simply skipped. */
+        for (opt = 1; opt != NN_SOCK_MAX_PROTOOPT; ++opt) {
+            sz = sizeof (val);
+            rc = self->sockbase->vfptr->getopt (self->sockbase,
+                self->socktype->protocol, opt, &val, &sz);
+            if (rc == 0 && sz == sizeof (val))
+                lane->sockbase->vfptr->setopt (lane->sockbase,
+                    self->socktype->protocol, opt, &val, sz);
+        }
+
+        self->lanes [i] = lane;
+    }
+
+    /*  From now on, the lanes report whether they are writeable. Neither
+        the lanes nor this socket have any peers yet, so none of them is. */
+    for (i = 0; i != nlanes - 1; ++i)
+        self->lanes [i]->owner = self;
+    self->owner = self;
+    self->nlanes = nlanes;
+
+    return 0;
+}
+
+static void nn_sock_lanesout (struct nn_sock *self, int delta)
+{
+    /*  Called from the contexts of the individual lanes. 'lanefd' is kept
+        signalled exactly while at least one lane is writeable. */
+    nn_mutex_lock (&self->lanesync);
+    self->lanesout += delta;
+    if (!self->laneszombie) {
+        if (delta > 0 && self->lanesout == 1)
+            nn_efd_signal (&self->lanefd);
+        else if (delta < 0 && self->lanesout == 0)
+            nn_efd_unsignal (&self->lanefd);
+    }
+    nn_mutex_unlock (&self->lanesync);
+}
+
+static void nn_sock_doxfer (struct nn_ctx_op *self)
+{
+    struct nn_sock_xfer *xfer;
+    struct nn_sock *sock;
+    int rc;
+    int i;
+
+    xfer = nn_cont (self, struct nn_sock_xfer, op);
+    sock = xfer->sock;
+
+    /*  If nn_term() was already called, return ETERM. */
+    if (nn_slow (sock->state == NN_SOCK_STATE_ZOMBIE)) {
+        xfer->rc = -ETERM;
+        return;
+    }
+
+    /*  Account for the data copied by the previous receive operations. */
+    if (!xfer->send)
+        nn_sock_foldcopied (sock);
+
+    /*  Transfer as many messages as possible. Report the error only if
+        there was no message transferred at all. */
+    for (i = 0; i != xfer->count; ++i) {
+        rc = xfer->send ?
+            sock->sockbase->vfptr->send (sock->sockbase, &xfer->msgs [i]) :
+            sock->sockbase->vfptr->recv (sock->sockbase, &xfer->msgs [i]);
+        if (rc < 0)
+            break;
+    }
+    xfer->rc = i ? i : rc;
+}
+
+static int nn_sock_spin (struct nn_sock *self, struct nn_msg *msg, int send,
+    int *spin, int timeout)
+{
+    /*  Re-tries sending or receiving the message for up to '*spin'
+        microseconds, but not longer than 'timeout' milliseconds. The lock
+        is released between the attempts so that the worker threads can
+        deliver the message in the meantime. The interval is doubled each
+        time the busy-polling succeeds and halved each time it fails. */
+
+    int rc;
+    uint64_t limit;
+    struct nn_stopwatch stopwatch;
+
+    limit = *spin;
+    if (timeout >= 0 && limit > (uint64_t) timeout * 1000)
+        limit = (uint64_t) timeout * 1000;
+
+    nn_stopwatch_init (&stopwatch);
+    while (1) {
+        nn_ctx_leave (&self->ctx);
+        nn_relax ();
+        nn_ctx_enter (&self->ctx);
+
+        if (nn_slow (self->state == NN_SOCK_STATE_ZOMBIE))
+            return -ETERM;
+
+        rc = send ? self->sockbase->vfptr->send (self->sockbase, msg) :
+            self->sockbase->vfptr->recv (self->sockbase, msg);
+        if (rc != -EAGAIN) {
+            *spin = *spin * 2 < self->busy_poll ? *spin * 2 : self->busy_poll;
+            return rc;
+        }
+
+        if (nn_stopwatch_term (&stopwatch) >= limit) {
+            *spin = *spin / 2 > (self->busy_poll + 15) / 16 ?
+                *spin / 2 : (self->busy_poll + 15) / 16;
+            return -EAGAIN;
+        }
+    }
 }
 
 int nn_sock_add (struct nn_sock *self, struct nn_pipe *pipe)
@@ -620,6 +1141,28 @@ void nn_sock_rm (struct nn_sock *self, struct nn_pipe *pipe)
     self->sockbase->vfptr->rm (self->sockbase, pipe);
 }
 
+void nn_sock_copied (struct nn_sock *self, size_t bytes)
+{
+    /*  This is called after the message was received, i.e. outside of the
+        socket's context. Don't lock the socket again just for the counter. */
+    while (nn_slow (bytes > UINT32_MAX)) {
+        nn_atomic_inc (&self->usrcopied, UINT32_MAX);
+        bytes -= UINT32_MAX;
+    }
+    nn_atomic_inc (&self->usrcopied, (uint32_t) bytes);
+}
+
+static void nn_sock_foldcopied (struct nn_sock *self)
+{
+    uint32_t bytes;
+
+    bytes = nn_atomic_get (&self->usrcopied);
+    if (bytes) {
+        nn_atomic_dec (&self->usrcopied, bytes);
+        self->rcvcopied += bytes;
+    }
+}
+
 static void nn_sock_onleave (struct nn_ctx *self)
 {
     struct nn_sock *sock;
@@ -638,17 +1181,28 @@ static void nn_sock_onleave (struct nn_ctx *self)
     events = sock->sockbase->vfptr->events (sock->sockbase);
     errnum_assert (events >= 0, -events);
 
+    /*  If the socket is a send lane, let the owner know when the lane
+        becomes writeable or stops being writeable. */
+    if (sock->owner &&
+          !!(events & NN_SOCKBASE_EVENT_OUT) != sock->laneout) {
+        sock->laneout = !sock->laneout;
+        nn_sock_lanesout (sock->owner, sock->laneout ? 1 : -1);
+    }
+
     /*  Signal/unsignal IN as needed. */
     if (!(sock->socktype->flags & NN_SOCKTYPE_FLAG_NORECV)) {
         if (events & NN_SOCKBASE_EVENT_IN) {
             if (!(sock->flags & NN_SOCK_FLAG_IN)) {
                 sock->flags |= NN_SOCK_FLAG_IN;
+                ++sock->efdcalls;
                 nn_efd_signal (&sock->rcvfd);
             }
         }
         else {
-            if (sock->flags & NN_SOCK_FLAG_IN) {
+            if (sock->flags & NN_SOCK_FLAG_IN &&
+                  sock->flags & NN_SOCK_FLAG_EXPORTED) {
                 sock->flags &= ~NN_SOCK_FLAG_IN;
+                ++sock->efdcalls;
                 nn_efd_unsignal (&sock->rcvfd);
             }
         }
@@ -659,12 +1213,15 @@ static void nn_sock_onleave (struct nn_ctx *self)
         if (events & NN_SOCKBASE_EVENT_OUT) {
             if (!(sock->flags & NN_SOCK_FLAG_OUT)) {
                 sock->flags |= NN_SOCK_FLAG_OUT;
+                ++sock->efdcalls;
                 nn_efd_signal (&sock->sndfd);
             }
         }
         else {
-            if (sock->flags & NN_SOCK_FLAG_OUT) {
+            if (sock->flags & NN_SOCK_FLAG_OUT &&
+                  sock->flags & NN_SOCK_FLAG_EXPORTED) {
                 sock->flags &= ~NN_SOCK_FLAG_OUT;
+                ++sock->efdcalls;
                 nn_efd_unsignal (&sock->sndfd);
             }
         }
@@ -749,6 +1306,17 @@ static void nn_sock_handler (struct nn_fsm *self, void *source, int type)
                     nn_ep_stop (nn_cont (it, struct nn_ep, item));
                 sock->state = NN_SOCK_STATE_STOPPING_EPS;
 
+                /*  If there are no endpoints there will be no NN_EP_STOPPED
+                    events. Start stopping the protocol-specific part of
+                    the socket straight away. */
+                if (nn_list_empty (&sock->eps)) {
+                    sock->state = NN_SOCK_STATE_STOPPING;
+                    if (sock->sockbase->vfptr->stop)
+                        sock->sockbase->vfptr->stop (sock->sockbase);
+                    else
+                        nn_sock_stopped (sock);
+                }
+
                 return;
 
             case NN_SOCK_ACTION_ZOMBIFY:
@@ -760,13 +1328,17 @@ static void nn_sock_handler (struct nn_fsm *self, void *source, int type)
                 /*  Set IN and OUT events to unblock any polling function. */
                 if (!(sock->flags & NN_SOCK_FLAG_IN)) {
                     sock->flags |= NN_SOCK_FLAG_IN;
-                    if (!(sock->socktype->flags & NN_SOCKTYPE_FLAG_NORECV))
+                    if (!(sock->socktype->flags & NN_SOCKTYPE_FLAG_NORECV)) {
+                        ++sock->efdcalls;
                         nn_efd_signal (&sock->rcvfd);
+                    }
                 }
                 if (!(sock->flags & NN_SOCK_FLAG_OUT)) {
                     sock->flags |= NN_SOCK_FLAG_OUT;
-                    if (!(sock->socktype->flags & NN_SOCKTYPE_FLAG_NOSEND))
+                    if (!(sock->socktype->flags & NN_SOCKTYPE_FLAG_NOSEND)) {
+                        ++sock->efdcalls;
                         nn_efd_signal (&sock->sndfd);
+                    }
                 }
 
                 return;
@@ -776,8 +1348,17 @@ static void nn_sock_handler (struct nn_fsm *self, void *source, int type)
             }
         }
 
-        /*  The assumption is that all the other events come from pipes. */
+        /*  The assumption is that all the other events come from pipes or
+            from endpoints removed by nn_shutdown(). */
         switch (type) {
+        case NN_EP_STOPPED:
+
+            /*  Endpoint is stopped. Now we can safely deallocate it. */
+            ep = (struct nn_ep*) source;
+            nn_list_erase (&sock->eps, &ep->item);
+            nn_ep_term (ep);
+            nn_free (ep);
+            return;
         case NN_PIPE_IN:
             sock->sockbase->vfptr->in (sock->sockbase,
                 (struct nn_pipe*) source);
@@ -849,6 +1430,14 @@ static void nn_sock_handler (struct nn_fsm *self, void *source, int type)
 
             return;
 
+        case NN_PIPE_IN:
+        case NN_PIPE_OUT:
+
+            /*  A pipe may have been established while the endpoints were
+                being asked to stop. The socket is being closed so there's no
+                point in passing the event to the protocol. */
+            return;
+
         default:
             nn_assert (0);
         }
@@ -29,10 +29,12 @@
 #include "../aio/ctx.h"
 #include "../aio/fsm.h"
 
+#include "../utils/atomic.h"
 #include "../utils/efd.h"
 #include "../utils/sem.h"
 #include "../utils/clock.h"
 #include "../utils/list.h"
+#include "../utils/mutex.h"
 
 struct nn_pipe;
 
@@ -81,9 +83,54 @@ struct nn_sock
     int reconnect_ivl;
     int reconnect_ivl_max;
     int sndprio;
+    int busy_poll;
+
+    /*  Current busy-polling intervals for send and recv, in microseconds.
+        They adapt to the recent success rate of busy-polling, ranging
+        from 1/16 of NN_BUSY_POLL to the full value. */
+    int sndspin;
+    int rcvspin;
+
+    /*  Number of bytes of message data copied on the receive path. */
+    uint64_t rcvcopied;
+
+    /*  Bytes copied into user buffers outside of the socket's context.
+        They are added to rcvcopied next time the context is held by
+        a receive operation or by nn_getsockopt(). */
+    struct nn_atomic usrcopied;
+
+    /*  Number of system calls made to signal or unsignal the efds. */
+    uint64_t efdcalls;
 
     /*  Transport-specific socket options. */
     struct nn_optset *optsets [NN_MAX_TRANSPORT];
+
+    /*  Number of send lanes (see NN_SNDLANES). The socket itself is the first
+        lane. The remaining 'nlanes - 1' lanes are sockets of the same type
+        that are not visible to the user. Each of them has endpoints of its
+        own and thus its own subset of connections. 'laneconnects' is the
+        number of connecting endpoints created so far. It determines the lane
+        the next one is assigned to. */
+    int nlanes;
+    struct nn_sock **lanes;
+    int laneconnects;
+
+    /*  If the socket is one of the send lanes, including the first one,
+        this points to the socket owning the lanes. 'laneout' is set if
+        the owner was told that the lane is writeable. */
+    struct nn_sock *owner;
+    int laneout;
+
+    /*  Used by the socket owning the lanes only. 'lanefd' is signalled
+        while at least one of the lanes is writeable and it is returned
+        as NN_SNDFD. 'lanesout' is the number of writeable lanes. After
+        nn_term() was called, 'lanefd' is left signalled. These fields are
+        guarded by 'lanesync' as they are updated from the contexts of all
+        the lanes. */
+    struct nn_efd lanefd;
+    struct nn_mutex lanesync;
+    int lanesout;
+    int laneszombie;
 };
 
 /*  Initialise the socket. */
@@ -119,6 +166,20 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags);
 /*  Receive a message from the socket. */
 int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags);
 
+/*  Send up to 'count' messages to the socket. Only the first message is
+    subject to blocking and timeouts. The rest is sent while the socket is
+    still locked until the first one that can't be sent straight away.
+    Returns the number of messages sent or a negative error code if none
+    was sent. The messages that were not sent are left to the caller. */
+int nn_sock_sendmany (struct nn_sock *self, struct nn_msg *msgs, int count,
+    int flags);
+
+/*  Receive up to 'count' messages from the socket. Blocking and timeouts
+    apply to the first message only. Returns the number of messages
+    received or a negative error code if none was received. */
+int nn_sock_recvmany (struct nn_sock *self, struct nn_msg *msgs, int count,
+    int flags);
+
 /*  Set a socket option. */
 int nn_sock_setopt (struct nn_sock *self, int level, int option,
     const void *optval, size_t optvallen); 
@@ -136,4 +197,8 @@ int nn_sock_getopt_inner (struct nn_sock *self, int level, int option,
 int nn_sock_add (struct nn_sock *self, struct nn_pipe *pipe);
 void nn_sock_rm (struct nn_sock *self, struct nn_pipe *pipe);
 
+/*  Accounts for message data copied on the receive path outside of
+    the socket, e.g. into the user-supplied buffer. */
+void nn_sock_copied (struct nn_sock *self, size_t bytes);
+
 #endif
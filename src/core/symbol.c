@@ -82,11 +82,21 @@ static const struct sym_value_name sym_value_names [] = {
     {NN_RCVFD, "NN_RCVFD"},
     {NN_DOMAIN, "NN_DOMAIN"},
     {NN_PROTOCOL, "NN_PROTOCOL"},
+    {NN_RCVCOPIED, "NN_RCVCOPIED"},
+    {NN_BUSY_POLL, "NN_BUSY_POLL"},
+    {NN_EFDCALLS, "NN_EFDCALLS"},
+    {NN_SNDLANES, "NN_SNDLANES"},
 
     {NN_SUB_SUBSCRIBE, "NN_SUB_SUBSCRIBE"},
     {NN_SUB_UNSUBSCRIBE, "NN_SUB_UNSUBSCRIBE"},
     {NN_REQ_RESEND_IVL, "NN_REQ_RESEND_IVL"},
+    {NN_REQ_WINDOW, "NN_REQ_WINDOW"},
+    {NN_REQ_ID, "NN_REQ_ID"},
     {NN_SURVEYOR_DEADLINE, "NN_SURVEYOR_DEADLINE"},
+    {NN_SURVEYOR_WINDOW, "NN_SURVEYOR_WINDOW"},
+    {NN_SURVEYOR_ID, "NN_SURVEYOR_ID"},
+    {NN_PUSH_LEASTOUT, "NN_PUSH_LEASTOUT"},
+    {NN_PULL_ACK, "NN_PULL_ACK"},
 
     {NN_DONTWAIT, "NN_DONTWAIT"},
 
@@ -32,6 +32,9 @@ extern "C" {
 #define NN_PUSH (NN_PROTO_FANOUT * 16 + 0)
 #define NN_PULL (NN_PROTO_FANOUT * 16 + 1)
 
+#define NN_PUSH_LEASTOUT 1
+#define NN_PULL_ACK 1
+
 #ifdef __cplusplus
 }
 #endif
@@ -150,7 +150,13 @@ NN_EXPORT void nn_term (void);
 
 #define NN_MSG ((size_t) -1)
 
+/*  Allocation mechanisms that can be passed to nn_allocmsg. */
+#define NN_ALLOC_DEFAULT 0
+#define NN_ALLOC_POOLED 1
+
 NN_EXPORT void *nn_allocmsg (size_t size, int type);
+NN_EXPORT void *nn_wrapmsg (void *buf, size_t size,
+    void (*ffn) (void *buf, void *hint), void *hint);
 NN_EXPORT int nn_freemsg (void *msg);
 
 /******************************************************************************/
@@ -169,6 +175,11 @@ struct nn_msghdr {
     size_t msg_controllen;
 };
 
+struct nn_mmsghdr {
+    struct nn_msghdr msg_hdr;
+    size_t msg_len;
+};
+
 struct nn_cmsghdr {
     size_t cmsg_len;
     int cmsg_level;
@@ -226,6 +237,10 @@ NN_EXPORT struct nn_cmsghdr *nn_cmsg_nexthdr (const struct nn_msghdr *mhdr,
 #define NN_RCVFD 11
 #define NN_DOMAIN 12
 #define NN_PROTOCOL 13
+#define NN_RCVCOPIED 14
+#define NN_BUSY_POLL 15
+#define NN_EFDCALLS 16
+#define NN_SNDLANES 17
 
 /*  Send/recv options.                                                        */
 #define NN_DONTWAIT 1
@@ -243,6 +258,10 @@ NN_EXPORT int nn_send (int s, const void *buf, size_t len, int flags);
 NN_EXPORT int nn_recv (int s, void *buf, size_t len, int flags);
 NN_EXPORT int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags);
 NN_EXPORT int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags);
+NN_EXPORT int nn_sendmmsg (int s, struct nn_mmsghdr *msgvec, int vlen,
+    int flags);
+NN_EXPORT int nn_recvmmsg (int s, struct nn_mmsghdr *msgvec, int vlen,
+    int flags);
 
 /******************************************************************************/
 /*  Built-in support for devices.                                             */
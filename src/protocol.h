@@ -157,6 +157,11 @@ int nn_sockbase_getopt (struct nn_sockbase *self, int option,
 /*  Specifies that the socket type can be never used to send messages. */
 #define NN_SOCKTYPE_FLAG_NOSEND 2
 
+/*  Specifies that any message can be sent to any of the peers. Thus, the
+    socket can be split into several independent send lanes, each having its
+    own subset of the connections. See NN_SNDLANES socket option. */
+#define NN_SOCKTYPE_FLAG_LANES 4
+
 struct nn_socktype {
 
     /*  Domain and protocol IDs as specified in nn_socket() function. */
@@ -30,7 +30,7 @@
 static struct nn_socktype nn_push_socktype_struct = {
     AF_SP,
     NN_PUSH,
-    NN_SOCKTYPE_FLAG_NORECV,
+    NN_SOCKTYPE_FLAG_NORECV | NN_SOCKTYPE_FLAG_LANES,
     nn_xpush_create,
     nn_xpush_ispeer,
     NN_LIST_ITEM_INITIALIZER
@@ -32,16 +32,30 @@
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/list.h"
+#include "../../utils/msg.h"
+#include "../../utils/wire.h"
 
 struct nn_xpull {
     struct nn_sockbase sockbase;
     struct nn_excl excl;
+
+    /*  If set, number of received messages is reported back to the PUSH
+        socket so that it can send to the least loaded peer. */
+    int ack;
+
+    /*  Number of received messages not yet acknowledged. */
+    uint32_t acks;
+
+    /*  If set, an empty acknowledgement has to be sent to let the peer
+        know that the messages will be acknowledged. */
+    int announce;
 };
 
 /*  Private functions. */
 static void nn_xpull_init (struct nn_xpull *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint);
 static void nn_xpull_term (struct nn_xpull *self);
+static void nn_xpull_flush (struct nn_xpull *self);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_xpull_destroy (struct nn_sockbase *self);
@@ -74,6 +88,9 @@ static void nn_xpull_init (struct nn_xpull *self,
 {
     nn_sockbase_init (&self->sockbase, vfptr, hint);
     nn_excl_init (&self->excl);
+    self->ack = 0;
+    self->acks = 0;
+    self->announce = 0;
 }
 
 static void nn_xpull_term (struct nn_xpull *self)
@@ -94,13 +111,24 @@ void nn_xpull_destroy (struct nn_sockbase *self)
 
 static int nn_xpull_add (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    return nn_excl_add (&nn_cont (self, struct nn_xpull, sockbase)->excl,
-        pipe);
+    int rc;
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+    rc = nn_excl_add (&xpull->excl, pipe);
+    if (rc == 0)
+        xpull->announce = xpull->ack;
+    return rc;
 }
 
 static void nn_xpull_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    nn_excl_rm (&nn_cont (self, struct nn_xpull, sockbase)->excl, pipe);
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+    nn_excl_rm (&xpull->excl, pipe);
+    xpull->acks = 0;
+    xpull->announce = 0;
 }
 
 static void nn_xpull_in (struct nn_sockbase *self, struct nn_pipe *pipe)
@@ -110,7 +138,11 @@ static void nn_xpull_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 
 static void nn_xpull_out (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    nn_excl_out (&nn_cont (self, struct nn_xpull, sockbase)->excl, pipe);
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+    nn_excl_out (&xpull->excl, pipe);
+    nn_xpull_flush (xpull);
 }
 
 static int nn_xpull_events (struct nn_sockbase *self)
@@ -122,22 +154,84 @@ static int nn_xpull_events (struct nn_sockbase *self)
 static int nn_xpull_recv (struct nn_sockbase *self, struct nn_msg *msg)
 {
     int rc;
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+
+    rc = nn_excl_recv (&xpull->excl, msg);
+    if (nn_slow (rc < 0))
+        return rc;
 
-    rc = nn_excl_recv (&nn_cont (self, struct nn_xpull, sockbase)->excl, msg);
+    /*  Let the peer know the message was processed. */
+    if (xpull->ack) {
+        ++xpull->acks;
+        nn_xpull_flush (xpull);
+    }
 
     /*  Discard NN_PIPEBASE_PARSED flag. */
-    return rc < 0 ? rc : 0;
+    return 0;
+}
+
+static void nn_xpull_flush (struct nn_xpull *self)
+{
+    int rc;
+    struct nn_msg msg;
+
+    /*  If the pipe is not writeable at the moment, the acknowledgements
+        are accumulated and sent as a single message later on. */
+    if ((!self->acks && !self->announce) || !nn_excl_can_send (&self->excl))
+        return;
+
+    nn_msg_init (&msg, sizeof (uint32_t));
+    nn_putl (nn_chunkref_data (&msg.body), self->acks);
+    self->acks = 0;
+    self->announce = 0;
+    rc = nn_excl_send (&self->excl, &msg);
+    errnum_assert (rc >= 0, -rc);
 }
 
 static int nn_xpull_setopt (struct nn_sockbase *self, int level, int option,
         const void *optval, size_t optvallen)
 {
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+
+    if (level != NN_PULL)
+        return -ENOPROTOOPT;
+
+    if (option == NN_PULL_ACK) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        if (nn_slow (*(int*) optval != 0 && *(int*) optval != 1))
+            return -EINVAL;
+        xpull->announce = *(int*) optval && !xpull->ack;
+        xpull->ack = *(int*) optval;
+        nn_xpull_flush (xpull);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
 static int nn_xpull_getopt (struct nn_sockbase *self, int level, int option,
         void *optval, size_t *optvallen)
 {
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+
+    if (level != NN_PULL)
+        return -ENOPROTOOPT;
+
+    if (option == NN_PULL_ACK) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = xpull->ack;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
@@ -32,9 +32,15 @@
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/list.h"
+#include "../../utils/msg.h"
+#include "../../utils/wire.h"
 
 struct nn_xpush_data {
     struct nn_lb_data lb;
+
+    /*  Set once the peer has sent an acknowledgement. From then on the
+        outstanding messages are accounted for by the acknowledgements. */
+    int acking;
 };
 
 struct nn_xpush {
@@ -115,6 +121,7 @@ static int nn_xpush_add (struct nn_sockbase *self, struct nn_pipe *pipe)
     alloc_assert (data);
     nn_pipe_setdata (pipe, data);
     nn_lb_add (&xpush->lb, pipe, &data->lb, sndprio);
+    data->acking = 0;
 
     return 0;
 }
@@ -132,8 +139,29 @@ static void nn_xpush_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
 
 static void nn_xpush_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    /*  We are not going to receive any messages, so there's no need to store
-        the list of inbound pipes. */
+    int rc;
+    struct nn_xpush *xpush;
+    struct nn_xpush_data *data;
+    struct nn_msg msg;
+
+    xpush = nn_cont (self, struct nn_xpush, sockbase);
+    data = nn_pipe_getdata (pipe);
+
+    /*  The only messages PULL socket may send are acknowledgements, each
+        carrying number of messages it has processed. Anything else is
+        silently dropped. No need to store the list of inbound pipes. */
+    while (1) {
+        rc = nn_pipe_recv (pipe, &msg);
+        errnum_assert (rc >= 0, -rc);
+        if (nn_chunkref_size (&msg.body) == sizeof (uint32_t)) {
+            data->acking = 1;
+            nn_lb_processed (&xpush->lb, &data->lb,
+                nn_getl (nn_chunkref_data (&msg.body)));
+        }
+        nn_msg_term (&msg);
+        if (rc & NN_PIPE_RELEASE)
+            break;
+    }
 }
 
 static void nn_xpush_out (struct nn_sockbase *self, struct nn_pipe *pipe)
@@ -143,6 +171,13 @@ static void nn_xpush_out (struct nn_sockbase *self, struct nn_pipe *pipe)
 
     xpush = nn_cont (self, struct nn_xpush, sockbase);
     data = nn_pipe_getdata (pipe);
+
+    /*  If the peer doesn't acknowledge the messages, all we know is that
+        the ones sent so far have left the pipe. */
+    if (!data->acking)
+        nn_lb_processed (&xpush->lb, &data->lb,
+            (uint32_t) data->lb.outstanding);
+
     nn_lb_out (&xpush->lb, pipe, &data->lb);
 }
 
@@ -160,12 +195,43 @@ static int nn_xpush_send (struct nn_sockbase *self, struct nn_msg *msg)
 static int nn_xpush_setopt (struct nn_sockbase *self, int level, int option,
         const void *optval, size_t optvallen)
 {
+    struct nn_xpush *xpush;
+
+    xpush = nn_cont (self, struct nn_xpush, sockbase);
+
+    if (level != NN_PUSH)
+        return -ENOPROTOOPT;
+
+    if (option == NN_PUSH_LEASTOUT) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        if (nn_slow (*(int*) optval != 0 && *(int*) optval != 1))
+            return -EINVAL;
+        nn_lb_setleastout (&xpush->lb, *(int*) optval);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
 static int nn_xpush_getopt (struct nn_sockbase *self, int level, int option,
         void *optval, size_t *optvallen)
 {
+    struct nn_xpush *xpush;
+
+    xpush = nn_cont (self, struct nn_xpush, sockbase);
+
+    if (level != NN_PUSH)
+        return -ENOPROTOOPT;
+
+    if (option == NN_PUSH_LEASTOUT) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = xpush->lb.leastout;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
@@ -189,7 +255,7 @@ int nn_xpush_ispeer (int socktype)
 static struct nn_socktype nn_xpush_socktype_struct = {
     AF_SP_RAW,
     NN_PUSH,
-    NN_SOCKTYPE_FLAG_NORECV,
+    NN_SOCKTYPE_FLAG_NORECV | NN_SOCKTYPE_FLAG_LANES,
     nn_xpush_create,
     nn_xpush_ispeer,
     NN_LIST_ITEM_INITIALIZER
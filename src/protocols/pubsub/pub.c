@@ -21,6 +21,8 @@
 */
 
 #include "pub.h"
+#include "sub.h"
+#include "trie.h"
 
 #include "../../nn.h"
 #include "../../pubsub.h"
@@ -32,11 +34,19 @@
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/list.h"
+#include "../../utils/msg.h"
 
 #include <stddef.h>
 
 struct nn_pub_data {
     struct nn_dist_data item;
+
+    /*  Subscriptions forwarded by the subscriber. */
+    struct nn_trie trie;
+
+    /*  If 1, only messages matching the subscriptions are sent
+        to the pipe. */
+    int filter;
 };
 
 struct nn_pub {
@@ -46,12 +56,19 @@ struct nn_pub {
 
     /*  Distributor. */
     struct nn_dist outpipes;
+
+    /*  Number of pipes that have asked for filtering. While zero, messages
+        are simply sent to all the pipes. */
+    int filters;
 };
 
 /*  Private functions. */
 static void nn_pub_init (struct nn_pub *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint);
 static void nn_pub_term (struct nn_pub *self);
+static void nn_pub_command (struct nn_pub *self, struct nn_pub_data *data,
+    struct nn_msg *msg);
+static int nn_pub_match (struct nn_dist_data *item, struct nn_msg *msg);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_pub_destroy (struct nn_sockbase *self);
@@ -84,6 +101,7 @@ static void nn_pub_init (struct nn_pub *self,
 {
     nn_sockbase_init (&self->sockbase, vfptr, hint);
     nn_dist_init (&self->outpipes);
+    self->filters = 0;
 }
 
 static void nn_pub_term (struct nn_pub *self)
@@ -111,6 +129,8 @@ static int nn_pub_add (struct nn_sockbase *self, struct nn_pipe *pipe)
 
     data = nn_alloc (sizeof (struct nn_pub_data), "pipe data (pub)");
     alloc_assert (data);
+    nn_trie_init (&data->trie);
+    data->filter = 0;
     nn_dist_add (&pub->outpipes, pipe, &data->item);
     nn_pipe_setdata (pipe, data);
 
@@ -126,14 +146,33 @@ static void nn_pub_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
     data = nn_pipe_getdata (pipe);
 
     nn_dist_rm (&pub->outpipes, pipe, &data->item);
+    if (data->filter)
+        --pub->filters;
+    nn_trie_term (&data->trie);
 
     nn_free (data);
 }
 
 static void nn_pub_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    /*  We shouldn't get any messages from subscribers. */
-    nn_assert (0);
+    int rc;
+    struct nn_pub *pub;
+    struct nn_pub_data *data;
+    struct nn_msg msg;
+
+    pub = nn_cont (self, struct nn_pub, sockbase);
+    data = nn_pipe_getdata (pipe);
+
+    /*  The only messages coming from subscribers are subscription commands.
+        Process all of them that are available at the moment. */
+    while (1) {
+        rc = nn_pipe_recv (pipe, &msg);
+        errnum_assert (rc >= 0, -rc);
+        nn_pub_command (pub, data, &msg);
+        nn_msg_term (&msg);
+        if (rc & NN_PIPE_RELEASE)
+            break;
+    }
 }
 
 static void nn_pub_out (struct nn_sockbase *self, struct nn_pipe *pipe)
@@ -154,8 +193,13 @@ static int nn_pub_events (struct nn_sockbase *self)
 
 static int nn_pub_send (struct nn_sockbase *self, struct nn_msg *msg)
 {
-    return nn_dist_send (&nn_cont (self, struct nn_pub, sockbase)->outpipes,
-        msg, NULL);
+    struct nn_pub *pub;
+
+    pub = nn_cont (self, struct nn_pub, sockbase);
+
+    if (nn_fast (pub->filters == 0))
+        return nn_dist_send (&pub->outpipes, msg, NULL);
+    return nn_dist_send_matching (&pub->outpipes, msg, nn_pub_match);
 }
 
 static int nn_pub_setopt (struct nn_sockbase *self, int level, int option,
@@ -170,6 +214,61 @@ static int nn_pub_getopt (struct nn_sockbase *self, int level, int option,
     return -ENOPROTOOPT;
 }
 
+static void nn_pub_command (struct nn_pub *self, struct nn_pub_data *data,
+    struct nn_msg *msg)
+{
+    uint8_t *body;
+    size_t size;
+
+    body = nn_chunkref_data (&msg->body);
+    size = nn_chunkref_size (&msg->body);
+
+    /*  Ignore malformed commands. */
+    if (nn_slow (size < 1))
+        return;
+
+    switch (body [0]) {
+    case NN_SUB_CMD_SUBSCRIBE:
+        nn_trie_subscribe (&data->trie, body + 1, size - 1);
+        return;
+    case NN_SUB_CMD_UNSUBSCRIBE:
+        nn_trie_unsubscribe (&data->trie, body + 1, size - 1);
+        return;
+    case NN_SUB_CMD_FILTER:
+
+        /*  The subscriber is going to send the full list of its
+            subscriptions. Forget the old ones. */
+        nn_trie_term (&data->trie);
+        nn_trie_init (&data->trie);
+        if (!data->filter) {
+            data->filter = 1;
+            ++self->filters;
+        }
+        return;
+    case NN_SUB_CMD_NOFILTER:
+        if (data->filter) {
+            data->filter = 0;
+            --self->filters;
+        }
+        nn_trie_term (&data->trie);
+        nn_trie_init (&data->trie);
+        return;
+    default:
+        return;
+    }
+}
+
+static int nn_pub_match (struct nn_dist_data *item, struct nn_msg *msg)
+{
+    struct nn_pub_data *data;
+
+    data = nn_cont (item, struct nn_pub_data, item);
+    if (!data->filter)
+        return 1;
+    return nn_trie_match (&data->trie, nn_chunkref_data (&msg->body),
+        nn_chunkref_size (&msg->body));
+}
+
 static int nn_pub_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_pub *self;
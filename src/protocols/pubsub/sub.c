@@ -34,16 +34,51 @@
 #include "../../utils/alloc.h"
 #include "../../utils/list.h"
 
+#include <string.h>
+
+/*  Maximum number of messages received from the pipe and matched against
+    the subscriptions in one go. */
+#define NN_SUB_BATCH 16
+
+/*  Command waiting to be sent to the publisher. */
+struct nn_sub_cmd {
+    struct nn_list_item item;
+    struct nn_msg msg;
+};
+
 struct nn_sub {
     struct nn_sockbase sockbase;
     struct nn_excl excl;
     struct nn_trie trie;
+
+    /*  If 1, subscriptions are forwarded to the publisher. There's no way
+        to find out whether the publisher understands them, as everything it
+        sends is user data. Thus, it's up to the user to enable forwarding
+        only with publishers that do. */
+    int forward;
+
+    /*  Commands waiting to be sent to the publisher. */
+    struct nn_list cmds;
+
+    /*  Messages already received from the pipe and matched against the
+        subscriptions. Those between 'batch_pos' and 'batch_len' are yet
+        to be passed to the user. */
+    struct nn_msg batch [NN_SUB_BATCH];
+    int batch_pos;
+    int batch_len;
 };
 
 /*  Private functions. */
 static void nn_sub_init (struct nn_sub *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint);
 static void nn_sub_term (struct nn_sub *self);
+static void nn_sub_cmd (struct nn_sub *self, int cmd, const void *topic,
+    size_t topiclen);
+static void nn_sub_cmd_topic (void *arg, const uint8_t *data, size_t size);
+static void nn_sub_cmds_clear (struct nn_sub *self);
+static void nn_sub_resync (struct nn_sub *self);
+static void nn_sub_flush (struct nn_sub *self);
+static void nn_sub_refilter (struct nn_sub *self);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_sub_destroy (struct nn_sockbase *self);
@@ -77,10 +112,18 @@ static void nn_sub_init (struct nn_sub *self,
     nn_sockbase_init (&self->sockbase, vfptr, hint);
     nn_excl_init (&self->excl);
     nn_trie_init (&self->trie);
+    self->forward = 0;
+    nn_list_init (&self->cmds);
+    self->batch_pos = 0;
+    self->batch_len = 0;
 }
 
 static void nn_sub_term (struct nn_sub *self)
 {
+    while (self->batch_pos != self->batch_len)
+        nn_msg_term (&self->batch [self->batch_pos++]);
+    nn_sub_cmds_clear (self);
+    nn_list_term (&self->cmds);
     nn_trie_term (&self->trie);
     nn_excl_term (&self->excl);
     nn_sockbase_term (&self->sockbase);
@@ -98,12 +141,31 @@ void nn_sub_destroy (struct nn_sockbase *self)
 
 static int nn_sub_add (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    return nn_excl_add (&nn_cont (self, struct nn_sub, sockbase)->excl, pipe);
+    int rc;
+    struct nn_sub *sub;
+
+    sub = nn_cont (self, struct nn_sub, sockbase);
+
+    rc = nn_excl_add (&sub->excl, pipe);
+    if (nn_slow (rc < 0))
+        return rc;
+
+    /*  Let the new publisher know about all the subscriptions. The commands
+        will be sent once the pipe becomes writeable. */
+    if (sub->forward)
+        nn_sub_resync (sub);
+
+    return 0;
 }
 
 static void nn_sub_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    nn_excl_rm (&nn_cont (self, struct nn_sub, sockbase)->excl, pipe);
+    struct nn_sub *sub;
+
+    sub = nn_cont (self, struct nn_sub, sockbase);
+
+    nn_excl_rm (&sub->excl, pipe);
+    nn_sub_cmds_clear (sub);
 }
 
 static void nn_sub_in (struct nn_sockbase *self, struct nn_pipe *pipe)
@@ -113,37 +175,73 @@ static void nn_sub_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 
 static void nn_sub_out (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    nn_excl_out (&nn_cont (self, struct nn_sub, sockbase)->excl, pipe);
+    struct nn_sub *sub;
+
+    sub = nn_cont (self, struct nn_sub, sockbase);
+
+    nn_excl_out (&sub->excl, pipe);
+    nn_sub_flush (sub);
 }
 
 static int nn_sub_events (struct nn_sockbase *self)
 {
-    return nn_excl_can_recv (&nn_cont (self, struct nn_sub, sockbase)->excl) ?
-        NN_SOCKBASE_EVENT_IN : 0;
+    struct nn_sub *sub;
+
+    sub = nn_cont (self, struct nn_sub, sockbase);
+
+    return sub->batch_pos != sub->batch_len ||
+        nn_excl_can_recv (&sub->excl) ? NN_SOCKBASE_EVENT_IN : 0;
 }
 
 static int nn_sub_recv (struct nn_sockbase *self, struct nn_msg *msg)
 {
     int rc;
+    int i;
+    int count;
     struct nn_sub *sub;
+    const uint8_t *data [NN_SUB_BATCH];
+    size_t sizes [NN_SUB_BATCH];
+    int results [NN_SUB_BATCH];
 
     sub = nn_cont (self, struct nn_sub, sockbase);
 
     /*  Loop while a matching message is found or when there are no more
         messages to receive. */
-    while (1) {
-        rc = nn_excl_recv (&sub->excl, msg);
-        if (nn_slow (rc == -EAGAIN))
+    while (sub->batch_pos == sub->batch_len) {
+
+        /*  Receive all the messages available at the moment, up to the
+            batch size, and match them all at once. */
+        count = 0;
+        while (count != NN_SUB_BATCH) {
+            rc = nn_excl_recv (&sub->excl, &sub->batch [count]);
+            if (rc == -EAGAIN)
+                break;
+            errnum_assert (rc >= 0, -rc);
+            data [count] = nn_chunkref_data (&sub->batch [count].body);
+            sizes [count] = nn_chunkref_size (&sub->batch [count].body);
+            ++count;
+        }
+        if (nn_slow (!count))
             return -EAGAIN;
-        errnum_assert (rc >= 0, -rc);
-        rc = nn_trie_match (&sub->trie, nn_chunkref_data (&msg->body),
-            nn_chunkref_size (&msg->body));
-        if (rc == 0)
-            continue;
-        if (rc == 1)
-            return 0;
-        errnum_assert (0, -rc);
+        nn_trie_match_many (&sub->trie, data, sizes, count, results);
+
+        /*  Drop the messages that don't match. */
+        sub->batch_pos = 0;
+        sub->batch_len = 0;
+        for (i = 0; i != count; ++i) {
+            if (!results [i]) {
+                nn_msg_term (&sub->batch [i]);
+                continue;
+            }
+            if (i != sub->batch_len)
+                nn_msg_mv (&sub->batch [sub->batch_len], &sub->batch [i]);
+            ++sub->batch_len;
+        }
     }
+
+    nn_msg_mv (msg, &sub->batch [sub->batch_pos]);
+    ++sub->batch_pos;
+    return 0;
 }
 
 static int nn_sub_setopt (struct nn_sockbase *self, int level, int option,
@@ -159,16 +257,48 @@ static int nn_sub_setopt (struct nn_sockbase *self, int level, int option,
 
     if (option == NN_SUB_SUBSCRIBE) {
         rc = nn_trie_subscribe (&sub->trie, optval, optvallen);
-        if (rc >= 0)
-            return 0;
-        return rc;
+        if (rc < 0)
+            return rc;
+
+        /*  Only the changes to the set of subscriptions are forwarded. */
+        if (rc == 1 && sub->forward && sub->excl.pipe) {
+            nn_sub_cmd (sub, NN_SUB_CMD_SUBSCRIBE, optval, optvallen);
+            nn_sub_flush (sub);
+        }
+        return 0;
     }
 
     if (option == NN_SUB_UNSUBSCRIBE) {
         rc = nn_trie_unsubscribe (&sub->trie, optval, optvallen);
-        if (rc >= 0)
+        if (rc < 0)
+            return rc;
+        if (rc == 1 && sub->forward && sub->excl.pipe) {
+            nn_sub_cmd (sub, NN_SUB_CMD_UNSUBSCRIBE, optval, optvallen);
+            nn_sub_flush (sub);
+        }
+        if (rc == 1)
+            nn_sub_refilter (sub);
+        return 0;
+    }
+
+    if (option == NN_SUB_FORWARD) {
+        if (optvallen != sizeof (int))
+            return -EINVAL;
+        if (!!*(int*) optval == sub->forward)
             return 0;
-        return rc;
+        sub->forward = !!*(int*) optval;
+
+        /*  Turn the filtering in the publisher on or off. */
+        if (sub->excl.pipe) {
+            if (sub->forward)
+                nn_sub_resync (sub);
+            else {
+                nn_sub_cmds_clear (sub);
+                nn_sub_cmd (sub, NN_SUB_CMD_NOFILTER, NULL, 0);
+            }
+            nn_sub_flush (sub);
+        }
+        return 0;
     }
 
     return -ENOPROTOOPT;
@@ -177,9 +307,103 @@ static int nn_sub_setopt (struct nn_sockbase *self, int level, int option,
 static int nn_sub_getopt (struct nn_sockbase *self, int level, int option,
         void *optval, size_t *optvallen)
 {
+    struct nn_sub *sub;
+
+    sub = nn_cont (self, struct nn_sub, sockbase);
+
+    if (level == NN_SUB && option == NN_SUB_FORWARD) {
+        if (*optvallen < sizeof (int))
+            return -EINVAL;
+        *(int*) optval = sub->forward;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
+static void nn_sub_cmd (struct nn_sub *self, int cmd, const void *topic,
+    size_t topiclen)
+{
+    struct nn_sub_cmd *c;
+    uint8_t *data;
+
+    c = nn_alloc (sizeof (struct nn_sub_cmd), "subscription command");
+    alloc_assert (c);
+    nn_msg_init (&c->msg, 1 + topiclen);
+    data = nn_chunkref_data (&c->msg.body);
+    data [0] = (uint8_t) cmd;
+    if (topiclen)
+        memcpy (data + 1, topic, topiclen);
+    nn_list_item_init (&c->item);
+    nn_list_insert (&self->cmds, &c->item, nn_list_end (&self->cmds));
+}
+
+static void nn_sub_cmd_topic (void *arg, const uint8_t *data, size_t size)
+{
+    nn_sub_cmd ((struct nn_sub*) arg, NN_SUB_CMD_SUBSCRIBE, data, size);
+}
+
+static void nn_sub_cmds_clear (struct nn_sub *self)
+{
+    struct nn_sub_cmd *c;
+
+    while (!nn_list_empty (&self->cmds)) {
+        c = nn_cont (nn_list_begin (&self->cmds), struct nn_sub_cmd, item);
+        nn_list_erase (&self->cmds, &c->item);
+        nn_list_item_term (&c->item);
+        nn_msg_term (&c->msg);
+        nn_free (c);
+    }
+}
+
+static void nn_sub_resync (struct nn_sub *self)
+{
+    /*  Any commands not yet sent are superseded by the full list
+        of subscriptions. */
+    nn_sub_cmds_clear (self);
+    nn_sub_cmd (self, NN_SUB_CMD_FILTER, NULL, 0);
+    nn_trie_foreach (&self->trie, nn_sub_cmd_topic, self);
+}
+
+static void nn_sub_flush (struct nn_sub *self)
+{
+    int rc;
+    struct nn_sub_cmd *c;
+
+    while (!nn_list_empty (&self->cmds) && nn_excl_can_send (&self->excl)) {
+        c = nn_cont (nn_list_begin (&self->cmds), struct nn_sub_cmd, item);
+        nn_list_erase (&self->cmds, &c->item);
+        nn_list_item_term (&c->item);
+        rc = nn_excl_send (&self->excl, &c->msg);
+        errnum_assert (rc >= 0, -rc);
+        nn_free (c);
+    }
+}
+
+static void nn_sub_refilter (struct nn_sub *self)
+{
+    /*  Drop the messages already received that don't match
+        the subscriptions any more. */
+
+    int i;
+    int len;
+
+    len = self->batch_pos;
+    for (i = self->batch_pos; i != self->batch_len; ++i) {
+        if (!nn_trie_match (&self->trie,
+              nn_chunkref_data (&self->batch [i].body),
+              nn_chunkref_size (&self->batch [i].body))) {
+            nn_msg_term (&self->batch [i]);
+            continue;
+        }
+        if (i != len)
+            nn_msg_mv (&self->batch [len], &self->batch [i]);
+        ++len;
+    }
+    self->batch_len = len;
+}
+
 static int nn_sub_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_sub *self;
@@ -207,4 +431,3 @@ static struct nn_socktype nn_sub_socktype_struct = {
 };
 
 struct nn_socktype *nn_sub_socktype = &nn_sub_socktype_struct;
-
@@ -27,4 +27,15 @@
 
 extern struct nn_socktype *nn_sub_socktype;
 
+/*  If NN_SUB_FORWARD option is set, SUB socket sends the following commands
+    to the publisher so that it can filter out the messages nobody is
+    subscribed to. The first byte of the message is the command, followed
+    by the topic in case of NN_SUB_CMD_SUBSCRIBE and NN_SUB_CMD_UNSUBSCRIBE.
+    NN_SUB_CMD_FILTER tells the publisher to send only the messages matching
+    subsequent subscriptions, NN_SUB_CMD_NOFILTER to send all messages. */
+#define NN_SUB_CMD_UNSUBSCRIBE 0
+#define NN_SUB_CMD_SUBSCRIBE 1
+#define NN_SUB_CMD_FILTER 2
+#define NN_SUB_CMD_NOFILTER 3
+
 #endif
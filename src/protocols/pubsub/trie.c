@@ -29,22 +29,72 @@
 #include "../../utils/fast.h"
 #include "../../utils/err.h"
 
+/*  The flat copy of the trie is rebuilt only after the trie was matched
+    against at least this many strings since it was last modified, and at
+    least as many times as there were nodes in the previous flat copy. That
+    way the cost of rebuilding is amortised over the matches and frequent
+    subscribing and unsubscribing doesn't cause the trie to be copied over
+    and over again. */
+#define NN_TRIE_REBUILD_MIN 1024
+
+/*  Maximum number of strings traversed in parallel by nn_trie_match_many. */
+#define NN_TRIE_BATCH 16
+
+/*  State of a single traversal in nn_trie_match_many. */
+struct nn_trie_cursor {
+    struct nn_trie_node *node;
+    const uint8_t *data;
+    size_t size;
+    int index;
+};
+
+/*  SSE2 is available on all x86-64 CPUs and on most 32-bit x86 ones, so it's
+    selected at compile time. Other platforms use the plain C code. */
+#if defined __SSE2__ || defined _M_X64 || \
+    (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define NN_TRIE_SSE2
+#include <emmintrin.h>
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 /*  Double check that the size of node structure is as small as
     we believe it to be. */
 CT_ASSERT (sizeof (struct nn_trie_node) == 24);
 
+/*  Prefix is compared as a 16-byte block, so it must not be too close
+    to the end of the node. */
+CT_ASSERT (offsetof (struct nn_trie_node, prefix) + 16 <=
+    sizeof (struct nn_trie_node));
+
 /*  Forward declarations. */
 static struct nn_trie_node *nn_node_compact (struct nn_trie_node *self);
 static int nn_node_check_prefix (struct nn_trie_node *self,
     const uint8_t *data, size_t size);
+#if defined NN_TRIE_SSE2
+static int nn_trie_ctz (unsigned int mask);
+#endif
 static struct nn_trie_node **nn_node_child (struct nn_trie_node *self,
     int index);
 static struct nn_trie_node **nn_node_next (struct nn_trie_node *self,
     uint8_t c);
+static int nn_node_index (struct nn_trie_node *self, uint8_t c);
+static int nn_node_children (struct nn_trie_node *self);
 static int nn_node_unsubscribe (struct nn_trie_node **self,
     const uint8_t *data, size_t size);
 static void nn_node_term (struct nn_trie_node *self);
 static int nn_node_has_subscribers (struct nn_trie_node *self);
+static int nn_node_step (const uint8_t *flat, struct nn_trie_node **node,
+    const uint8_t **data, size_t *size);
+static const uint8_t *nn_trie_flatten (struct nn_trie *self, size_t matches);
+static void nn_trie_invalidate (struct nn_trie *self);
+static int nn_trie_insert (struct nn_trie *self, const uint8_t *data,
+    size_t size);
+static size_t nn_node_flat_size (struct nn_trie_node *self, size_t *nodes);
+static void nn_trie_flat_copy (struct nn_trie *self, size_t nodes);
+static void nn_node_foreach (struct nn_trie_node *self, uint8_t **buf,
+    size_t *bufsz, size_t len, nn_trie_fn fn, void *arg);
 static void nn_node_dump (struct nn_trie_node *self, int indent);
 static void nn_node_indent (int indent);
 static void nn_node_putchar (uint8_t c);
@@ -52,13 +102,71 @@ static void nn_node_putchar (uint8_t c);
 void nn_trie_init (struct nn_trie *self)
 {
     self->root = NULL;
+    self->flat = NULL;
+    self->flat_capacity = 0;
+    self->flat_valid = 0;
+    self->flat_nodes = 0;
+    self->misses = 0;
 }
 
 void nn_trie_term (struct nn_trie *self)
 {
+    if (self->flat)
+        nn_free (self->flat);
     nn_node_term (self->root);
 }
 
+void nn_trie_foreach (struct nn_trie *self, nn_trie_fn fn, void *arg)
+{
+    uint8_t *buf;
+    size_t bufsz;
+
+    /*  The buffer to compose the strings in grows as needed. */
+    bufsz = 64;
+    buf = nn_alloc (bufsz, "trie string");
+    alloc_assert (buf);
+    nn_node_foreach (self->root, &buf, &bufsz, 0, fn, arg);
+    nn_free (buf);
+}
+
+static void nn_node_foreach (struct nn_trie_node *self, uint8_t **buf,
+    size_t *bufsz, size_t len, nn_trie_fn fn, void *arg)
+{
+    int i;
+    int children;
+    struct nn_trie_node *child;
+
+    if (!self)
+        return;
+
+    /*  Make sure there's space for the prefix and one more character
+        identifying a child node. */
+    if (len + self->prefix_len + 1 > *bufsz) {
+        *bufsz = (len + self->prefix_len + 1) * 2;
+        *buf = nn_realloc (*buf, *bufsz);
+        alloc_assert (*buf);
+    }
+
+    /*  The string represented by the node is the string of the parent node
+        followed by the prefix of this node. */
+    memcpy (*buf + len, self->prefix, self->prefix_len);
+    len += self->prefix_len;
+    if (self->refcount)
+        fn (arg, *buf, len);
+
+    /*  Strings of the child nodes are extended by the character that
+        identifies the child node. */
+    children = nn_node_children (self);
+    for (i = 0; i != children; ++i) {
+        child = *nn_node_child (self, i);
+        if (!child)
+            continue;
+        (*buf) [len] = self->type == NN_TRIE_DENSE_TYPE ?
+            (uint8_t) (self->u.dense.min + i) : self->u.sparse.children [i];
+        nn_node_foreach (child, buf, bufsz, len + 1, fn, arg);
+    }
+}
+
 void nn_trie_dump (struct nn_trie *self)
 {
     nn_node_dump (self->root, 0);
@@ -159,6 +267,20 @@ int nn_node_check_prefix (struct nn_trie_node *self,
     /*  Check how many characters from the data match the prefix. */
 
     int i;
+#if defined NN_TRIE_SSE2
+    unsigned int mask;
+
+    /*  Compare the whole prefix in one go. 16 bytes starting with the prefix
+        still lie within the node. The data are compared this way only if
+        there are at least 16 bytes of them so as not to read past them. */
+    if (nn_fast (size >= 16)) {
+        mask = ~_mm_movemask_epi8 (_mm_cmpeq_epi8 (
+            _mm_loadu_si128 ((const __m128i*) self->prefix),
+            _mm_loadu_si128 ((const __m128i*) data)));
+        i = nn_trie_ctz (mask | 0x10000);
+        return i < self->prefix_len ? i : self->prefix_len;
+    }
+#endif
 
     for (i = 0; i != self->prefix_len; ++i) {
         if (!size || self->prefix [i] != *data)
@@ -169,6 +291,28 @@ int nn_node_check_prefix (struct nn_trie_node *self,
     return self->prefix_len;
 }
 
+#if defined NN_TRIE_SSE2
+int nn_trie_ctz (unsigned int mask)
+{
+    /*  Returns the index of the lowest set bit. 'mask' must not be zero. */
+
+#if defined _MSC_VER
+    unsigned long index;
+
+    _BitScanForward (&index, mask);
+    return (int) index;
+#elif defined __GNUC__ || defined __llvm__
+    return __builtin_ctz (mask);
+#else
+    int i;
+
+    for (i = 0; !(mask & 1); ++i)
+        mask >>= 1;
+    return i;
+#endif
+}
+#endif
+
 struct nn_trie_node **nn_node_child (struct nn_trie_node *self, int index)
 {
     /*  Finds pointer to the n-th child of the node. */
@@ -181,23 +325,56 @@ struct nn_trie_node **nn_node_next (struct nn_trie_node *self, uint8_t c)
     /*  Finds the pointer to the next node based on the supplied character.
         If there is no such pointer, it returns NULL. */
 
+    int index;
+
+    index = nn_node_index (self, c);
+    return index < 0 ? NULL : nn_node_child (self, index);
+}
+
+int nn_node_index (struct nn_trie_node *self, uint8_t c)
+{
+    /*  Finds the index of the child corresponding to the supplied character.
+        If there is no such child, it returns -1. */
+
+#if defined NN_TRIE_SSE2
+    unsigned int mask;
+#else
     int i;
+#endif
 
     if (self->type == 0)
-        return NULL;
+        return -1;
 
     /*  Sparse mode. */
     if (self->type <= 8) {
+#if defined NN_TRIE_SSE2
+        /*  Compare the character with all the children at once. Unused
+            slots are masked out. */
+        mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (
+            _mm_loadl_epi64 ((const __m128i*) self->u.sparse.children),
+            _mm_set1_epi8 ((char) c)));
+        mask &= (1u << self->type) - 1;
+        return mask ? nn_trie_ctz (mask) : -1;
+#else
         for (i = 0; i != self->type; ++i)
             if (self->u.sparse.children [i] == c)
-                return nn_node_child (self, i);
-        return NULL;
+                return i;
+        return -1;
+#endif
     }
 
     /*  Dense mode. */
     if (c < self->u.dense.min || c > self->u.dense.max)
-        return NULL;
-    return nn_node_child (self, c - self->u.dense.min);
+        return -1;
+    return c - self->u.dense.min;
+}
+
+int nn_node_children (struct nn_trie_node *self)
+{
+    /*  Returns the number of slots in the array of children. */
+
+    return self->type == NN_TRIE_DENSE_TYPE ?
+        self->u.dense.max - self->u.dense.min + 1 : self->type;
 }
 
 struct nn_trie_node *nn_node_compact (struct nn_trie_node *self)
@@ -234,6 +411,19 @@ struct nn_trie_node *nn_node_compact (struct nn_trie_node *self)
 }
 
 int nn_trie_subscribe (struct nn_trie *self, const uint8_t *data, size_t size)
+{
+    int rc;
+
+    /*  Changing the reference count of an existing subscription doesn't
+        affect the flat copy. */
+    rc = nn_trie_insert (self, data, size);
+    if (rc == 1)
+        nn_trie_invalidate (self);
+    return rc;
+}
+
+static int nn_trie_insert (struct nn_trie *self, const uint8_t *data,
+    size_t size)
 {
     int i;
     struct nn_trie_node **node;
@@ -439,40 +629,245 @@ step5:
 
 int nn_trie_match (struct nn_trie *self, const uint8_t *data, size_t size)
 {
+    int rc;
+    const uint8_t *flat;
     struct nn_trie_node *node;
-    struct nn_trie_node **tmp;
 
-    node = self->root;
+    flat = nn_trie_flatten (self, 1);
+    node = flat ? (struct nn_trie_node*) flat : self->root;
     while (1) {
+        rc = nn_node_step (flat, &node, &data, &size);
+        if (rc >= 0)
+            return rc;
+    }
+}
 
-        /*  If we are at the end of the trie, return. */
-        if (!node)
-            return 0;
+void nn_trie_match_many (struct nn_trie *self, const uint8_t **data,
+    const size_t *sizes, int count, int *results)
+{
+    int i;
+    int j;
+    int rc;
+    int base;
+    int active;
+    const uint8_t *flat;
+    struct nn_trie_node *root;
+    struct nn_trie_cursor cursors [NN_TRIE_BATCH];
+    struct nn_trie_cursor tmp;
+
+    flat = nn_trie_flatten (self, count);
+    root = flat ? (struct nn_trie_node*) flat : self->root;
+
+    for (base = 0; base < count; base += NN_TRIE_BATCH) {
+
+        /*  Start the traversals. They are sorted by the first character
+            so that the strings sharing the path through the trie are
+            processed next to each other. Empty strings go first. */
+        active = 0;
+        for (i = base; i != count && active != NN_TRIE_BATCH; ++i) {
+            tmp.node = root;
+            tmp.data = data [i];
+            tmp.size = sizes [i];
+            tmp.index = i;
+            for (j = active; j > 0 && (!tmp.size || (cursors [j - 1].size &&
+                  cursors [j - 1].data [0] > tmp.data [0])); --j)
+                cursors [j] = cursors [j - 1];
+            cursors [j] = tmp;
+            ++active;
+        }
 
-        /*  Check whether whole prefix matches the data. If not so,
-            the whole string won't match. */
-        if (nn_node_check_prefix (node, data, size) != node->prefix_len)
-            return 0;
+        /*  Advance each traversal by a single node in turn. The next node
+            is prefetched so that it's hopefully in the cache by the time
+            the traversal gets back to it. */
+        while (active) {
+            for (i = 0; i < active;) {
+                rc = nn_node_step (flat, &cursors [i].node, &cursors [i].data,
+                    &cursors [i].size);
+                if (rc >= 0) {
+                    results [cursors [i].index] = rc;
+                    cursors [i] = cursors [--active];
+                    continue;
+                }
+                nn_prefetch (cursors [i].node);
+                ++i;
+            }
+        }
+    }
+}
 
-        /*  Skip the prefix. */
-        data += node->prefix_len;
-        size -= node->prefix_len;
+int nn_node_step (const uint8_t *flat, struct nn_trie_node **node,
+    const uint8_t **data, size_t *size)
+{
+    /*  Moves the traversal to the next node. Returns 1 if the string matches,
+        0 if it doesn't and -1 if the traversal should continue. If 'flat'
+        is not NULL, the node is part of the flat copy of the trie. */
 
-        /*  If all the data are matched, return. */
-        if (nn_node_has_subscribers (node))
-            return 1;
+    int index;
+    uint32_t offset;
+    struct nn_trie_node *self;
 
-        /*  Move to the next node. */
-        tmp = nn_node_next (node, *data);
-        node = tmp ? *tmp : NULL;
-        ++data;
-        --size;
+    self = *node;
+
+    /*  If we are at the end of the trie, return. */
+    if (!self)
+        return 0;
+
+    /*  Check whether whole prefix matches the data. If not so,
+        the whole string won't match. */
+    if (nn_node_check_prefix (self, *data, *size) != self->prefix_len)
+        return 0;
+
+    /*  Skip the prefix. */
+    *data += self->prefix_len;
+    *size -= self->prefix_len;
+
+    /*  If all the data are matched, return. */
+    if (nn_node_has_subscribers (self))
+        return 1;
+
+    /*  The data are exhausted without reaching any subscription. */
+    if (!*size)
+        return 0;
+
+    /*  Move to the next node. */
+    index = nn_node_index (self, **data);
+    if (index < 0)
+        *node = NULL;
+    else if (flat) {
+        offset = ((uint32_t*) (self + 1)) [index];
+        *node = offset ? (struct nn_trie_node*) (flat + offset) : NULL;
     }
+    else
+        *node = *nn_node_child (self, index);
+    ++*data;
+    --*size;
+    return -1;
+}
+
+const uint8_t *nn_trie_flatten (struct nn_trie *self, size_t matches)
+{
+    /*  Returns the flat copy of the trie, rebuilding it if it's worth it.
+        Returns NULL if the trie itself should be used for matching. */
+
+    size_t size;
+    size_t nodes;
+
+    if (nn_fast (self->flat_valid))
+        return self->flat;
+
+    self->misses += matches;
+    if (self->misses < NN_TRIE_REBUILD_MIN || self->misses < self->flat_nodes)
+        return NULL;
+    self->misses = 0;
+    if (!self->root)
+        return NULL;
+
+    /*  Children are referred to by 32-bit offsets. If the trie doesn't fit
+        into 4GB, don't use the flat copy. */
+    nodes = 0;
+    size = nn_node_flat_size (self->root, &nodes);
+    if (nn_slow (size > 0xffffffff))
+        return NULL;
+
+    /*  The memory is reused across rebuilds. */
+    if (size > self->flat_capacity) {
+        if (self->flat)
+            nn_free (self->flat);
+        self->flat = nn_alloc (size, "trie (flat)");
+        alloc_assert (self->flat);
+        self->flat_capacity = size;
+    }
+
+    nn_trie_flat_copy (self, nodes);
+    self->flat_nodes = nodes;
+    self->flat_valid = 1;
+
+    return self->flat;
+}
+
+void nn_trie_invalidate (struct nn_trie *self)
+{
+    self->flat_valid = 0;
+    self->misses = 0;
+}
+
+size_t nn_node_flat_size (struct nn_trie_node *self, size_t *nodes)
+{
+    /*  Returns the size of the subtree in the flat form. */
+
+    int i;
+    int children;
+    size_t size;
+
+    if (!self)
+        return 0;
+
+    ++*nodes;
+    children = nn_node_children (self);
+    size = sizeof (struct nn_trie_node) + children * sizeof (uint32_t);
+    for (i = 0; i != children; ++i)
+        size += nn_node_flat_size (*nn_node_child (self, i), nodes);
+    return size;
+}
+
+void nn_trie_flat_copy (struct nn_trie *self, size_t nodes)
+{
+    /*  Copies the trie to the flat copy in breadth-first order. That way
+        the nodes near the root, which are visited by every match, are
+        packed together. 'nodes' is the number of nodes in the trie. */
+
+    int i;
+    int children;
+    size_t next;
+    size_t done;
+    size_t pos;
+    size_t end;
+    uint32_t *slots;
+    struct nn_trie_node *child;
+    struct nn_trie_node **queue;
+
+    /*  Original nodes corresponding to the nodes in the flat copy. */
+    queue = nn_alloc (nodes * sizeof (struct nn_trie_node*), "trie queue");
+    alloc_assert (queue);
+
+    queue [0] = self->root;
+    memcpy (self->flat, self->root, sizeof (struct nn_trie_node));
+    next = 1;
+    end = sizeof (struct nn_trie_node) +
+        nn_node_children (self->root) * sizeof (uint32_t);
+    pos = 0;
+    for (done = 0; done != next; ++done) {
+
+        /*  Append the children of the node to the end of the copy. */
+        children = nn_node_children (queue [done]);
+        slots = (uint32_t*) (self->flat + pos + sizeof (struct nn_trie_node));
+        for (i = 0; i != children; ++i) {
+            child = *nn_node_child (queue [done], i);
+            if (!child) {
+                slots [i] = 0;
+                continue;
+            }
+            slots [i] = (uint32_t) end;
+            memcpy (self->flat + end, child, sizeof (struct nn_trie_node));
+            end += sizeof (struct nn_trie_node) +
+                nn_node_children (child) * sizeof (uint32_t);
+            queue [next++] = child;
+        }
+        pos += sizeof (struct nn_trie_node) + children * sizeof (uint32_t);
+    }
+    nn_assert (next == nodes);
+
+    nn_free (queue);
 }
 
 int nn_trie_unsubscribe (struct nn_trie *self, const uint8_t *data, size_t size)
 {
-    return nn_node_unsubscribe (&self->root, data, size);
+    int rc;
+
+    rc = nn_node_unsubscribe (&self->root, data, size);
+    if (rc == 1)
+        nn_trie_invalidate (self);
+    return rc;
 }
 
 static int nn_node_unsubscribe (struct nn_trie_node **self,
@@ -89,6 +89,21 @@ struct nn_trie {
     /*  The root node of the trie (representing the empty subscription). */
     struct nn_trie_node *root;
 
+    /*  Read-optimised copy of the trie used for matching. All the nodes are
+        stored in a single block of memory in breadth-first order. The node
+        headers are the same as above but they are followed by 32-bit
+        offsets of the children from the beginning of the block rather than
+        by pointers. Offset 0 (the root) means there's no child. The copy
+        is valid only if 'flat_valid' is 1. */
+    uint8_t *flat;
+    size_t flat_capacity;
+    int flat_valid;
+
+    /*  Number of nodes in the last flat copy. */
+    size_t flat_nodes;
+
+    /*  Number of strings matched since the flat copy became invalid. */
+    size_t misses;
 };
 
 /*  Initialise an empty trie. */
@@ -112,6 +127,18 @@ int nn_trie_unsubscribe (struct nn_trie *self, const uint8_t *data,
     it returns 0. */
 int nn_trie_match (struct nn_trie *self, const uint8_t *data, size_t size);
 
+/*  Checks 'count' strings at once and stores 1 or 0 to the corresponding
+    element of 'results'. The traversals of the individual strings are
+    interleaved so that the cache misses are overlapped, which makes it
+    faster than invoking nn_trie_match for each string separately. */
+void nn_trie_match_many (struct nn_trie *self, const uint8_t **data,
+    const size_t *sizes, int count, int *results);
+
+/*  Invokes 'fn' for each string stored in the trie. The strings are passed
+    in no particular order. The trie must not be modified meanwhile. */
+typedef void (*nn_trie_fn) (void *arg, const uint8_t *data, size_t size);
+void nn_trie_foreach (struct nn_trie *self, nn_trie_fn fn, void *arg);
+
 /*  Debugging interface. */
 void nn_trie_dump (struct nn_trie *self);
 
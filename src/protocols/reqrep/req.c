@@ -27,7 +27,7 @@
 #include "../../reqrep.h"
 
 #include "../../aio/fsm.h"
-#include "../../aio/timer.h"
+#include "../../aio/deadline.h"
 
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
@@ -35,6 +35,7 @@
 #include "../../utils/random.h"
 #include "../../utils/wire.h"
 #include "../../utils/list.h"
+#include "../../utils/hash.h"
 
 #include <stdint.h>
 #include <stddef.h>
@@ -47,11 +48,8 @@
 #define NN_REQ_STATE_PASSIVE 2
 #define NN_REQ_STATE_DELAYED 3
 #define NN_REQ_STATE_ACTIVE 4
-#define NN_REQ_STATE_TIMED_OUT 5
-#define NN_REQ_STATE_CANCELLING 6
-#define NN_REQ_STATE_STOPPING_TIMER 7
-#define NN_REQ_STATE_DONE 8
-#define NN_REQ_STATE_STOPPING 9
+#define NN_REQ_STATE_DONE 5
+#define NN_REQ_STATE_STOPPING 6
 
 #define NN_REQ_ACTION_START 1
 #define NN_REQ_ACTION_IN 2
@@ -59,6 +57,36 @@
 #define NN_REQ_ACTION_SENT 4
 #define NN_REQ_ACTION_RECEIVED 5
 
+/*  States of a request slot used when the window is larger than 1. */
+#define NN_REQ_SLOT_FREE 1
+#define NN_REQ_SLOT_DELAYED 2
+#define NN_REQ_SLOT_ACTIVE 3
+#define NN_REQ_SLOT_DONE 4
+
+/*  A single outstanding request. Used only when multiple requests can be
+    in progress at the same time. */
+struct nn_req_slot {
+
+    int state;
+
+    /*  The slot is in 'outstanding' hash table keyed by the request ID
+        while the request is waiting for the reply. */
+    struct nn_hash_item hashitem;
+
+    /*  Free slots are in 'free' list, slots waiting for a peer are in
+        'delayed' list and slots with a reply are in 'done' list. */
+    struct nn_list_item item;
+
+    /*  Stored request, so that it can be re-sent if needed. */
+    struct nn_msg request;
+
+    /*  Stored reply, so that user can retrieve it later on. */
+    struct nn_msg reply;
+
+    /*  Deadline for re-sending the request. */
+    struct nn_deadline deadline;
+};
+
 struct nn_req {
 
     /*  The base class. Raw REQ socket. */
@@ -78,11 +106,22 @@ struct nn_req {
     /*  Stored reply, so that user can retrieve it later on. */
     struct nn_msg reply;
 
-    /*  Timer used to wait while request should be re-sent. */
-    struct nn_timer timer;
+    /*  Deadline for re-sending the request. */
+    struct nn_deadline deadline;
 
     /*  Protocol-specific socket options. */
     int resend_ivl;
+    int window;
+
+    /*  If the window is larger than 1, each outstanding request is tracked
+        in a slot of its own and the fields above are not used. The slots
+        are allocated when the option is set so that sending a request
+        doesn't allocate anything but the message itself. */
+    struct nn_req_slot *slots;
+    struct nn_hash outstanding;
+    struct nn_list free;
+    struct nn_list delayed;
+    struct nn_list done;
 };
 
 /*  Private functions. */
@@ -92,6 +131,13 @@ static void nn_req_term (struct nn_req *self);
 static int nn_req_inprogress (struct nn_req *self);
 static void nn_req_handler (struct nn_fsm *self, void *source, int type);
 static void nn_req_action_send (struct nn_req *self);
+static void nn_req_setwindow (struct nn_req *self, int window);
+static struct nn_req_slot *nn_req_findslot (struct nn_req *self,
+    void *source);
+static void nn_req_slot_send (struct nn_req *self, struct nn_req_slot *slot);
+static void nn_req_in_window (struct nn_req *self);
+static int nn_req_send_window (struct nn_req *self, struct nn_msg *msg);
+static int nn_req_recv_window (struct nn_req *self, struct nn_msg *msg);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_req_stop (struct nn_sockbase *self);
@@ -133,8 +179,14 @@ static void nn_req_init (struct nn_req *self,
 
     nn_msg_init (&self->request, 0);
     nn_msg_init (&self->reply, 0);
-    nn_timer_init (&self->timer, &self->fsm);
+    nn_deadline_init (&self->deadline, &self->fsm);
     self->resend_ivl = NN_REQ_DEFAULT_RESEND_IVL;
+    self->window = 1;
+    self->slots = NULL;
+    nn_hash_init (&self->outstanding);
+    nn_list_init (&self->free);
+    nn_list_init (&self->delayed);
+    nn_list_init (&self->done);
 
     /*  Start the state machine. */
     nn_fsm_start (&self->fsm);
@@ -142,7 +194,12 @@ static void nn_req_init (struct nn_req *self,
 
 static void nn_req_term (struct nn_req *self)
 {
-    nn_timer_term (&self->timer);
+    nn_req_setwindow (self, 1);
+    nn_list_term (&self->done);
+    nn_list_term (&self->delayed);
+    nn_list_term (&self->free);
+    nn_hash_term (&self->outstanding);
+    nn_deadline_term (&self->deadline);
     nn_msg_term (&self->reply);
     nn_msg_term (&self->request);
     nn_fsm_term (&self->fsm);
@@ -187,6 +244,11 @@ static void nn_req_in (struct nn_sockbase *self, struct nn_pipe *pipe)
     /*  Pass the pipe to the raw REQ socket. */
     nn_xreq_in (&req->xreq.sockbase, pipe);
 
+    if (req->slots) {
+        nn_req_in_window (req);
+        return;
+    }
+
     while (1) {
 
         /*  Get new reply. */
@@ -235,12 +297,25 @@ static void nn_req_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 static void nn_req_out (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
     struct nn_req *req;
+    struct nn_req_slot *slot;
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
     /*  Add the pipe to the underlying raw socket. */
     nn_xreq_out (&req->xreq.sockbase, pipe);
 
+    /*  Send the requests that were waiting for a peer. */
+    if (req->slots) {
+        while (!nn_list_empty (&req->delayed)) {
+            slot = nn_cont (nn_list_begin (&req->delayed),
+                struct nn_req_slot, item);
+            nn_req_slot_send (req, slot);
+            if (slot->state == NN_REQ_SLOT_DELAYED)
+                break;
+        }
+        return;
+    }
+
     /*  Notify the state machine. */
     if (req->state == NN_REQ_STATE_DELAYED)
         nn_req_handler (&req->fsm, NULL, NN_REQ_ACTION_OUT);
@@ -253,6 +328,17 @@ static int nn_req_events (struct nn_sockbase *self)
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
+    /*  With multiple requests in progress, the socket is writeable if there's
+        a free slot and readable if there's a reply for any of the requests. */
+    if (req->slots) {
+        rc = 0;
+        if (!nn_list_empty (&req->free))
+            rc |= NN_SOCKBASE_EVENT_OUT;
+        if (!nn_list_empty (&req->done))
+            rc |= NN_SOCKBASE_EVENT_IN;
+        return rc;
+    }
+
     /*  OUT is signalled all the time because sending a request while
         another one is being processed cancels the old one. */
     rc = NN_SOCKBASE_EVENT_OUT;
@@ -270,6 +356,9 @@ static int nn_req_send (struct nn_sockbase *self, struct nn_msg *msg)
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
+    if (req->slots)
+        return nn_req_send_window (req, msg);
+
     /*  Generate new request ID for the new request and put it into message
         header. The most important bit is set to 1 to indicate that this is
         the bottom of the backtrace stack. */
@@ -295,6 +384,9 @@ static int nn_req_recv (struct nn_sockbase *self, struct nn_msg *msg)
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
+    if (req->slots)
+        return nn_req_recv_window (req, msg);
+
     /*  No request was sent. Waiting for a reply doesn't make sense. */
     if (nn_slow (!nn_req_inprogress (req)))
         return -EFSM;
@@ -317,6 +409,7 @@ static int nn_req_setopt (struct nn_sockbase *self, int level, int option,
         const void *optval, size_t optvallen)
 {
     struct nn_req *req;
+    int i;
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
@@ -330,6 +423,25 @@ static int nn_req_setopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
+    if (option == NN_REQ_WINDOW) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        if (nn_slow (*(int*) optval < 1))
+            return -EINVAL;
+
+        /*  The window can't be changed once a request was sent. */
+        if (nn_slow (req->state != NN_REQ_STATE_PASSIVE ||
+              !nn_deadline_isidle (&req->deadline)))
+            return -EFSM;
+        for (i = 0; req->slots && i != req->window; ++i)
+            if (nn_slow (req->slots [i].state != NN_REQ_SLOT_FREE ||
+                  !nn_deadline_isidle (&req->slots [i].deadline)))
+                return -EFSM;
+
+        nn_req_setwindow (req, *(int*) optval);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
@@ -351,12 +463,30 @@ static int nn_req_getopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
+    if (option == NN_REQ_WINDOW) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = req->window;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
+    if (option == NN_REQ_ID) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = (int) (req->reqid & 0x7fffffff);
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
 static void nn_req_handler (struct nn_fsm *self, void *source, int type)
 {
     struct nn_req *req;
+    struct nn_req_slot *slot;
+    int i;
 
     req = nn_cont (self, struct nn_req, fsm);
 
@@ -364,12 +494,17 @@ static void nn_req_handler (struct nn_fsm *self, void *source, int type)
 /*  STOP procedure.                                                           */
 /******************************************************************************/
     if (nn_slow (source == &req->fsm && type == NN_FSM_STOP)) {
-        nn_timer_stop (&req->timer);
+        nn_deadline_stop (&req->deadline);
+        for (i = 0; req->slots && i != req->window; ++i)
+            nn_deadline_stop (&req->slots [i].deadline);
         req->state = NN_REQ_STATE_STOPPING;
     }
     if (nn_slow (req->state == NN_REQ_STATE_STOPPING)) {
-        if (!nn_timer_isidle (&req->timer))
+        if (!nn_deadline_isidle (&req->deadline))
             return;
+        for (i = 0; req->slots && i != req->window; ++i)
+            if (!nn_deadline_isidle (&req->slots [i].deadline))
+                return;
         req->state = NN_REQ_STATE_IDLE;
         nn_fsm_stopped_noevent (&req->fsm);
         nn_sockbase_stopped (&req->xreq.sockbase);
@@ -397,7 +532,8 @@ static void nn_req_handler (struct nn_fsm *self, void *source, int type)
 
 /******************************************************************************/
 /*  PASSIVE state.                                                            */
-/*  No request is submitted.                                                  */
+/*  No request is submitted. If the window is larger than 1 the socket stays  */
+/*  in this state and the requests are tracked by the slots.                  */
 /******************************************************************************/
     case NN_REQ_STATE_PASSIVE:
         if (source == NULL) {
@@ -409,6 +545,19 @@ static void nn_req_handler (struct nn_fsm *self, void *source, int type)
                 nn_assert (0);
             }
         }
+        slot = nn_req_findslot (req, source);
+        if (slot) {
+            switch (type) {
+            case NN_DEADLINE_TIMEOUT:
+
+                /*  No reply arrived in time. Re-send the request. */
+                if (slot->state == NN_REQ_SLOT_ACTIVE)
+                    nn_req_slot_send (req, slot);
+                return;
+            default:
+                nn_assert (0);
+            }
+        }
         nn_assert (0);
 
 /******************************************************************************/
@@ -426,10 +575,9 @@ static void nn_req_handler (struct nn_fsm *self, void *source, int type)
 
             case NN_REQ_ACTION_SENT:
 
-                /*  New request was sent while the old one was still being
-                    processed. Cancel the old request first. */
-                nn_timer_stop (&req->timer);
-                req->state = NN_REQ_STATE_CANCELLING;
+                /*  New request was sent while the old one was still waiting
+                    for a peer. Try to send the new one instead. */
+                nn_req_action_send (req);
                 return;
 
             default:
@@ -448,107 +596,34 @@ static void nn_req_handler (struct nn_fsm *self, void *source, int type)
             case NN_REQ_ACTION_IN:
 
                 /*  Reply arrived. */
-                nn_timer_stop (&req->timer);
-                req->state = NN_REQ_STATE_STOPPING_TIMER;
+                nn_deadline_clear (&req->deadline);
+                req->state = NN_REQ_STATE_DONE;
                 return;
 
             case NN_REQ_ACTION_SENT:
 
                 /*  New request was sent while the old one was still being
-                    processed. Cancel the old request first. */
-                nn_timer_stop (&req->timer);
-                req->state = NN_REQ_STATE_CANCELLING;
-                return;
-
-            default:
-                nn_assert (0);
-            }
-        }
-        if (source == &req->timer) {
-            switch (type) {
-            case NN_TIMER_TIMEOUT:
-                nn_timer_stop (&req->timer);
-                req->state = NN_REQ_STATE_TIMED_OUT;
-                return;
-            default:
-                nn_assert (0);
-            }
-        }
-        nn_assert (0);
-
-/******************************************************************************/
-/*  TIMED_OUT state.                                                          */
-/*  Waiting for reply has timer out. Stopping the timer. Afterwards, we'll    */
-/*  re-send the request.                                                      */
-/******************************************************************************/
-    case NN_REQ_STATE_TIMED_OUT:
-        if (source == &req->timer) {
-            switch (type) {
-            case NN_TIMER_STOPPED:
+                    processed. The old one is cancelled by replacing the
+                    deadline. */
+                nn_deadline_clear (&req->deadline);
                 nn_req_action_send (req);
                 return;
+
             default:
                 nn_assert (0);
             }
         }
-        if (source == NULL) {
+        if (source == &req->deadline) {
             switch (type) {
-            case NN_REQ_ACTION_SENT:
-                req->state = NN_REQ_STATE_CANCELLING;
-                return;
-            default:
-                nn_assert (0);
-            }
-        }
-        nn_assert (0);
+            case NN_DEADLINE_TIMEOUT:
 
-/******************************************************************************/
-/*  CANCELLING state.                                                         */
-/*  Request was canceled. Waiting till the timer is stopped.                  */
-/******************************************************************************/
-    case NN_REQ_STATE_CANCELLING:
-        if (source == &req->timer) {
-            switch (type) {
-            case NN_TIMER_STOPPED:
+                /*  No reply arrived in time. Re-send the request. */
                 nn_req_action_send (req);
                 return;
             default:
                 nn_assert (0);
             }
         }
-        if (source == NULL) {
-             switch (type) {
-             case NN_REQ_ACTION_SENT:
-                 return;
-             default:
-                 nn_assert (0);
-             }
-        }
-        nn_assert (0);
-
-/******************************************************************************/
-/*  STOPPING_TIMER state.                                                     */
-/*  Reply was delivered. Waiting till the timer is stopped.                   */
-/******************************************************************************/
-    case NN_REQ_STATE_STOPPING_TIMER:
-        if (source == &req->timer) {
-            switch (type) {
-            case NN_TIMER_STOPPED:
-                req->state = NN_REQ_STATE_DONE;
-                return;
-            default:
-                nn_assert (0);
-            }
-        }
-        if (source == NULL) {
-             switch (type) {
-             case NN_REQ_ACTION_SENT:
-                 req->state = NN_REQ_STATE_CANCELLING;
-                 return;
-             default:
-                 nn_assert (0);
-             }
-        }
         nn_assert (0);
 
 /******************************************************************************/
@@ -599,11 +674,11 @@ static void nn_req_action_send (struct nn_req *self)
         return;
     }
 
-    /*  Request was successfully sent. Set up the re-send timer
+    /*  Request was successfully sent. Set up the re-send deadline
         in case the request gets lost somewhere further out
         in the topology. */
     if (nn_fast (rc == 0)) {
-        nn_timer_start (&self->timer, self->resend_ivl);
+        nn_deadline_set (&self->deadline, self->resend_ivl);
         self->state = NN_REQ_STATE_ACTIVE;
         return;
     }
@@ -612,6 +687,206 @@ static void nn_req_action_send (struct nn_req *self)
     errnum_assert (0, -rc);
 }
 
+/******************************************************************************/
+/*  Multiple requests in progress.                                            */
+/******************************************************************************/
+
+static void nn_req_setwindow (struct nn_req *self, int window)
+{
+    int i;
+    struct nn_req_slot *slot;
+
+    /*  Deallocate the old slots. The requests still in progress, if any,
+        are dropped. */
+    if (self->slots) {
+        for (i = 0; i != self->window; ++i) {
+            slot = &self->slots [i];
+            switch (slot->state) {
+            case NN_REQ_SLOT_FREE:
+                nn_list_erase (&self->free, &slot->item);
+                break;
+            case NN_REQ_SLOT_DELAYED:
+                nn_list_erase (&self->delayed, &slot->item);
+                nn_hash_erase (&self->outstanding, &slot->hashitem);
+                break;
+            case NN_REQ_SLOT_ACTIVE:
+                nn_hash_erase (&self->outstanding, &slot->hashitem);
+                break;
+            case NN_REQ_SLOT_DONE:
+                nn_list_erase (&self->done, &slot->item);
+                break;
+            default:
+                nn_assert (0);
+            }
+            nn_deadline_term (&slot->deadline);
+            nn_msg_term (&slot->reply);
+            nn_msg_term (&slot->request);
+            nn_list_item_term (&slot->item);
+            nn_hash_item_term (&slot->hashitem);
+        }
+        nn_free (self->slots);
+        self->slots = NULL;
+    }
+    self->window = window;
+
+    /*  With window of 1 the original single-request state machine is used. */
+    if (window == 1)
+        return;
+
+    self->slots = nn_alloc (sizeof (struct nn_req_slot) * window,
+        "request slots");
+    alloc_assert (self->slots);
+    for (i = 0; i != window; ++i) {
+        slot = &self->slots [i];
+        slot->state = NN_REQ_SLOT_FREE;
+        nn_hash_item_init (&slot->hashitem);
+        nn_list_item_init (&slot->item);
+        nn_msg_init (&slot->request, 0);
+        nn_msg_init (&slot->reply, 0);
+        nn_deadline_init (&slot->deadline, &self->fsm);
+        nn_list_insert (&self->free, &slot->item, nn_list_end (&self->free));
+    }
+}
+
+static struct nn_req_slot *nn_req_findslot (struct nn_req *self,
+    void *source)
+{
+    struct nn_req_slot *slot;
+
+    /*  Returns the slot the event source belongs to, NULL if the source
+        is not a deadline of any of the slots. */
+    if (!self->slots)
+        return NULL;
+    if ((char*) source < (char*) self->slots ||
+          (char*) source >= (char*) (self->slots + self->window))
+        return NULL;
+    slot = self->slots + ((char*) source - (char*) self->slots) /
+        sizeof (struct nn_req_slot);
+    nn_assert (source == &slot->deadline);
+    return slot;
+}
+
+static void nn_req_slot_send (struct nn_req *self, struct nn_req_slot *slot)
+{
+    int rc;
+    struct nn_msg msg;
+
+    /*  Send the request. */
+    nn_msg_cp (&msg, &slot->request);
+    rc = nn_xreq_send (&self->xreq.sockbase, &msg);
+
+    /*  If the request cannot be sent at the moment wait till
+        new outbound pipe arrives. */
+    if (nn_slow (rc == -EAGAIN)) {
+        nn_msg_term (&msg);
+        if (slot->state != NN_REQ_SLOT_DELAYED) {
+            slot->state = NN_REQ_SLOT_DELAYED;
+            nn_list_insert (&self->delayed, &slot->item,
+                nn_list_end (&self->delayed));
+        }
+        return;
+    }
+    errnum_assert (rc == 0, -rc);
+
+    /*  Request was successfully sent. Set up the re-send deadline. */
+    if (slot->state == NN_REQ_SLOT_DELAYED)
+        nn_list_erase (&self->delayed, &slot->item);
+    nn_deadline_set (&slot->deadline, self->resend_ivl);
+    slot->state = NN_REQ_SLOT_ACTIVE;
+}
+
+static void nn_req_in_window (struct nn_req *self)
+{
+    int rc;
+    struct nn_msg reply;
+    struct nn_hash_item *hashitem;
+    struct nn_req_slot *slot;
+
+    while (1) {
+
+        /*  Get new reply. */
+        rc = nn_xreq_recv (&self->xreq.sockbase, &reply);
+        if (nn_slow (rc == -EAGAIN))
+            return;
+        errnum_assert (rc == 0, -rc);
+
+        /*  Ignore malformed replies. */
+        if (nn_slow (nn_chunkref_size (&reply.hdr) != sizeof (uint32_t))) {
+            nn_msg_term (&reply);
+            continue;
+        }
+
+        /*  Ignore replies to requests that are not in progress, including
+            duplicate replies to re-sent requests. */
+        hashitem = nn_hash_get (&self->outstanding,
+            nn_getl (nn_chunkref_data (&reply.hdr)));
+        if (nn_slow (!hashitem)) {
+            nn_msg_term (&reply);
+            continue;
+        }
+        slot = nn_cont (hashitem, struct nn_req_slot, hashitem);
+
+        /*  The request is done. The reply keeps its header so that the user
+            can find out which request it belongs to. */
+        nn_hash_erase (&self->outstanding, &slot->hashitem);
+        nn_deadline_clear (&slot->deadline);
+        if (slot->state == NN_REQ_SLOT_DELAYED)
+            nn_list_erase (&self->delayed, &slot->item);
+        nn_msg_term (&slot->request);
+        nn_msg_init (&slot->request, 0);
+        nn_msg_mv (&slot->reply, &reply);
+        slot->state = NN_REQ_SLOT_DONE;
+        nn_list_insert (&self->done, &slot->item, nn_list_end (&self->done));
+    }
+}
+
+static int nn_req_send_window (struct nn_req *self, struct nn_msg *msg)
+{
+    struct nn_req_slot *slot;
+
+    /*  All the slots are taken. Wait till some of the replies is received. */
+    if (nn_slow (nn_list_empty (&self->free)))
+        return -EAGAIN;
+    slot = nn_cont (nn_list_begin (&self->free), struct nn_req_slot, item);
+    nn_list_erase (&self->free, &slot->item);
+
+    /*  Generate new request ID and put it into the message header. */
+    ++self->reqid;
+    nn_assert (nn_chunkref_size (&msg->hdr) == 0);
+    nn_chunkref_term (&msg->hdr);
+    nn_chunkref_init (&msg->hdr, 4);
+    nn_putl (nn_chunkref_data (&msg->hdr), self->reqid | 0x80000000);
+
+    /*  Store the message so that it can be re-sent if there's no reply. */
+    nn_msg_term (&slot->request);
+    nn_msg_mv (&slot->request, msg);
+    nn_hash_insert (&self->outstanding, self->reqid | 0x80000000,
+        &slot->hashitem);
+
+    nn_req_slot_send (self, slot);
+
+    return 0;
+}
+
+static int nn_req_recv_window (struct nn_req *self, struct nn_msg *msg)
+{
+    struct nn_req_slot *slot;
+
+    /*  No reply is available at the moment. */
+    if (nn_slow (nn_list_empty (&self->done)))
+        return self->outstanding.items ? -EAGAIN : -EFSM;
+
+    /*  Pass the oldest reply to the caller and release the slot. */
+    slot = nn_cont (nn_list_begin (&self->done), struct nn_req_slot, item);
+    nn_list_erase (&self->done, &slot->item);
+    nn_msg_mv (msg, &slot->reply);
+    nn_msg_init (&slot->reply, 0);
+    slot->state = NN_REQ_SLOT_FREE;
+    nn_list_insert (&self->free, &slot->item, nn_list_end (&self->free));
+
+    return 0;
+}
+
 static int nn_req_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_req *self;
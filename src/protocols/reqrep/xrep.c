@@ -149,6 +149,7 @@ int nn_xrep_send (struct nn_sockbase *self, struct nn_msg *msg)
     int rc;
     uint32_t key;
     struct nn_xrep *xrep;
+    struct nn_hash_item *item;
     struct nn_xrep_data *data;
 
     xrep = nn_cont (self, struct nn_xrep, sockbase);
@@ -165,8 +166,8 @@ int nn_xrep_send (struct nn_sockbase *self, struct nn_msg *msg)
 
     /*  Find the appropriate pipe to send the message to. If there's none,
         or if it's not ready for sending, silently drop the message. */
-    data = nn_cont (nn_hash_get (&xrep->outpipes, key), struct nn_xrep_data,
-        outitem);
+    item = nn_hash_get (&xrep->outpipes, key);
+    data = nn_cont (item, struct nn_xrep_data, outitem);
     if (!data || !(data->flags & NN_XREP_OUT))
         return 0;
 
@@ -27,7 +27,7 @@
 #include "../../survey.h"
 
 #include "../../aio/fsm.h"
-#include "../../aio/timer.h"
+#include "../../aio/deadline.h"
 
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
@@ -36,6 +36,7 @@
 #include "../../utils/alloc.h"
 #include "../../utils/random.h"
 #include "../../utils/list.h"
+#include "../../utils/hash.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -45,13 +46,32 @@
 #define NN_SURVEYOR_STATE_IDLE 1
 #define NN_SURVEYOR_STATE_PASSIVE 2
 #define NN_SURVEYOR_STATE_ACTIVE 3
-#define NN_SURVEYOR_STATE_CANCELLING 4
-#define NN_SURVEYOR_STATE_STOPPING_TIMER 5
-#define NN_SURVEYOR_STATE_STOPPING 6
+#define NN_SURVEYOR_STATE_STOPPING 4
 
 #define NN_SURVEYOR_ACTION_START 1
 #define NN_SURVEYOR_ACTION_CANCEL 2
 
+/*  States of a survey slot used when the window is larger than 1. */
+#define NN_SURVEYOR_SLOT_FREE 1
+#define NN_SURVEYOR_SLOT_ACTIVE 2
+
+/*  A single survey in progress. Used only when multiple surveys can be
+    in progress at the same time. */
+struct nn_surveyor_slot {
+
+    int state;
+
+    /*  Active slots are in 'surveys' hash table keyed by the survey ID. */
+    struct nn_hash_item hashitem;
+
+    /*  Free slots are in 'free' list, active slots are in 'active' list
+        ordered from the oldest survey to the newest one. */
+    struct nn_list_item item;
+
+    /*  Deadline for the survey. */
+    struct nn_deadline deadline;
+};
+
 struct nn_surveyor {
 
     /*  The underlying raw SP socket. */
@@ -65,13 +85,23 @@ struct nn_surveyor {
     uint32_t surveyid;
 
     /*  Timer for timing out the survey. */
-    struct nn_timer timer;
+    struct nn_deadline timer;
 
     /*  When starting the survey, the message is temporarily stored here. */
     struct nn_msg tosend;
 
     /*  Protocol-specific socket options. */
     int deadline;
+    int window;
+
+    /*  If the window is larger than 1, each survey in progress is tracked
+        in a slot of its own and 'timer' and 'tosend' fields are not used.
+        The slots are allocated when the option is set so that starting
+        a survey doesn't allocate anything. */
+    struct nn_surveyor_slot *slots;
+    struct nn_hash surveys;
+    struct nn_list free;
+    struct nn_list active;
 };
 
 /*  Private functions. */
@@ -80,6 +110,13 @@ static void nn_surveyor_init (struct nn_surveyor *self,
 static void nn_surveyor_term (struct nn_surveyor *self);
 static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type);
 static int nn_surveyor_inprogress (struct nn_surveyor *self);
+static void nn_surveyor_setwindow (struct nn_surveyor *self, int window);
+static struct nn_surveyor_slot *nn_surveyor_findslot (
+    struct nn_surveyor *self, void *source);
+static void nn_surveyor_slot_done (struct nn_surveyor *self,
+    struct nn_surveyor_slot *slot);
+static int nn_surveyor_send_window (struct nn_surveyor *self,
+    struct nn_msg *msg);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_surveyor_stop (struct nn_sockbase *self);
@@ -117,9 +154,14 @@ static void nn_surveyor_init (struct nn_surveyor *self,
         there should be no key clashes even if the executable is re-started. */
     nn_random_generate (&self->surveyid, sizeof (self->surveyid));
 
-    nn_timer_init (&self->timer, &self->fsm);
+    nn_deadline_init (&self->timer, &self->fsm);
     nn_msg_init (&self->tosend, 0);
     self->deadline = NN_SURVEYOR_DEFAULT_DEADLINE;
+    self->window = 1;
+    self->slots = NULL;
+    nn_hash_init (&self->surveys);
+    nn_list_init (&self->free);
+    nn_list_init (&self->active);
 
     /*  Start the state machine. */
     nn_fsm_start (&self->fsm);
@@ -127,8 +169,12 @@ static void nn_surveyor_init (struct nn_surveyor *self,
 
 static void nn_surveyor_term (struct nn_surveyor *self)
 {
+    nn_surveyor_setwindow (self, 1);
+    nn_list_term (&self->active);
+    nn_list_term (&self->free);
+    nn_hash_term (&self->surveys);
     nn_msg_term (&self->tosend);
-    nn_timer_term (&self->timer);
+    nn_deadline_term (&self->timer);
     nn_fsm_term (&self->fsm);
     nn_xsurveyor_term (&self->xsurveyor);
 }
@@ -155,6 +201,8 @@ void nn_surveyor_destroy (struct nn_sockbase *self)
 static int nn_surveyor_inprogress (struct nn_surveyor *self)
 {
     /*  Return 1 if there's a survey going on. 0 otherwise. */
+    if (self->slots)
+        return nn_list_empty (&self->active) ? 0 : 1;
     return self->state == NN_SURVEYOR_STATE_IDLE ||
         self->state == NN_SURVEYOR_STATE_PASSIVE ||
         self->state == NN_SURVEYOR_STATE_STOPPING ? 0 : 1;
@@ -184,6 +232,9 @@ static int nn_surveyor_send (struct nn_sockbase *self, struct nn_msg *msg)
 
     surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
 
+    if (surveyor->slots)
+        return nn_surveyor_send_window (surveyor, msg);
+
     /*  Generate new survey ID. */
     ++surveyor->surveyid;
 
@@ -223,6 +274,7 @@ static int nn_surveyor_recv (struct nn_sockbase *self, struct nn_msg *msg)
     int rc;
     struct nn_surveyor *surveyor;
     uint32_t surveyid;
+    struct nn_hash_item *hashitem;
 
     surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
 
@@ -240,11 +292,27 @@ static int nn_surveyor_recv (struct nn_sockbase *self, struct nn_msg *msg)
 
         /*  Get the survey ID. Ignore any stale responses. */
         /*  TODO: This should be done asynchronously! */
-        if (nn_slow (nn_chunkref_size (&msg->hdr) != sizeof (uint32_t)))
+        if (nn_slow (nn_chunkref_size (&msg->hdr) != sizeof (uint32_t))) {
+            nn_msg_term (msg);
             continue;
+        }
         surveyid = nn_getl (nn_chunkref_data (&msg->hdr));
-        if (nn_slow (surveyid != surveyor->surveyid))
+
+        /*  With multiple surveys in progress, the response keeps its header
+            so that the user can find out which survey it belongs to. */
+        if (surveyor->slots) {
+            hashitem = nn_hash_get (&surveyor->surveys, surveyid);
+            if (nn_slow (!hashitem)) {
+                nn_msg_term (msg);
+                continue;
+            }
+            break;
+        }
+
+        if (nn_slow (surveyid != surveyor->surveyid)) {
+            nn_msg_term (msg);
             continue;
+        }
 
         /*  Discard the header and return the message to the user. */
         nn_chunkref_term (&msg->hdr);
@@ -259,6 +327,7 @@ static int nn_surveyor_setopt (struct nn_sockbase *self, int level, int option,
     const void *optval, size_t optvallen)
 {
     struct nn_surveyor *surveyor;
+    int i;
 
     surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
 
@@ -272,6 +341,25 @@ static int nn_surveyor_setopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
+    if (option == NN_SURVEYOR_WINDOW) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        if (nn_slow (*(int*) optval < 1))
+            return -EINVAL;
+
+        /*  The window can't be changed once a survey was started. */
+        if (nn_slow (surveyor->state != NN_SURVEYOR_STATE_PASSIVE ||
+              !nn_deadline_isidle (&surveyor->timer)))
+            return -EFSM;
+        for (i = 0; surveyor->slots && i != surveyor->window; ++i)
+            if (nn_slow (surveyor->slots [i].state != NN_SURVEYOR_SLOT_FREE ||
+                  !nn_deadline_isidle (&surveyor->slots [i].deadline)))
+                return -EFSM;
+
+        nn_surveyor_setwindow (surveyor, *(int*) optval);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
@@ -293,6 +381,22 @@ static int nn_surveyor_getopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
+    if (option == NN_SURVEYOR_WINDOW) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = surveyor->window;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
+    if (option == NN_SURVEYOR_ID) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = (int) surveyor->surveyid;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
@@ -300,6 +404,8 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
 {
     int rc;
     struct nn_surveyor *surveyor;
+    struct nn_surveyor_slot *slot;
+    int i;
 
     surveyor = nn_cont (self, struct nn_surveyor, fsm);
 
@@ -307,12 +413,17 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
 /*  STOP procedure.                                                           */
 /******************************************************************************/
     if (nn_slow (source == &surveyor->fsm && type == NN_FSM_STOP)) {
-        nn_timer_stop (&surveyor->timer);
+        nn_deadline_stop (&surveyor->timer);
+        for (i = 0; surveyor->slots && i != surveyor->window; ++i)
+            nn_deadline_stop (&surveyor->slots [i].deadline);
         surveyor->state = NN_SURVEYOR_STATE_STOPPING;
     }
     if (nn_slow (surveyor->state == NN_SURVEYOR_STATE_STOPPING)) {
-        if (!nn_timer_isidle (&surveyor->timer))
+        if (!nn_deadline_isidle (&surveyor->timer))
             return;
+        for (i = 0; surveyor->slots && i != surveyor->window; ++i)
+            if (!nn_deadline_isidle (&surveyor->slots [i].deadline))
+                return;
         surveyor->state = NN_SURVEYOR_STATE_IDLE;
         nn_fsm_stopped_noevent (&surveyor->fsm);
         nn_sockbase_stopped (&surveyor->xsurveyor.sockbase);
@@ -339,7 +450,8 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
 
 /******************************************************************************/
 /*  PASSIVE state.                                                            */
-/*  There's no survey going on.                                               */
+/*  There's no survey going on. If the window is larger than 1 the socket     */
+/*  stays in this state and the surveys are tracked by the slots.             */
 /******************************************************************************/
     case NN_SURVEYOR_STATE_PASSIVE:
         if (source == NULL) {
@@ -348,7 +460,7 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
                 rc = nn_xsurveyor_send (&surveyor->xsurveyor.sockbase,
                     &surveyor->tosend);
                 errnum_assert (rc == 0, -rc);
-                nn_timer_start (&surveyor->timer, surveyor->deadline);
+                nn_deadline_set (&surveyor->timer, surveyor->deadline);
                 surveyor->state = NN_SURVEYOR_STATE_ACTIVE;
                 return;
 
@@ -356,27 +468,12 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
                 nn_assert (0);
             }
         }
-
-/******************************************************************************/
-/*  ACTIVE state.                                                             */
-/*  Survey was sent, waiting for responses.                                   */
-/******************************************************************************/
-    case NN_SURVEYOR_STATE_ACTIVE:
-        if (source == NULL) {
-            switch (type) {
-            case NN_SURVEYOR_ACTION_CANCEL:
-                nn_timer_stop (&surveyor->timer);
-                surveyor->state = NN_SURVEYOR_STATE_CANCELLING;
-                return;
-            default:
-                nn_assert (0);
-            }
-        }
-        if (source == &surveyor->timer) {
+        slot = nn_surveyor_findslot (surveyor, source);
+        if (slot) {
             switch (type) {
-            case NN_TIMER_TIMEOUT:
-                nn_timer_stop (&surveyor->timer);
-                surveyor->state = NN_SURVEYOR_STATE_STOPPING_TIMER;
+            case NN_DEADLINE_TIMEOUT:
+                if (slot->state == NN_SURVEYOR_SLOT_ACTIVE)
+                    nn_surveyor_slot_done (surveyor, slot);
                 return;
             default:
                 nn_assert (0);
@@ -385,42 +482,28 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
         nn_assert (0);
 
 /******************************************************************************/
-/*  CANCELLING state.                                                         */
-/*  Survey was cancelled, but the old timer haven't stopped yet. The new      */
-/*  survey thus haven't been sent and is stored in 'tosend'.                  */
+/*  ACTIVE state.                                                             */
+/*  Survey was sent, waiting for responses.                                   */
 /******************************************************************************/
-    case NN_SURVEYOR_STATE_CANCELLING:
+    case NN_SURVEYOR_STATE_ACTIVE:
         if (source == NULL) {
             switch (type) {
             case NN_SURVEYOR_ACTION_CANCEL:
-                return;
-            default:
-                nn_assert (0);
-            }
-        }
-        if (source == &surveyor->timer) {
-            switch (type) {
-            case NN_TIMER_STOPPED:
+
+                /*  New survey replaces the current one. Setting the new
+                    deadline cancels the old one. */
                 rc = nn_xsurveyor_send (&surveyor->xsurveyor.sockbase,
                     &surveyor->tosend);
                 errnum_assert (rc == 0, -rc);
-                nn_timer_start (&surveyor->timer, surveyor->deadline);
-                surveyor->state = NN_SURVEYOR_STATE_ACTIVE;
+                nn_deadline_set (&surveyor->timer, surveyor->deadline);
                 return;
             default:
                 nn_assert (0);
             }
         }
-        nn_assert (0);
-
-/******************************************************************************/
-/*  STOPPING_TIMER state.                                                     */
-/*  Survey timeout expired. Now we are stopping the timer.                    */
-/******************************************************************************/
-    case NN_SURVEYOR_STATE_STOPPING_TIMER:
         if (source == &surveyor->timer) {
             switch (type) {
-            case NN_TIMER_STOPPED:
+            case NN_DEADLINE_TIMEOUT:
                 surveyor->state = NN_SURVEYOR_STATE_PASSIVE;
                 return;
             default:
@@ -437,6 +520,120 @@ static void nn_surveyor_handler (struct nn_fsm *self, void *source, int type)
     }
 }
 
+/******************************************************************************/
+/*  Multiple surveys in progress.                                             */
+/******************************************************************************/
+
+static void nn_surveyor_setwindow (struct nn_surveyor *self, int window)
+{
+    int i;
+    struct nn_surveyor_slot *slot;
+
+    /*  Deallocate the old slots. The surveys still in progress, if any,
+        are dropped. */
+    if (self->slots) {
+        for (i = 0; i != self->window; ++i) {
+            slot = &self->slots [i];
+            if (slot->state == NN_SURVEYOR_SLOT_ACTIVE) {
+                nn_hash_erase (&self->surveys, &slot->hashitem);
+                nn_list_erase (&self->active, &slot->item);
+            }
+            else
+                nn_list_erase (&self->free, &slot->item);
+            nn_deadline_term (&slot->deadline);
+            nn_list_item_term (&slot->item);
+            nn_hash_item_term (&slot->hashitem);
+        }
+        nn_free (self->slots);
+        self->slots = NULL;
+    }
+    self->window = window;
+
+    /*  With window of 1 the original single-survey state machine is used. */
+    if (window == 1)
+        return;
+
+    self->slots = nn_alloc (sizeof (struct nn_surveyor_slot) * window,
+        "survey slots");
+    alloc_assert (self->slots);
+    for (i = 0; i != window; ++i) {
+        slot = &self->slots [i];
+        slot->state = NN_SURVEYOR_SLOT_FREE;
+        nn_hash_item_init (&slot->hashitem);
+        nn_list_item_init (&slot->item);
+        nn_deadline_init (&slot->deadline, &self->fsm);
+        nn_list_insert (&self->free, &slot->item, nn_list_end (&self->free));
+    }
+}
+
+static struct nn_surveyor_slot *nn_surveyor_findslot (
+    struct nn_surveyor *self, void *source)
+{
+    struct nn_surveyor_slot *slot;
+
+    /*  Returns the slot the event source belongs to, NULL if the source
+        is not a deadline of any of the slots. */
+    if (!self->slots)
+        return NULL;
+    if ((char*) source < (char*) self->slots ||
+          (char*) source >= (char*) (self->slots + self->window))
+        return NULL;
+    slot = self->slots + ((char*) source - (char*) self->slots) /
+        sizeof (struct nn_surveyor_slot);
+    nn_assert (source == &slot->deadline);
+    return slot;
+}
+
+static void nn_surveyor_slot_done (struct nn_surveyor *self,
+    struct nn_surveyor_slot *slot)
+{
+    /*  The survey is over. Any further responses to it will be dropped. */
+    nn_hash_erase (&self->surveys, &slot->hashitem);
+    nn_list_erase (&self->active, &slot->item);
+    nn_deadline_clear (&slot->deadline);
+    slot->state = NN_SURVEYOR_SLOT_FREE;
+    nn_list_insert (&self->free, &slot->item, nn_list_end (&self->free));
+}
+
+static int nn_surveyor_send_window (struct nn_surveyor *self,
+    struct nn_msg *msg)
+{
+    int rc;
+    struct nn_surveyor_slot *slot;
+
+    /*  First check whether the survey can be sent at all. */
+    if (!(nn_xsurveyor_events (&self->xsurveyor.sockbase) &
+          NN_SOCKBASE_EVENT_OUT))
+        return -EAGAIN;
+
+    /*  If all the slots are taken, the oldest survey is cancelled to make
+        space for the new one, same as a single survey is cancelled by
+        starting a new one. */
+    if (nn_slow (nn_list_empty (&self->free)))
+        nn_surveyor_slot_done (self, nn_cont (nn_list_begin (&self->active),
+            struct nn_surveyor_slot, item));
+    slot = nn_cont (nn_list_begin (&self->free), struct nn_surveyor_slot,
+        item);
+    nn_list_erase (&self->free, &slot->item);
+
+    /*  Generate new survey ID and tag the survey body with it. */
+    ++self->surveyid;
+    nn_assert (nn_chunkref_size (&msg->hdr) == 0);
+    nn_chunkref_term (&msg->hdr);
+    nn_chunkref_init (&msg->hdr, 4);
+    nn_putl (nn_chunkref_data (&msg->hdr), self->surveyid);
+
+    /*  Send the survey and start waiting for the responses. */
+    rc = nn_xsurveyor_send (&self->xsurveyor.sockbase, msg);
+    errnum_assert (rc == 0, -rc);
+    nn_hash_insert (&self->surveys, self->surveyid, &slot->hashitem);
+    nn_list_insert (&self->active, &slot->item, nn_list_end (&self->active));
+    nn_deadline_set (&slot->deadline, self->deadline);
+    slot->state = NN_SURVEYOR_SLOT_ACTIVE;
+
+    return 0;
+}
+
 static int nn_surveyor_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_surveyor *self;
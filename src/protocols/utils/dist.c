@@ -44,6 +44,7 @@ void nn_dist_add (struct nn_dist *self, struct nn_pipe *pipe,
     struct nn_dist_data *data)
 {
     data->pipe = pipe;
+    data->matched = 0;
     nn_list_item_init (&data->item);
 }
 
@@ -69,40 +70,114 @@ int nn_dist_send (struct nn_dist *self, struct nn_msg *msg,
 {
     int rc;
     struct nn_list_item *it;
+    struct nn_list_item *next;
     struct nn_dist_data *data;
     struct nn_msg copy;
 
-    /*  TODO: We can optimise for the case when there's only one outbound
-        pipe here. No message copying is needed in such case. */
-
     /*  In the specific case when there are no outbound pipes. There's nowhere
         to send the message to. Deallocate it. */
-    if (nn_slow (self->count) == 0) {
+    if (nn_slow (self->count == 0)) {
         nn_msg_term (msg);
         return 0;
     }
 
-    /*  Send the message to all the subscribers. */
-    nn_msg_bulkcopy_start (msg, self->count);
+    /*  If there's only one outbound pipe, the message can be passed to it
+        without copying or touching the reference counts. */
+    if (self->count == 1) {
+        it = nn_list_begin (&self->pipes);
+        data = nn_cont (it, struct nn_dist_data, item);
+        if (nn_slow (data->pipe == exclude)) {
+            nn_msg_term (msg);
+            return 0;
+        }
+        rc = nn_pipe_send (data->pipe, msg);
+        errnum_assert (rc >= 0, -rc);
+        if (rc & NN_PIPE_RELEASE) {
+            --self->count;
+            nn_list_erase (&self->pipes, it);
+        }
+        return 0;
+    }
+
+    /*  Send the message to all the subscribers. The chunks are shared among
+        all the copies so that the reference counts are adjusted only once.
+        The last pipe gets the original message. */
+    nn_msg_bulkcopy_start (msg, self->count - 1);
     it = nn_list_begin (&self->pipes);
     while (it != nn_list_end (&self->pipes)) {
-       data = nn_cont (it, struct nn_dist_data, item);
-       nn_msg_bulkcopy_cp (&copy, msg);
-       if (nn_fast (data->pipe == exclude)) {
-           nn_msg_term (&copy);
-       }
-       else {
-           rc = nn_pipe_send (data->pipe, &copy);
-           errnum_assert (rc >= 0, -rc);
-           if (rc & NN_PIPE_RELEASE) {
-               --self->count;
-               it = nn_list_erase (&self->pipes, it);
-               continue;
-           }
-       }
-       it = nn_list_next (&self->pipes, it);
+        data = nn_cont (it, struct nn_dist_data, item);
+        next = nn_list_next (&self->pipes, it);
+        if (next == nn_list_end (&self->pipes))
+            nn_msg_mv (&copy, msg);
+        else
+            nn_msg_bulkcopy_cp (&copy, msg);
+        if (nn_slow (data->pipe == exclude)) {
+            nn_msg_term (&copy);
+        }
+        else {
+            rc = nn_pipe_send (data->pipe, &copy);
+            errnum_assert (rc >= 0, -rc);
+            if (rc & NN_PIPE_RELEASE) {
+                --self->count;
+                nn_list_erase (&self->pipes, it);
+            }
+        }
+        it = next;
+    }
+
+    return 0;
+}
+
+int nn_dist_send_matching (struct nn_dist *self, struct nn_msg *msg,
+    nn_dist_match_fn match)
+{
+    int rc;
+    size_t count;
+    struct nn_list_item *it;
+    struct nn_dist_data *data;
+    struct nn_msg copy;
+
+    /*  Find out which pipes the message should be sent to. That way the exact
+        number of copies is known in advance. */
+    count = 0;
+    for (it = nn_list_begin (&self->pipes); it != nn_list_end (&self->pipes);
+          it = nn_list_next (&self->pipes, it)) {
+        data = nn_cont (it, struct nn_dist_data, item);
+        data->matched = match (data, msg);
+        if (data->matched)
+            ++count;
+    }
+
+    /*  Nobody is interested in the message. */
+    if (count == 0) {
+        nn_msg_term (msg);
+        return 0;
+    }
+
+    /*  Send the message to the matching pipes. As with nn_dist_send, the last
+        pipe gets the original message. */
+    nn_msg_bulkcopy_start (msg, count - 1);
+    it = nn_list_begin (&self->pipes);
+    while (count) {
+        data = nn_cont (it, struct nn_dist_data, item);
+        if (!data->matched) {
+            it = nn_list_next (&self->pipes, it);
+            continue;
+        }
+        --count;
+        if (count == 0)
+            nn_msg_mv (&copy, msg);
+        else
+            nn_msg_bulkcopy_cp (&copy, msg);
+        rc = nn_pipe_send (data->pipe, &copy);
+        errnum_assert (rc >= 0, -rc);
+        if (rc & NN_PIPE_RELEASE) {
+            --self->count;
+            it = nn_list_erase (&self->pipes, it);
+            continue;
+        }
+        it = nn_list_next (&self->pipes, it);
     }
-    nn_msg_term (msg);
 
     return 0;
 }
@@ -32,8 +32,15 @@
 struct nn_dist_data {
     struct nn_list_item item;
     struct nn_pipe *pipe;
+
+    /*  Used by nn_dist_send_matching to remember the result of the match. */
+    int matched;
 };
 
+/*  Returns 1 if the message should be sent to the pipe, 0 otherwise. */
+typedef int (*nn_dist_match_fn) (struct nn_dist_data *data,
+    struct nn_msg *msg);
+
 struct nn_dist {
     size_t count;
     struct nn_list pipes;
@@ -54,4 +61,9 @@ void nn_dist_out (struct nn_dist *self, struct nn_pipe *pipe,
 int nn_dist_send (struct nn_dist *self, struct nn_msg *msg,
     struct nn_pipe *exclude);
 
+/*  Sends the message to all the attached pipes for which 'match' function
+    returns 1. */
+int nn_dist_send_matching (struct nn_dist *self, struct nn_msg *msg,
+    nn_dist_match_fn match);
+
 #endif
@@ -26,10 +26,15 @@
 #include "../../utils/cont.h"
 
 #include <stddef.h>
+#include <limits.h>
+
+/*  Private functions. */
+static void nn_lb_leastout (struct nn_lb *self);
 
 void nn_lb_init (struct nn_lb *self)
 {
     nn_priolist_init (&self->priolist);
+    self->leastout = 0;
 }
 
 void nn_lb_term (struct nn_lb *self)
@@ -41,6 +46,7 @@ void nn_lb_add (struct nn_lb *self, struct nn_pipe *pipe,
     struct nn_lb_data *data, int priority)
 {
     nn_priolist_add (&self->priolist, pipe, &data->priolist, priority);
+    data->outstanding = 0;
 }
 
 void nn_lb_rm (struct nn_lb *self, struct nn_pipe *pipe,
@@ -64,13 +70,24 @@ int nn_lb_send (struct nn_lb *self, struct nn_msg *msg)
 {
     int rc;
     struct nn_pipe *pipe;
+    struct nn_lb_data *data;
 
     /*  Pipe is NULL only when there are no avialable pipes. */
     pipe = nn_priolist_getpipe (&self->priolist);
     if (nn_slow (!pipe))
         return -EAGAIN;
 
+    /*  Choose the least loaded pipe instead of the next one in order. */
+    if (self->leastout) {
+        nn_lb_leastout (self);
+        pipe = nn_priolist_getpipe (&self->priolist);
+    }
+
     /*  Send the messsage. */
+    data = nn_cont (nn_priolist_getdata (&self->priolist),
+        struct nn_lb_data, priolist);
+    if (nn_fast (data->outstanding < INT_MAX))
+        ++data->outstanding;
     rc = nn_pipe_send (pipe, msg);
     errnum_assert (rc >= 0, -rc);
 
@@ -80,3 +97,37 @@ int nn_lb_send (struct nn_lb *self, struct nn_msg *msg)
     return rc & ~NN_PIPE_RELEASE;
 }
 
+void nn_lb_setleastout (struct nn_lb *self, int leastout)
+{
+    self->leastout = leastout;
+}
+
+void nn_lb_processed (struct nn_lb *self, struct nn_lb_data *data,
+    uint32_t count)
+{
+    /*  The peer may report messages that were sent before the counting
+        started, so never go below zero. */
+    data->outstanding = count < (uint32_t) data->outstanding ?
+        data->outstanding - (int) count : 0;
+}
+
+static void nn_lb_leastout (struct nn_lb *self)
+{
+    struct nn_priolist_data *first;
+    struct nn_priolist_data *it;
+    struct nn_lb_data *data;
+    struct nn_lb_data *best;
+
+    /*  Walk through the active pipes of the current priority, starting with
+        the one that would be used by round-robin. Thus, the first pipe
+        among those with the fewest outstanding messages is chosen. */
+    first = nn_priolist_getdata (&self->priolist);
+    best = nn_cont (first, struct nn_lb_data, priolist);
+    for (it = nn_priolist_next (&self->priolist, first); it != first;
+          it = nn_priolist_next (&self->priolist, it)) {
+        data = nn_cont (it, struct nn_lb_data, priolist);
+        if (data->outstanding < best->outstanding)
+            best = data;
+    }
+    nn_priolist_setcurrent (&self->priolist, &best->priolist);
+}
@@ -27,14 +27,23 @@
 
 #include "priolist.h"
 
-/*  A load balancer. Round-robins messages to a set of pipes. */
+/*  A load balancer. Round-robins messages to a set of pipes. Optionally,
+    it sends each message to the pipe with the fewest outstanding messages,
+    i.e. messages sent to the pipe but not yet reported as processed. */
 
 struct nn_lb_data {
     struct nn_priolist_data priolist;
+
+    /*  Number of messages sent to the pipe and not yet processed. */
+    int outstanding;
 };
 
 struct nn_lb {
     struct nn_priolist priolist;
+
+    /*  If set, messages are sent to the pipe with the fewest outstanding
+        messages rather than in round-robin fashion. */
+    int leastout;
 };
 
 void nn_lb_init (struct nn_lb *self);
@@ -48,4 +57,14 @@ void nn_lb_out (struct nn_lb *self, struct nn_pipe *pipe,
 int nn_lb_can_send (struct nn_lb *self);
 int nn_lb_send (struct nn_lb *self, struct nn_msg *msg);
 
+/*  Switches between round-robin (0) and least-outstanding (1) policy. Pipes
+    with the same number of outstanding messages are still round-robined.
+    Only pipes with the highest priority are considered. */
+void nn_lb_setleastout (struct nn_lb *self, int leastout);
+
+/*  Reports that 'count' messages previously sent to the pipe were
+    processed. */
+void nn_lb_processed (struct nn_lb *self, struct nn_lb_data *data,
+    uint32_t count);
+
 #endif
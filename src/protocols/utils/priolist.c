@@ -137,3 +137,30 @@ void nn_priolist_advance (struct nn_priolist *self, int release)
     }
 }
 
+struct nn_priolist_data *nn_priolist_getdata (struct nn_priolist *self)
+{
+    if (nn_slow (self->current == -1))
+        return NULL;
+    return self->slots [self->current - 1].current;
+}
+
+struct nn_priolist_data *nn_priolist_next (struct nn_priolist *self,
+    struct nn_priolist_data *data)
+{
+    struct nn_priolist_slot *slot;
+    struct nn_list_item *it;
+
+    slot = &self->slots [data->priority - 1];
+    it = nn_list_next (&slot->pipes, &data->item);
+    if (!it)
+        it = nn_list_begin (&slot->pipes);
+    return nn_cont (it, struct nn_priolist_data, item);
+}
+
+void nn_priolist_setcurrent (struct nn_priolist *self,
+    struct nn_priolist_data *data)
+{
+    nn_assert (data->priority == self->current);
+    nn_assert (nn_list_item_isinlist (&data->item));
+    self->slots [self->current - 1].current = data;
+}
@@ -59,4 +59,18 @@ int nn_priolist_is_active (struct nn_priolist *self);
 struct nn_pipe *nn_priolist_getpipe (struct nn_priolist *self);
 void nn_priolist_advance (struct nn_priolist *self, int release);
 
+/*  Returns the data of the pipe to be used next, NULL if there's none. */
+struct nn_priolist_data *nn_priolist_getdata (struct nn_priolist *self);
+
+/*  Returns the active pipe following the specified one. Only pipes with
+    the same priority are considered. After the last one, the first one
+    is returned. */
+struct nn_priolist_data *nn_priolist_next (struct nn_priolist *self,
+    struct nn_priolist_data *data);
+
+/*  Makes the specified active pipe the one to be used next. It must have
+    the same priority as the pipe returned by nn_priolist_getdata(). */
+void nn_priolist_setcurrent (struct nn_priolist *self,
+    struct nn_priolist_data *data);
+
 #endif
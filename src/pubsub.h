@@ -34,6 +34,7 @@ extern "C" {
 
 #define NN_SUB_SUBSCRIBE 1
 #define NN_SUB_UNSUBSCRIBE 2
+#define NN_SUB_FORWARD 3
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,8 @@ extern "C" {
 #define NN_REP (NN_PROTO_REQREP * 16 + 1)
 
 #define NN_REQ_RESEND_IVL 1
+#define NN_REQ_WINDOW 2
+#define NN_REQ_ID 3
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,8 @@ extern "C" {
 #define NN_RESPONDENT (NN_PROTO_SURVEY * 16 + 1)
 
 #define NN_SURVEYOR_DEADLINE 1
+#define NN_SURVEYOR_WINDOW 2
+#define NN_SURVEYOR_ID 3
 
 #ifdef __cplusplus
 }
@@ -174,6 +174,10 @@ void nn_pipebase_received (struct nn_pipebase *self);
 /*  Call this function when current outgoing message was fully sent. */
 void nn_pipebase_sent (struct nn_pipebase *self);
 
+/*  Call this function when message data are copied in memory on their way
+    from the network to the pipe. It is used for diagnostic purposes only. */
+void nn_pipebase_copied (struct nn_pipebase *self, size_t bytes);
+
 /*  Returns the AIO context associated with the pipe. */
 struct nn_ctx *nn_pipebase_getctx (struct nn_pipebase *self);
 
@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+
+#include "msgring.h"
+
+#include "../../utils/alloc.h"
+#include "../../utils/fast.h"
+#include "../../utils/err.h"
+
+/*  Positions are kept in 31 bits so that the top bit can be used to mark
+    the reader asleep. */
+#define NN_MSGRING_POSMASK 0x7fffffff
+#define NN_MSGRING_ASLEEP 0x80000000
+
+void nn_msgring_init (struct nn_msgring *self, size_t size)
+{
+    nn_assert (size > 0 && size <= NN_MSGRING_POSMASK / 2);
+    nn_assert ((size & (size - 1)) == 0);
+
+    self->msgs = nn_alloc (size * sizeof (struct nn_msg), "msgring");
+    alloc_assert (self->msgs);
+    self->size = (uint32_t) size;
+    self->out.pos = 0;
+    self->out.flushed = 0;
+    self->out.head = 0;
+    nn_atomic_init (&self->tail, NN_MSGRING_ASLEEP);
+    nn_atomic_init (&self->head, 0);
+    self->in.pos = 0;
+    self->in.tail = 0;
+}
+
+void nn_msgring_term (struct nn_msgring *self)
+{
+    uint32_t pos;
+
+    /*  Deallocate all the messages written to the ring, published or not. */
+    for (pos = self->in.pos; pos != self->out.pos;
+          pos = (pos + 1) & NN_MSGRING_POSMASK)
+        nn_msg_term (&self->msgs [pos & (self->size - 1)]);
+
+    nn_atomic_term (&self->head);
+    nn_atomic_term (&self->tail);
+    nn_free (self->msgs);
+}
+
+int nn_msgring_write (struct nn_msgring *self, struct nn_msg *msg)
+{
+    /*  If the ring seems to be full, check whether the reader have made
+        some progress meanwhile. */
+    if (nn_slow (((self->out.pos - self->out.head) & NN_MSGRING_POSMASK) ==
+          self->size)) {
+        self->out.head = nn_atomic_get (&self->head);
+        if (((self->out.pos - self->out.head) & NN_MSGRING_POSMASK) ==
+              self->size)
+            return -EAGAIN;
+    }
+
+    nn_msg_mv (&self->msgs [self->out.pos & (self->size - 1)], msg);
+    self->out.pos = (self->out.pos + 1) & NN_MSGRING_POSMASK;
+
+    return 0;
+}
+
+int nn_msgring_flush (struct nn_msgring *self)
+{
+    uint32_t old;
+
+    /*  Nothing to publish. */
+    if (self->out.pos == self->out.flushed)
+        return 1;
+
+    /*  Publish the new messages, unless the reader is asleep. */
+    old = nn_atomic_cas (&self->tail, self->out.flushed, self->out.pos);
+    if (nn_fast (old == self->out.flushed)) {
+        self->out.flushed = self->out.pos;
+        return 1;
+    }
+
+    /*  The reader is asleep. As it doesn't touch the tail while asleep, it's
+        safe to overwrite it. The caller has to wake the reader up. */
+    nn_assert (old == NN_MSGRING_ASLEEP);
+    nn_atomic_set (&self->tail, self->out.pos);
+    self->out.flushed = self->out.pos;
+    return 0;
+}
+
+int nn_msgring_read (struct nn_msgring *self, struct nn_msg *msg)
+{
+    uint32_t tail;
+
+    /*  If there are no more messages known to be available, let the writer
+        know that all the slots read so far can be reused and check whether
+        new messages have been published. If not so, go asleep. */
+    if (nn_slow (self->in.pos == self->in.tail)) {
+        nn_atomic_set (&self->head, self->in.pos);
+        tail = nn_atomic_cas (&self->tail, self->in.pos, NN_MSGRING_ASLEEP);
+        if (tail == self->in.pos || tail == NN_MSGRING_ASLEEP)
+            return -EAGAIN;
+        self->in.tail = tail;
+    }
+
+    nn_msg_mv (msg, &self->msgs [self->in.pos & (self->size - 1)]);
+    self->in.pos = (self->in.pos + 1) & NN_MSGRING_POSMASK;
+
+    return 0;
+}
+
@@ -0,0 +1,120 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+
+#ifndef NN_MSGRING_INCLUDED
+#define NN_MSGRING_INCLUDED
+
+#include "../../utils/msg.h"
+#include "../../utils/atomic.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  This class is a wait-free uni-directional message queue. Unlike
+    nn_msgqueue, it needs no external synchronisation, provided that there's
+    a single writer thread and a single reader thread.
+
+    Written messages are not visible to the reader till nn_msgring_flush is
+    called. That way, the writer can publish a whole batch of messages at
+    once. When the reader finds the ring empty it goes asleep. The writer
+    is notified about that by nn_msgring_flush returning 0 and it is
+    responsible for waking the reader up. Otherwise, the two sides only touch
+    each other's data when the ring is found to be empty or full. */
+
+/*  The members touched by the writer and the reader are separated by at
+    least this many bytes so that they never share a cache line. */
+#define NN_MSGRING_PADDING 128
+
+struct nn_msgring {
+
+    /*  Immutable after initialisation. */
+    struct nn_msg *msgs;
+    uint32_t size;
+
+    uint8_t pad0 [NN_MSGRING_PADDING];
+
+    /*  Owned by the writer. */
+    struct {
+
+        /*  Position where the next message will be written. */
+        uint32_t pos;
+
+        /*  Position up to which the messages were published. */
+        uint32_t flushed;
+
+        /*  Last known position of the reader. The writer updates it only
+            when the ring seems to be full. */
+        uint32_t head;
+    } out;
+
+    uint8_t pad1 [NN_MSGRING_PADDING];
+
+    /*  Position up to which the messages are published or NN_MSGRING_ASLEEP
+        if the reader found the ring empty and is waiting to be woken up.
+        Written by both sides. */
+    struct nn_atomic tail;
+
+    uint8_t pad2 [NN_MSGRING_PADDING];
+
+    /*  Position of the reader. The reader updates it only when it runs out
+        of published messages, the writer reads it only when the ring seems
+        to be full. */
+    struct nn_atomic head;
+
+    uint8_t pad3 [NN_MSGRING_PADDING];
+
+    /*  Owned by the reader. */
+    struct {
+
+        /*  Position of the next message to read. */
+        uint32_t pos;
+
+        /*  Position up to which messages are known to be published. */
+        uint32_t tail;
+    } in;
+
+    uint8_t pad4 [NN_MSGRING_PADDING];
+};
+
+/*  Initialise the ring. 'size' is the number of messages it can hold and
+    it must be a power of two. The reader is initially asleep. */
+void nn_msgring_init (struct nn_msgring *self, size_t size);
+
+/*  Terminate the ring. Messages still in the ring are deallocated. */
+void nn_msgring_term (struct nn_msgring *self);
+
+/*  Writes a message to the ring. -EAGAIN is returned if the ring is full.
+    The message is not visible to the reader till nn_msgring_flush is
+    called. */
+int nn_msgring_write (struct nn_msgring *self, struct nn_msg *msg);
+
+/*  Publishes all the messages written so far. Returns 0 if the reader is
+    asleep and has to be woken up, 1 otherwise. */
+int nn_msgring_flush (struct nn_msgring *self);
+
+/*  Reads a message from the ring. -EAGAIN is returned if there's no message
+    to read. In such case the reader is considered to be asleep. */
+int nn_msgring_read (struct nn_msgring *self, struct nn_msg *msg);
+
+#endif
+
@@ -27,8 +27,10 @@
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
 #include "../../utils/fast.h"
+#include "../../utils/wire.h"
 
 #include <stdint.h>
+#include <string.h>
 
 /*  Types of messages passed via IPC transport. */
 #define NN_SIPC_MSG_NORMAL 1
@@ -42,10 +44,17 @@
 #define NN_SIPC_STATE_DONE 5
 #define NN_SIPC_STATE_STOPPING 6
 
-/*  Possible states of the inbound part of the object. */
+/*  Possible states of the inbound part of the object. In HASMSG state
+    the inbound queue is full and no data are being received. In CLOSED
+    state the connection has failed but there are still messages in the
+    inbound queue waiting to be passed to the user. */
 #define NN_SIPC_INSTATE_HDR 1
 #define NN_SIPC_INSTATE_BODY 2
 #define NN_SIPC_INSTATE_HASMSG 3
+#define NN_SIPC_INSTATE_CLOSED 4
+
+/*  Events the object sends to itself. */
+#define NN_SIPC_ACTION_DRAINED 3
 
 /*  Possible states of the outbound part of the object. */
 #define NN_SIPC_OUTSTATE_IDLE 1
@@ -61,6 +70,9 @@ const struct nn_pipebase_vfptr nn_sipc_pipebase_vfptr = {
 
 /*  Private functions. */
 static void nn_sipc_handler (struct nn_fsm *self, void *source, int type);
+static void nn_sipc_received (struct nn_sipc *self);
+static void nn_sipc_recv_next (struct nn_sipc *self);
+static void nn_sipc_inq_clear (struct nn_sipc *self);
 
 void nn_sipc_init (struct nn_sipc *self, struct nn_epbase *epbase,
     struct nn_fsm *owner)
@@ -73,17 +85,22 @@ void nn_sipc_init (struct nn_sipc *self, struct nn_epbase *epbase,
     nn_pipebase_init (&self->pipebase, &nn_sipc_pipebase_vfptr, epbase);
     self->instate = -1;
     nn_msg_init (&self->inmsg, 0);
+    self->inhead = 0;
+    self->incount = 0;
     self->outstate = -1;
     nn_msg_init (&self->outmsg, 0);
     nn_fsm_event_init (&self->done);
+    nn_fsm_event_init (&self->drained);
 }
 
 void nn_sipc_term (struct nn_sipc *self)
 {
     nn_assert (self->state == NN_SIPC_STATE_IDLE);
 
+    nn_fsm_event_term (&self->drained);
     nn_fsm_event_term (&self->done);
     nn_msg_term (&self->outmsg);
+    nn_sipc_inq_clear (self);
     nn_msg_term (&self->inmsg);
     nn_pipebase_term (&self->pipebase);
     nn_streamhdr_term (&self->streamhdr);
@@ -118,6 +135,15 @@ static int nn_sipc_send (struct nn_pipebase *self, struct nn_msg *msg)
 
     sipc = nn_cont (self, struct nn_sipc, pipebase);
 
+    /*  The connection is already broken. The pipe is not reported as
+        writable any more so that the socket sends subsequent messages to
+        other pipes. This one is dropped the same way it would be dropped
+        had the failure been noticed a moment later. */
+    if (nn_slow (sipc->instate == NN_SIPC_INSTATE_CLOSED)) {
+        nn_msg_term (msg);
+        return 0;
+    }
+
     nn_assert (sipc->state == NN_SIPC_STATE_ACTIVE);
     nn_assert (sipc->outstate == NN_SIPC_OUTSTATE_IDLE);
 
@@ -151,15 +177,29 @@ static int nn_sipc_recv (struct nn_pipebase *self, struct nn_msg *msg)
     sipc = nn_cont (self, struct nn_sipc, pipebase);
 
     nn_assert (sipc->state == NN_SIPC_STATE_ACTIVE);
-    nn_assert (sipc->instate == NN_SIPC_INSTATE_HASMSG);
-
-    /*  Move received message to the user. */
-    nn_msg_mv (msg, &sipc->inmsg);
-    nn_msg_init (&sipc->inmsg, 0);
-
-    /*  Start receiving new message. */
-    sipc->instate = NN_SIPC_INSTATE_HDR;
-    nn_usock_recv (sipc->usock, sipc->inhdr, sizeof (sipc->inhdr));
+    nn_assert (sipc->incount > 0);
+
+    /*  Move the oldest received message to the user. */
+    nn_msg_mv (msg, &sipc->inq [sipc->inhead]);
+    sipc->inhead = (sipc->inhead + 1) % NN_SIPC_INQ_SIZE;
+    --sipc->incount;
+
+    /*  If receiving was suspended because the inbound queue was full,
+        resume it. */
+    if (sipc->instate == NN_SIPC_INSTATE_HASMSG)
+        nn_sipc_recv_next (sipc);
+
+    /*  If there are more messages queued, the pipe remains readable. */
+    if (sipc->incount)
+        nn_pipebase_received (&sipc->pipebase);
+
+    /*  If the connection have failed while there were still messages in the
+        inbound queue and the last of them was passed to the user now, the
+        failure can be reported. The pipe can't be removed from the socket
+        while the socket is receiving from it, so it's done later on in
+        the handler. */
+    else if (nn_slow (sipc->instate == NN_SIPC_INSTATE_CLOSED))
+        nn_fsm_raiseself (&sipc->fsm, &sipc->drained, NN_SIPC_ACTION_DRAINED);
 
     return 0;
 }
@@ -169,9 +209,17 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
     int rc;
     struct nn_sipc *sipc;
     uint64_t size;
+    size_t buffered;
+    const void *data;
 
     sipc = nn_cont (self, struct nn_sipc, fsm);
 
+    /*  The object may have been stopped before the event the inbound queue
+        was drained was processed. There's nothing left to report then. */
+    if (nn_slow (source == &sipc->fsm && type == NN_SIPC_ACTION_DRAINED &&
+          sipc->state != NN_SIPC_STATE_ACTIVE))
+        return;
+
 /******************************************************************************/
 /*  STOP procedure.                                                           */
 /******************************************************************************/
@@ -201,6 +249,12 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
         if (source == &sipc->fsm) {
             switch (type) {
             case NN_FSM_START:
+
+                /*  Drop any messages left over from the previous
+                    connection. */
+                nn_sipc_inq_clear (sipc);
+                sipc->instate = -1;
+
                 nn_streamhdr_start (&sipc->streamhdr, sipc->usock);
                 sipc->state = NN_SIPC_STATE_PROTOHDR;
                 return;
@@ -228,7 +282,7 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
 
                 /* Raise the error and move directly to the DONE state.
                    streamhdr object will be stopped later on. */
-                sipc->state == NN_SIPC_STATE_DONE;
+                sipc->state = NN_SIPC_STATE_DONE;
                 nn_fsm_raise (&sipc->fsm, &sipc->done, sipc, NN_SIPC_ERROR);
                 return;
 
@@ -250,10 +304,12 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
                  rc = nn_pipebase_start (&sipc->pipebase);
                  errnum_assert (rc == 0, -rc);
                  
-                 /*  Start receiving a message in asynchronous manner. */
-                 sipc->instate = NN_SIPC_INSTATE_HDR;
-                 nn_usock_recv (sipc->usock, &sipc->inhdr,
-                     sizeof (sipc->inhdr));
+                 /*  Start receiving messages in asynchronous manner. Note
+                     that first messages may have been already read from
+                     the socket during the protocol header exchange. */
+                 nn_sipc_recv_next (sipc);
+                 if (sipc->incount)
+                     nn_pipebase_received (&sipc->pipebase);
 
                  /*  Mark the pipe as available for sending. */
                  sipc->outstate = NN_SIPC_OUTSTATE_IDLE;
@@ -271,6 +327,22 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
 /*  ACTIVE state.                                                             */
 /******************************************************************************/
     case NN_SIPC_STATE_ACTIVE:
+        if (source == &sipc->fsm) {
+            switch (type) {
+            case NN_SIPC_ACTION_DRAINED:
+
+                /*  All the messages received before the connection failed
+                    were passed to the user. Report the failure now. */
+                nn_assert (sipc->instate == NN_SIPC_INSTATE_CLOSED);
+                nn_pipebase_stop (&sipc->pipebase);
+                sipc->state = NN_SIPC_STATE_DONE;
+                nn_fsm_raise (&sipc->fsm, &sipc->done, sipc, NN_SIPC_ERROR);
+                return;
+
+            default:
+                nn_assert (0);
+            }
+        }
         if (source == sipc->usock) {
             switch (type) {
             case NN_USOCK_SENT:
@@ -297,10 +369,19 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
 
                     /*  Special case when size of the message body is 0. */
                     if (!size) {
-                        nn_pipebase_received (&sipc->pipebase);
-                        nn_assert (0);
+                        nn_sipc_received (sipc);
+                        return;
                     }
 
+                    /*  The beginning of the body may have been read into
+                        the usock's batch buffer along with the header. That
+                        part has to be copied. The rest of the body will be
+                        read directly into the message. */
+                    buffered = nn_usock_buffered (sipc->usock, &data);
+                    if (buffered)
+                        nn_pipebase_copied (&sipc->pipebase,
+                            buffered < size ? buffered : (size_t) size);
+
                     /*  Start receiving the message body. */
                     sipc->instate = NN_SIPC_INSTATE_BODY;
                     nn_usock_recv (sipc->usock,
@@ -310,11 +391,8 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
 
                 case NN_SIPC_INSTATE_BODY:
 
-                    /*  Message body was received. Notify the owner that it
-                        can receive it. */
-                    sipc->instate = NN_SIPC_INSTATE_HASMSG;
-                    nn_pipebase_received (&sipc->pipebase);
-
+                    /*  Message body was received. */
+                    nn_sipc_received (sipc);
                     return;
 
                 default:
@@ -322,8 +400,19 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
                 }
 
             case NN_USOCK_ERROR:
+
+                /*  Messages read before the connection failed are still
+                    delivered to the user. The failure is reported once
+                    the inbound queue is drained. Until then, the pipe
+                    accepts at most one more outbound message, which is
+                    dropped, and is never reported as writable again. */
+                if (sipc->incount) {
+                    sipc->instate = NN_SIPC_INSTATE_CLOSED;
+                    return;
+                }
+
                 nn_pipebase_stop (&sipc->pipebase);
-                sipc->state == NN_SIPC_STATE_DONE;
+                sipc->state = NN_SIPC_STATE_DONE;
                 nn_fsm_raise (&sipc->fsm, &sipc->done, sipc, NN_SIPC_ERROR);
                 return;
 
@@ -349,5 +438,73 @@ static void nn_sipc_handler (struct nn_fsm *self, void *source, int type)
     }
 }
 
-#endif
+static void nn_sipc_received (struct nn_sipc *self)
+{
+    int wasempty;
+
+    /*  Move the message to the inbound queue. */
+    nn_assert (self->incount < NN_SIPC_INQ_SIZE);
+    wasempty = self->incount == 0 ? 1 : 0;
+    nn_msg_mv (&self->inq [(self->inhead + self->incount) % NN_SIPC_INQ_SIZE],
+        &self->inmsg);
+    nn_msg_init (&self->inmsg, 0);
+    ++self->incount;
+
+    nn_sipc_recv_next (self);
+
+    /*  If the pipe wasn't readable so far, notify the owner that it
+        can receive messages now. */
+    if (wasempty)
+        nn_pipebase_received (&self->pipebase);
+}
+
+static void nn_sipc_recv_next (struct nn_sipc *self)
+{
+    size_t len;
+    const uint8_t *data;
+    uint64_t size;
+    struct nn_msg *msg;
+
+    /*  Frame all the complete messages that were already read from the socket.
+        That way there's no need to do a state machine transition for each
+        small message. */
+    while (self->incount < NN_SIPC_INQ_SIZE) {
+        len = nn_usock_buffered (self->usock, (const void**) &data);
+        if (len < sizeof (self->inhdr))
+            break;
+        nn_assert (data [0] == NN_SIPC_MSG_NORMAL);
+        size = nn_getll (data + 1);
+        if (size > len - sizeof (self->inhdr))
+            break;
+        msg = &self->inq [(self->inhead + self->incount) % NN_SIPC_INQ_SIZE];
+        nn_msg_init (msg, (size_t) size);
+        memcpy (nn_chunkref_data (&msg->body), data + sizeof (self->inhdr),
+            (size_t) size);
+        nn_usock_consume (self->usock, sizeof (self->inhdr) + (size_t) size);
+        nn_pipebase_copied (&self->pipebase, (size_t) size);
+        ++self->incount;
+    }
+
+    /*  If the inbound queue is full, stop receiving till the user gets some
+        of the messages. */
+    if (self->incount == NN_SIPC_INQ_SIZE) {
+        self->instate = NN_SIPC_INSTATE_HASMSG;
+        return;
+    }
+
+    /*  Start receiving new message. */
+    self->instate = NN_SIPC_INSTATE_HDR;
+    nn_usock_recv (self->usock, self->inhdr, sizeof (self->inhdr));
+}
+
+static void nn_sipc_inq_clear (struct nn_sipc *self)
+{
+    while (self->incount) {
+        nn_msg_term (&self->inq [self->inhead]);
+        self->inhead = (self->inhead + 1) % NN_SIPC_INQ_SIZE;
+        --self->incount;
+    }
+    self->inhead = 0;
+}
 
+#endif
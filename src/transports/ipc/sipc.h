@@ -40,6 +40,9 @@
 #define NN_SIPC_ERROR 1
 #define NN_SIPC_STOPPED 2
 
+/*  Maximum number of received messages queued for the user. */
+#define NN_SIPC_INQ_SIZE 16
+
 struct nn_sipc {
 
     /*  The state machine. */
@@ -67,6 +70,12 @@ struct nn_sipc {
     /*  Message being received at the moment. */
     struct nn_msg inmsg;
 
+    /*  Circular buffer of received messages not yet passed to the user.
+        'incount' messages starting at 'inhead' are queued. */
+    struct nn_msg inq [NN_SIPC_INQ_SIZE];
+    int inhead;
+    int incount;
+
     /*  State of the outbound state machine. */
     int outstate;
 
@@ -78,6 +87,10 @@ struct nn_sipc {
 
     /*  Event raised when the state machine ends. */
     struct nn_fsm_event done;
+
+    /*  Event the state machine sends to itself once the messages received
+        before the connection failed were passed to the user. */
+    struct nn_fsm_event drained;
 };
 
 void nn_sipc_init (struct nn_sipc *self, struct nn_epbase *epbase,
@@ -22,9 +22,18 @@
 
 #include "atcp.h"
 
+#include "../../tcp.h"
+
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
 
+#if defined NN_HAVE_WINDOWS
+#include "../../utils/win.h"
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
 #define NN_ATCP_STATE_IDLE 1
 #define NN_ATCP_STATE_ACCEPTING 2
 #define NN_ATCP_STATE_ACTIVE 3
@@ -43,6 +52,7 @@ void nn_atcp_init (struct nn_atcp *self, struct nn_epbase *epbase,
     nn_fsm_init (&self->fsm, nn_atcp_handler, owner);
     self->state = NN_ATCP_STATE_IDLE;
     nn_usock_init (&self->usock, &self->fsm);
+    self->epbase = epbase;
     self->listener = NULL;
     self->listener_owner = NULL;
     nn_stcp_init (&self->stcp, epbase, &self->fsm);
@@ -87,7 +97,10 @@ void nn_atcp_stop (struct nn_atcp *self)
 
 static void nn_atcp_handler (struct nn_fsm *self, void *source, int type)
 {
+    int rc;
     struct nn_atcp *atcp;
+    int nodelay;
+    size_t sz;
 
     atcp = nn_cont (self, struct nn_atcp, fsm);
 
@@ -153,6 +166,15 @@ static void nn_atcp_handler (struct nn_fsm *self, void *source, int type)
                 nn_fsm_raise (&atcp->fsm, &atcp->accepted, atcp,
                     NN_ATCP_ACCEPTED);
 
+                /*  Set TCP_NODELAY as requested by the user. */
+                sz = sizeof (nodelay);
+                nn_epbase_getopt (atcp->epbase, NN_TCP, NN_TCP_NODELAY,
+                    &nodelay, &sz);
+                nn_assert (sz == sizeof (nodelay));
+                rc = nn_usock_setsockopt (&atcp->usock, IPPROTO_TCP,
+                    TCP_NODELAY, &nodelay, sizeof (nodelay));
+                errnum_assert (rc == 0, -rc);
+
                 /*  Start the stcp state machine. */
                 nn_usock_activate (&atcp->usock);
                 nn_stcp_start (&atcp->stcp, &atcp->usock);
@@ -50,6 +50,10 @@ struct nn_atcp {
     /*  Underlying socket. */
     struct nn_usock usock;
 
+    /*  The endpoint the connection belongs to. Used to retrieve the options
+        that apply to the underlying socket. */
+    struct nn_epbase *epbase;
+
     /*  Listening socket. Valid only while accepting new connection. */
     struct nn_usock *listener;
     struct nn_fsm *listener_owner;
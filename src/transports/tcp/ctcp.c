@@ -28,6 +28,8 @@
 #include "../utils/iface.h"
 #include "../utils/backoff.h"
 
+#include "../../tcp.h"
+
 #include "../../aio/fsm.h"
 #include "../../aio/usock.h"
 
@@ -44,6 +46,7 @@
 #else
 #include <unistd.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #endif
 
 #define NN_CTCP_STATE_IDLE 1
@@ -391,6 +394,8 @@ static void nn_ctcp_start_connecting (struct nn_ctcp *self,
     const char *colon;
     const char *semicolon;
     uint16_t port;
+    int nodelay;
+    size_t sz;
 
     /*  Create IP address from the address string. */
     addr = nn_epbase_getaddr (&self->epbase);
@@ -431,6 +436,14 @@ static void nn_ctcp_start_connecting (struct nn_ctcp *self,
         return;
     }
 
+    /*  Set TCP_NODELAY as requested by the user. */
+    sz = sizeof (nodelay);
+    nn_epbase_getopt (&self->epbase, NN_TCP, NN_TCP_NODELAY, &nodelay, &sz);
+    nn_assert (sz == sizeof (nodelay));
+    rc = nn_usock_setsockopt (&self->usock, IPPROTO_TCP, TCP_NODELAY,
+        &nodelay, sizeof (nodelay));
+    errnum_assert (rc == 0, -rc);
+
     /*  Bind the socket to the local network interface. */
     rc = nn_usock_bind (&self->usock, (struct sockaddr*) &local, locallen);
     errnum_assert (rc == 0, -rc);
@@ -27,7 +27,10 @@
 #include "../../utils/fast.h"
 #include "../../utils/wire.h"
 
+#include "../../nn.h"
+
 #include <stdint.h>
+#include <string.h>
 
 /*  States of the object as a whole. */
 #define NN_STCP_STATE_IDLE 1
@@ -37,10 +40,17 @@
 #define NN_STCP_STATE_DONE 5
 #define NN_STCP_STATE_STOPPING 6
 
-/*  Possible states of the inbound part of the object. */
+/*  Possible states of the inbound part of the object. In HASMSG state
+    the inbound queue is full and no data are being received. In CLOSED
+    state the connection has failed but there are still messages in the
+    inbound queue waiting to be passed to the user. */
 #define NN_STCP_INSTATE_HDR 1
 #define NN_STCP_INSTATE_BODY 2
 #define NN_STCP_INSTATE_HASMSG 3
+#define NN_STCP_INSTATE_CLOSED 4
+
+/*  Events the object sends to itself. */
+#define NN_STCP_ACTION_DRAINED 3
 
 /*  Possible states of the outbound part of the object. */
 #define NN_STCP_OUTSTATE_IDLE 1
@@ -56,10 +66,18 @@ const struct nn_pipebase_vfptr nn_stcp_pipebase_vfptr = {
 
 /*  Private functions. */
 static void nn_stcp_handler (struct nn_fsm *self, void *source, int type);
+static void nn_stcp_send_batch (struct nn_stcp *self);
+static void nn_stcp_outq_clear (struct nn_stcp *self);
+static void nn_stcp_received (struct nn_stcp *self);
+static void nn_stcp_recv_next (struct nn_stcp *self);
+static void nn_stcp_inq_clear (struct nn_stcp *self);
 
 void nn_stcp_init (struct nn_stcp *self, struct nn_epbase *epbase,
     struct nn_fsm *owner)
 {
+    int sndbuf;
+    size_t sz;
+
     nn_fsm_init (&self->fsm, nn_stcp_handler, owner);
     self->state = NN_STCP_STATE_IDLE;
     nn_streamhdr_init (&self->streamhdr, &self->fsm);
@@ -68,17 +86,32 @@ void nn_stcp_init (struct nn_stcp *self, struct nn_epbase *epbase,
     nn_pipebase_init (&self->pipebase, &nn_stcp_pipebase_vfptr, epbase);
     self->instate = -1;
     nn_msg_init (&self->inmsg, 0);
+    self->inhead = 0;
+    self->incount = 0;
     self->outstate = -1;
-    nn_msg_init (&self->outmsg, 0);
+    self->outhead = 0;
+    self->outcount = 0;
+    self->outsending = 0;
+    self->outbytes = 0;
+    self->outblocked = 0;
     nn_fsm_event_init (&self->done);
+    nn_fsm_event_init (&self->drained);
+
+    /*  Limit the amount of data queued for sending by NN_SNDBUF. */
+    sz = sizeof (sndbuf);
+    nn_epbase_getopt (epbase, NN_SOL_SOCKET, NN_SNDBUF, &sndbuf, &sz);
+    nn_assert (sz == sizeof (sndbuf));
+    self->sndbuf = (size_t) sndbuf;
 }
 
 void nn_stcp_term (struct nn_stcp *self)
 {
     nn_assert (self->state == NN_STCP_STATE_IDLE);
 
+    nn_fsm_event_term (&self->drained);
     nn_fsm_event_term (&self->done);
-    nn_msg_term (&self->outmsg);
+    nn_stcp_outq_clear (self);
+    nn_stcp_inq_clear (self);
     nn_msg_term (&self->inmsg);
     nn_pipebase_term (&self->pipebase);
     nn_streamhdr_term (&self->streamhdr);
@@ -109,31 +142,47 @@ void nn_stcp_stop (struct nn_stcp *self)
 static int nn_stcp_send (struct nn_pipebase *self, struct nn_msg *msg)
 {
     struct nn_stcp *stcp;
-    struct nn_iovec iov [3];
+    struct nn_stcp_outmsg *outmsg;
+    size_t size;
 
     stcp = nn_cont (self, struct nn_stcp, pipebase);
 
+    /*  The connection is already broken. The pipe is not reported as
+        writable any more so that the socket sends subsequent messages to
+        other pipes. This one is dropped the same way it would be dropped
+        had the failure been noticed a moment later. */
+    if (nn_slow (stcp->instate == NN_STCP_INSTATE_CLOSED)) {
+        nn_msg_term (msg);
+        return 0;
+    }
+
     nn_assert (stcp->state == NN_STCP_STATE_ACTIVE);
-    nn_assert (stcp->outstate == NN_STCP_OUTSTATE_IDLE);
+    nn_assert (stcp->outcount < NN_STCP_OUTQ_SIZE);
 
-    /*  Move the message to the local storage. */
-    nn_msg_term (&stcp->outmsg);
-    nn_msg_mv (&stcp->outmsg, msg);
+    /*  Move the message to the outbound queue. */
+    outmsg = &stcp->outq [(stcp->outhead + stcp->outcount) %
+        NN_STCP_OUTQ_SIZE];
+    nn_msg_mv (&outmsg->msg, msg);
+    ++stcp->outcount;
 
     /*  Serialise the message header. */
-    nn_putll (stcp->outhdr, nn_chunkref_size (&stcp->outmsg.hdr) +
-        nn_chunkref_size (&stcp->outmsg.body));
-
-    /*  Start async sending. */
-    iov [0].iov_base = stcp->outhdr;
-    iov [0].iov_len = sizeof (stcp->outhdr);
-    iov [1].iov_base = nn_chunkref_data (&stcp->outmsg.hdr);
-    iov [1].iov_len = nn_chunkref_size (&stcp->outmsg.hdr);
-    iov [2].iov_base = nn_chunkref_data (&stcp->outmsg.body);
-    iov [2].iov_len = nn_chunkref_size (&stcp->outmsg.body);
-    nn_usock_send (stcp->usock, iov, 3);
-
-    stcp->outstate = NN_STCP_OUTSTATE_SENDING;
+    size = nn_chunkref_size (&outmsg->msg.hdr) +
+        nn_chunkref_size (&outmsg->msg.body);
+    nn_putll (outmsg->hdr, size);
+    stcp->outbytes += size;
+
+    /*  If nothing is being sent at the moment, start sending straight away.
+        Otherwise, the message will be sent along with any other messages
+        queued in the meantime once the current batch is sent. */
+    if (stcp->outstate == NN_STCP_OUTSTATE_IDLE)
+        nn_stcp_send_batch (stcp);
+
+    /*  If there's still room in the outbound queue, the pipe remains
+        writable. */
+    if (stcp->outcount < NN_STCP_OUTQ_SIZE && stcp->outbytes < stcp->sndbuf)
+        nn_pipebase_sent (&stcp->pipebase);
+    else
+        stcp->outblocked = 1;
 
     return 0;
 }
@@ -145,15 +194,29 @@ static int nn_stcp_recv (struct nn_pipebase *self, struct nn_msg *msg)
     stcp = nn_cont (self, struct nn_stcp, pipebase);
 
     nn_assert (stcp->state == NN_STCP_STATE_ACTIVE);
-    nn_assert (stcp->instate == NN_STCP_INSTATE_HASMSG);
-
-    /*  Move received message to the user. */
-    nn_msg_mv (msg, &stcp->inmsg);
-    nn_msg_init (&stcp->inmsg, 0);
-
-    /*  Start receiving new message. */
-    stcp->instate = NN_STCP_INSTATE_HDR;
-    nn_usock_recv (stcp->usock, stcp->inhdr, sizeof (stcp->inhdr));
+    nn_assert (stcp->incount > 0);
+
+    /*  Move the oldest received message to the user. */
+    nn_msg_mv (msg, &stcp->inq [stcp->inhead]);
+    stcp->inhead = (stcp->inhead + 1) % NN_STCP_INQ_SIZE;
+    --stcp->incount;
+
+    /*  If receiving was suspended because the inbound queue was full,
+        resume it. */
+    if (stcp->instate == NN_STCP_INSTATE_HASMSG)
+        nn_stcp_recv_next (stcp);
+
+    /*  If there are more messages queued, the pipe remains readable. */
+    if (stcp->incount)
+        nn_pipebase_received (&stcp->pipebase);
+
+    /*  If the connection have failed while there were still messages in the
+        inbound queue and the last of them was passed to the user now, the
+        failure can be reported. The pipe can't be removed from the socket
+        while the socket is receiving from it, so it's done later on in
+        the handler. */
+    else if (nn_slow (stcp->instate == NN_STCP_INSTATE_CLOSED))
+        nn_fsm_raiseself (&stcp->fsm, &stcp->drained, NN_STCP_ACTION_DRAINED);
 
     return 0;
 }
@@ -162,10 +225,19 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
 {
     int rc;
     struct nn_stcp *stcp;
+    struct nn_stcp_outmsg *outmsg;
     uint64_t size;
+    size_t buffered;
+    const void *data;
 
     stcp = nn_cont (self, struct nn_stcp, fsm);
 
+    /*  The object may have been stopped before the event the inbound queue
+        was drained was processed. There's nothing left to report then. */
+    if (nn_slow (source == &stcp->fsm && type == NN_STCP_ACTION_DRAINED &&
+          stcp->state != NN_STCP_STATE_ACTIVE))
+        return;
+
 /******************************************************************************/
 /*  STOP procedure.                                                           */
 /******************************************************************************/
@@ -195,6 +267,13 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
         if (source == &stcp->fsm) {
             switch (type) {
             case NN_FSM_START:
+
+                /*  Drop any messages left over from the previous
+                    connection. */
+                nn_stcp_outq_clear (stcp);
+                nn_stcp_inq_clear (stcp);
+                stcp->instate = -1;
+
                 nn_streamhdr_start (&stcp->streamhdr, stcp->usock);
                 stcp->state = NN_STCP_STATE_PROTOHDR;
                 return;
@@ -244,10 +323,12 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
                  rc = nn_pipebase_start (&stcp->pipebase);
                  errnum_assert (rc == 0, -rc);
                  
-                 /*  Start receiving a message in asynchronous manner. */
-                 stcp->instate = NN_STCP_INSTATE_HDR;
-                 nn_usock_recv (stcp->usock, &stcp->inhdr,
-                     sizeof (stcp->inhdr));
+                 /*  Start receiving messages in asynchronous manner. Note
+                     that first messages may have been already read from
+                     the socket during the protocol header exchange. */
+                 nn_stcp_recv_next (stcp);
+                 if (stcp->incount)
+                     nn_pipebase_received (&stcp->pipebase);
 
                  /*  Mark the pipe as available for sending. */
                  stcp->outstate = NN_STCP_OUTSTATE_IDLE;
@@ -265,16 +346,49 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
 /*  ACTIVE state.                                                             */
 /******************************************************************************/
     case NN_STCP_STATE_ACTIVE:
+        if (source == &stcp->fsm) {
+            switch (type) {
+            case NN_STCP_ACTION_DRAINED:
+
+                /*  All the messages received before the connection failed
+                    were passed to the user. Report the failure now. */
+                nn_assert (stcp->instate == NN_STCP_INSTATE_CLOSED);
+                nn_pipebase_stop (&stcp->pipebase);
+                stcp->state = NN_STCP_STATE_DONE;
+                nn_fsm_raise (&stcp->fsm, &stcp->done, stcp, NN_STCP_ERROR);
+                return;
+
+            default:
+                nn_assert (0);
+            }
+        }
         if (source == stcp->usock) {
             switch (type) {
             case NN_USOCK_SENT:
 
-                /*  The message is now fully sent. */
+                /*  The batch is now fully sent. Drop the messages. */
                 nn_assert (stcp->outstate == NN_STCP_OUTSTATE_SENDING);
+                while (stcp->outsending) {
+                    outmsg = &stcp->outq [stcp->outhead];
+                    stcp->outbytes -= (size_t) nn_getll (outmsg->hdr);
+                    nn_msg_term (&outmsg->msg);
+                    stcp->outhead = (stcp->outhead + 1) % NN_STCP_OUTQ_SIZE;
+                    --stcp->outcount;
+                    --stcp->outsending;
+                }
                 stcp->outstate = NN_STCP_OUTSTATE_IDLE;
-                nn_msg_term (&stcp->outmsg);
-                nn_msg_init (&stcp->outmsg, 0);
-                nn_pipebase_sent (&stcp->pipebase);
+
+                /*  Send the messages that were queued in the meantime. */
+                if (stcp->outcount)
+                    nn_stcp_send_batch (stcp);
+
+                /*  If the pipe was blocked and there's room in the outbound
+                    queue now, let the user send more messages. */
+                if (stcp->outblocked && stcp->outcount < NN_STCP_OUTQ_SIZE &&
+                      stcp->outbytes < stcp->sndbuf) {
+                    stcp->outblocked = 0;
+                    nn_pipebase_sent (&stcp->pipebase);
+                }
                 return;
 
             case NN_USOCK_RECEIVED:
@@ -290,10 +404,19 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
 
                     /*  Special case when size of the message body is 0. */
                     if (!size) {
-                        nn_pipebase_received (&stcp->pipebase);
-                        nn_assert (0);
+                        nn_stcp_received (stcp);
+                        return;
                     }
 
+                    /*  The beginning of the body may have been read into
+                        the usock's batch buffer along with the header. That
+                        part has to be copied. The rest of the body will be
+                        read directly into the message. */
+                    buffered = nn_usock_buffered (stcp->usock, &data);
+                    if (buffered)
+                        nn_pipebase_copied (&stcp->pipebase,
+                            buffered < size ? buffered : (size_t) size);
+
                     /*  Start receiving the message body. */
                     stcp->instate = NN_STCP_INSTATE_BODY;
                     nn_usock_recv (stcp->usock,
@@ -303,11 +426,8 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
 
                 case NN_STCP_INSTATE_BODY:
 
-                    /*  Message body was received. Notify the owner that it
-                        can receive it. */
-                    stcp->instate = NN_STCP_INSTATE_HASMSG;
-                    nn_pipebase_received (&stcp->pipebase);
-
+                    /*  Message body was received. */
+                    nn_stcp_received (stcp);
                     return;
 
                 default:
@@ -315,6 +435,17 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
                 }
 
             case NN_USOCK_ERROR:
+
+                /*  Messages read before the connection failed are still
+                    delivered to the user. The failure is reported once
+                    the inbound queue is drained. Until then, the pipe
+                    accepts at most one more outbound message, which is
+                    dropped, and is never reported as writable again. */
+                if (stcp->incount) {
+                    stcp->instate = NN_STCP_INSTATE_CLOSED;
+                    return;
+                }
+
                 nn_pipebase_stop (&stcp->pipebase);
                 stcp->state = NN_STCP_STATE_DONE;
                 nn_fsm_raise (&stcp->fsm, &stcp->done, stcp, NN_STCP_ERROR);
@@ -342,3 +473,108 @@ static void nn_stcp_handler (struct nn_fsm *self, void *source, int type)
     }
 }
 
+static void nn_stcp_send_batch (struct nn_stcp *self)
+{
+    int i;
+    struct nn_stcp_outmsg *outmsg;
+    struct nn_iovec iov [NN_USOCK_MAX_IOVCNT];
+
+    nn_assert (self->outstate == NN_STCP_OUTSTATE_IDLE);
+    nn_assert (self->outcount > 0);
+
+    /*  Send all the queued messages using a single system call. */
+    for (i = 0; i != self->outcount; ++i) {
+        outmsg = &self->outq [(self->outhead + i) % NN_STCP_OUTQ_SIZE];
+        iov [i * 3].iov_base = outmsg->hdr;
+        iov [i * 3].iov_len = sizeof (outmsg->hdr);
+        iov [i * 3 + 1].iov_base = nn_chunkref_data (&outmsg->msg.hdr);
+        iov [i * 3 + 1].iov_len = nn_chunkref_size (&outmsg->msg.hdr);
+        iov [i * 3 + 2].iov_base = nn_chunkref_data (&outmsg->msg.body);
+        iov [i * 3 + 2].iov_len = nn_chunkref_size (&outmsg->msg.body);
+    }
+    self->outsending = self->outcount;
+    self->outstate = NN_STCP_OUTSTATE_SENDING;
+    nn_usock_send (self->usock, iov, self->outcount * 3);
+}
+
+static void nn_stcp_outq_clear (struct nn_stcp *self)
+{
+    while (self->outcount) {
+        nn_msg_term (&self->outq [self->outhead].msg);
+        self->outhead = (self->outhead + 1) % NN_STCP_OUTQ_SIZE;
+        --self->outcount;
+    }
+    self->outhead = 0;
+    self->outsending = 0;
+    self->outbytes = 0;
+    self->outblocked = 0;
+}
+
+static void nn_stcp_received (struct nn_stcp *self)
+{
+    int wasempty;
+
+    /*  Move the message to the inbound queue. */
+    nn_assert (self->incount < NN_STCP_INQ_SIZE);
+    wasempty = self->incount == 0 ? 1 : 0;
+    nn_msg_mv (&self->inq [(self->inhead + self->incount) % NN_STCP_INQ_SIZE],
+        &self->inmsg);
+    nn_msg_init (&self->inmsg, 0);
+    ++self->incount;
+
+    nn_stcp_recv_next (self);
+
+    /*  If the pipe wasn't readable so far, notify the owner that it
+        can receive messages now. */
+    if (wasempty)
+        nn_pipebase_received (&self->pipebase);
+}
+
+static void nn_stcp_recv_next (struct nn_stcp *self)
+{
+    size_t len;
+    const uint8_t *data;
+    uint64_t size;
+    struct nn_msg *msg;
+
+    /*  Frame all the complete messages that were already read from the socket.
+        That way there's no need to do a state machine transition for each
+        small message. */
+    while (self->incount < NN_STCP_INQ_SIZE) {
+        len = nn_usock_buffered (self->usock, (const void**) &data);
+        if (len < sizeof (self->inhdr))
+            break;
+        size = nn_getll (data);
+        if (size > len - sizeof (self->inhdr))
+            break;
+        msg = &self->inq [(self->inhead + self->incount) % NN_STCP_INQ_SIZE];
+        nn_msg_init (msg, (size_t) size);
+        memcpy (nn_chunkref_data (&msg->body), data + sizeof (self->inhdr),
+            (size_t) size);
+        nn_usock_consume (self->usock, sizeof (self->inhdr) + (size_t) size);
+        nn_pipebase_copied (&self->pipebase, (size_t) size);
+        ++self->incount;
+    }
+
+    /*  If the inbound queue is full, stop receiving till the user gets some
+        of the messages. */
+    if (self->incount == NN_STCP_INQ_SIZE) {
+        self->instate = NN_STCP_INSTATE_HASMSG;
+        return;
+    }
+
+    /*  Start receiving new message. */
+    self->instate = NN_STCP_INSTATE_HDR;
+    nn_usock_recv (self->usock, self->inhdr, sizeof (self->inhdr));
+}
+
+static void nn_stcp_inq_clear (struct nn_stcp *self)
+{
+    while (self->incount) {
+        nn_msg_term (&self->inq [self->inhead]);
+        self->inhead = (self->inhead + 1) % NN_STCP_INQ_SIZE;
+        --self->incount;
+    }
+    self->inhead = 0;
+}
+
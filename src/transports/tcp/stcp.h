@@ -38,6 +38,24 @@
 #define NN_STCP_ERROR 1
 #define NN_STCP_STOPPED 2
 
+/*  Maximum number of messages queued for sending. Each message needs three
+    iovecs (size, header and body) so that the whole queue can be sent using
+    a single nn_usock_send call. */
+#define NN_STCP_OUTQ_SIZE (NN_USOCK_MAX_IOVCNT / 3)
+
+/*  Maximum number of received messages queued for the user. */
+#define NN_STCP_INQ_SIZE 16
+
+/*  Message waiting in the outbound queue. */
+struct nn_stcp_outmsg {
+
+    /*  Serialised size of the message. */
+    uint8_t hdr [8];
+
+    /*  The message itself. */
+    struct nn_msg msg;
+};
+
 struct nn_stcp {
 
     /*  The state machine. */
@@ -65,17 +83,38 @@ struct nn_stcp {
     /*  Message being received at the moment. */
     struct nn_msg inmsg;
 
+    /*  Circular buffer of received messages not yet passed to the user.
+        'incount' messages starting at 'inhead' are queued. */
+    struct nn_msg inq [NN_STCP_INQ_SIZE];
+    int inhead;
+    int incount;
+
     /*  State of the outbound state machine. */
     int outstate;
 
-    /*  Buffer used to store the header of outgoing message. */
-    uint8_t outhdr [8];
+    /*  Circular buffer of outgoing messages. 'outcount' messages starting
+        at 'outhead' are queued. First 'outsending' of them are being sent
+        at the moment, the rest will be sent in the next batch. */
+    struct nn_stcp_outmsg outq [NN_STCP_OUTQ_SIZE];
+    int outhead;
+    int outcount;
+    int outsending;
 
-    /*  Message being sent at the moment. */
-    struct nn_msg outmsg;
+    /*  Number of bytes in the outbound queue and the limit for it, taken
+        from NN_SNDBUF socket option. */
+    size_t outbytes;
+    size_t sndbuf;
+
+    /*  1 if the pipe wasn't reported as writable because the outbound queue
+        is full. */
+    int outblocked;
 
     /*  Event raised when the state machine ends. */
     struct nn_fsm_event done;
+
+    /*  Event the state machine sends to itself once the messages received
+        before the connection failed were passed to the user. */
+    struct nn_fsm_event drained;
 };
 
 void nn_stcp_init (struct nn_stcp *self, struct nn_epbase *epbase,
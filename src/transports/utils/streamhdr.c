@@ -206,6 +206,12 @@ static void nn_streamhdr_handler (struct nn_fsm *self, void *source, int type)
 /*  STOPPING_TIMER_ERROR state.                                               */
 /******************************************************************************/
     case NN_STREAMHDR_STATE_STOPPING_TIMER_ERROR:
+
+        /*  The timer and the usock may be handled by different worker threads
+            and thus usock can report an error while the timer is still being
+            stopped. We are going to report an error anyway, so ignore it. */
+        if (source == streamhdr->usock)
+            return;
         if (source == &streamhdr->timer) {
             switch (type) {
             case NN_TIMER_STOPPED:
@@ -226,6 +232,18 @@ static void nn_streamhdr_handler (struct nn_fsm *self, void *source, int type)
 /*  STOPPING_TIMER_DONE state.                                                */
 /******************************************************************************/
     case NN_STREAMHDR_STATE_STOPPING_TIMER_DONE:
+
+        /*  Connection may break while the timer is being stopped. If so,
+            report the error rather than success. */
+        if (source == streamhdr->usock) {
+            switch (type) {
+            case NN_USOCK_ERROR:
+                streamhdr->state = NN_STREAMHDR_STATE_STOPPING_TIMER_ERROR;
+                return;
+            default:
+                nn_assert (0);
+            }
+        }
         if (source == &streamhdr->timer) {
             switch (type) {
             case NN_TIMER_STOPPED:
@@ -74,3 +74,130 @@ uint32_t nn_atomic_dec (struct nn_atomic *self, uint32_t n)
 #endif
 }
 
+uint32_t nn_atomic_get (struct nn_atomic *self)
+{
+#if defined NN_ATOMIC_WINAPI
+    uint32_t res;
+    res = self->n;
+    MemoryBarrier ();
+    return res;
+#elif defined NN_ATOMIC_GCC_BUILTINS
+#if defined __ATOMIC_ACQUIRE
+    return __atomic_load_n (&self->n, __ATOMIC_ACQUIRE);
+#else
+    uint32_t res;
+    res = self->n;
+    __sync_synchronize ();
+    return res;
+#endif
+#elif defined NN_ATOMIC_MUTEX
+    uint32_t res;
+    nn_mutex_lock (&self->sync);
+    res = self->n;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
+void nn_atomic_set (struct nn_atomic *self, uint32_t n)
+{
+#if defined NN_ATOMIC_WINAPI
+    MemoryBarrier ();
+    self->n = n;
+#elif defined NN_ATOMIC_GCC_BUILTINS
+#if defined __ATOMIC_RELEASE
+    __atomic_store_n (&self->n, n, __ATOMIC_RELEASE);
+#else
+    __sync_synchronize ();
+    self->n = n;
+#endif
+#elif defined NN_ATOMIC_MUTEX
+    nn_mutex_lock (&self->sync);
+    self->n = n;
+    nn_mutex_unlock (&self->sync);
+#else
+#error
+#endif
+}
+
+uint32_t nn_atomic_cas (struct nn_atomic *self, uint32_t cmp, uint32_t n)
+{
+#if defined NN_ATOMIC_WINAPI
+    return (uint32_t) InterlockedCompareExchange ((LONG*) &self->n,
+        (LONG) n, (LONG) cmp);
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    return __sync_val_compare_and_swap (&self->n, cmp, n);
+#elif defined NN_ATOMIC_MUTEX
+    uint32_t res;
+    nn_mutex_lock (&self->sync);
+    res = self->n;
+    if (res == cmp)
+        self->n = n;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
+void nn_atomic_ptr_init (struct nn_atomic_ptr *self, void *p)
+{
+    self->p = p;
+#if defined NN_ATOMIC_MUTEX
+    nn_mutex_init (&self->sync);
+#endif
+}
+
+void nn_atomic_ptr_term (struct nn_atomic_ptr *self)
+{
+#if defined NN_ATOMIC_MUTEX
+    nn_mutex_term (&self->sync);
+#endif
+}
+
+void *nn_atomic_ptr_swap (struct nn_atomic_ptr *self, void *p)
+{
+#if defined NN_ATOMIC_WINAPI
+    return InterlockedExchangePointer ((PVOID*) &self->p, p);
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    void *old;
+
+    /*  __sync_lock_test_and_set is only an acquire barrier. Use CAS loop to
+        get a full barrier. */
+    do {
+        old = self->p;
+    } while (!__sync_bool_compare_and_swap (&self->p, old, p));
+    return old;
+#elif defined NN_ATOMIC_MUTEX
+    void *res;
+    nn_mutex_lock (&self->sync);
+    res = self->p;
+    self->p = p;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
+void *nn_atomic_ptr_cas (struct nn_atomic_ptr *self, void *cmp, void *p)
+{
+#if defined NN_ATOMIC_WINAPI
+    return InterlockedCompareExchangePointer ((PVOID*) &self->p, p, cmp);
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    return __sync_val_compare_and_swap (&self->p, cmp, p);
+#elif defined NN_ATOMIC_MUTEX
+    void *res;
+    nn_mutex_lock (&self->sync);
+    res = self->p;
+    if (res == cmp)
+        self->p = p;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
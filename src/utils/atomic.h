@@ -54,5 +54,39 @@ uint32_t nn_atomic_inc (struct nn_atomic *self, uint32_t n);
 /*  Atomically subtract n from the object, return old value of the object. */
 uint32_t nn_atomic_dec (struct nn_atomic *self, uint32_t n);
 
+/*  Read the value of the object. Memory accesses following the call are not
+    reordered before it (acquire semantics). */
+uint32_t nn_atomic_get (struct nn_atomic *self);
+
+/*  Set the value of the object. Memory accesses preceding the call are not
+    reordered after it (release semantics). */
+void nn_atomic_set (struct nn_atomic *self, uint32_t n);
+
+/*  Atomically replace the value of the object by 'n' if it is equal to 'cmp'.
+    Return old value of the object. */
+uint32_t nn_atomic_cas (struct nn_atomic *self, uint32_t cmp, uint32_t n);
+
+/*  Pointer that can be manipulated atomically. */
+struct nn_atomic_ptr {
+#if defined NN_ATOMIC_MUTEX
+    struct nn_mutex sync;
+#endif
+    void *volatile p;
+};
+
+/*  Initialise the object. Set it to value 'p'. */
+void nn_atomic_ptr_init (struct nn_atomic_ptr *self, void *p);
+
+/*  Destroy the object. */
+void nn_atomic_ptr_term (struct nn_atomic_ptr *self);
+
+/*  Atomically replace the value of the object by 'p', return old value
+    of the object. */
+void *nn_atomic_ptr_swap (struct nn_atomic_ptr *self, void *p);
+
+/*  Atomically replace the value of the object by 'p' if it is equal to 'cmp'.
+    Return old value of the object. */
+void *nn_atomic_ptr_cas (struct nn_atomic_ptr *self, void *cmp, void *p);
+
 #endif
 
@@ -22,6 +22,7 @@
 
 #include "chunk.h"
 #include "atomic.h"
+#include "slab.h"
 #include "alloc.h"
 #include "fast.h"
 #include "wire.h"
@@ -32,6 +33,7 @@
 
 #define NN_CHUNK_TAG 0xdeadcafe
 #define NN_CHUNK_TAG_DEALLOCATED 0xbeadfeed
+#define NN_CHUNK_TAG_WRAPPED 0xdeadf00d
 
 typedef void (*nn_chunk_free_fn) (void *p);
 
@@ -51,20 +53,49 @@ struct nn_chunk {
         the message data itself. */
 };
 
+/*  In wrapped chunks, this structure is stored in place of the message data.
+    The actual data live in the user-supplied buffer. */
+struct nn_chunk_wrapped {
+
+    /*  The buffer as supplied by the user. */
+    void *buf;
+
+    /*  Beginning of the message data. It may differ from 'buf' once the chunk
+        is trimmed. */
+    uint8_t *data;
+
+    /*  User-supplied deallocation function and its argument. */
+    void (*ffn) (void *buf, void *hint);
+    void *hint;
+};
+
 /*  Private functions. */
 static struct nn_chunk *nn_chunk_getptr (void *p);
 static void nn_chunk_default_free (void *p);
+static void nn_chunk_wrapped_free (void *p);
 
 void *nn_chunk_alloc (size_t size, int type)
 {
     size_t sz;
     struct nn_chunk *self;
+    nn_chunk_free_fn ffn;
 
     /*  Allocate the actual memory depending on the type. */
     sz = sizeof (struct nn_chunk) + 2 * sizeof (uint32_t) + size;
     switch (type) {
-    case 0:
+    case NN_CHUNK_DEFAULT:
         self = nn_alloc (sz, "message chunk");
+        ffn = nn_chunk_default_free;
+        break;
+    case NN_CHUNK_POOLED:
+
+        /*  Large chunks are not pooled. Use the default allocator instead. */
+        self = nn_slab_alloc (sz);
+        ffn = nn_slab_free;
+        if (!self) {
+            self = nn_alloc (sz, "message chunk");
+            ffn = nn_chunk_default_free;
+        }
         break;
     default:
         return NULL;
@@ -74,7 +105,7 @@ void *nn_chunk_alloc (size_t size, int type)
     /*  Fill in the chunk header. */
     nn_atomic_init (&self->refcount, 1);
     self->size = size;
-    self->ffn = nn_chunk_default_free;
+    self->ffn = ffn;
 
     /*  Fill in the size of the empty space between the chunk header
         and the message. */
@@ -86,6 +117,48 @@ void *nn_chunk_alloc (size_t size, int type)
     return ((uint8_t*) (self + 1)) + 2 * sizeof (uint32_t);
 }
 
+void *nn_chunk_wrap (void *buf, size_t size,
+    void (*ffn) (void *buf, void *hint), void *hint)
+{
+    struct nn_chunk *self;
+    struct nn_chunk_wrapped *wrapped;
+
+    /*  Only the chunk header and the description of the user's buffer are
+        allocated. The message data itself are not copied. */
+    self = nn_alloc (sizeof (struct nn_chunk) + 2 * sizeof (uint32_t) +
+        sizeof (struct nn_chunk_wrapped), "wrapped chunk");
+    alloc_assert (self);
+
+    /*  Fill in the chunk header. */
+    nn_atomic_init (&self->refcount, 1);
+    self->size = size;
+    self->ffn = nn_chunk_wrapped_free;
+    nn_putl ((uint8_t*) ((uint32_t*) (self + 1)), 0);
+    nn_putl ((uint8_t*) ((((uint32_t*) (self + 1))) + 1), NN_CHUNK_TAG_WRAPPED);
+
+    /*  Store the information about the user's buffer. */
+    wrapped = (struct nn_chunk_wrapped*)
+        (((uint8_t*) (self + 1)) + 2 * sizeof (uint32_t));
+    wrapped->buf = buf;
+    wrapped->data = buf;
+    wrapped->ffn = ffn;
+    wrapped->hint = hint;
+
+    return wrapped;
+}
+
+int nn_chunk_iswrapped (void *p)
+{
+    return nn_getl ((uint8_t*) p - sizeof (uint32_t)) == NN_CHUNK_TAG_WRAPPED ?
+        1 : 0;
+}
+
+void *nn_chunk_data (void *p)
+{
+    return nn_chunk_iswrapped (p) ?
+        ((struct nn_chunk_wrapped*) p)->data : p;
+}
+
 void nn_chunk_free (void *p)
 {
     struct nn_chunk *self;
@@ -132,6 +205,13 @@ void *nn_chunk_trim (void *p, size_t n)
     /*  Sanity check. We cannot trim more bytes than there are in the chunk. */
     nn_assert (n >= 0 && n <= self->size);
 
+    /*  In wrapped chunks, only the pointer to the user's buffer is moved. */
+    if (nn_chunk_iswrapped (p)) {
+        ((struct nn_chunk_wrapped*) p)->data += n;
+        self->size -= n;
+        return p;
+    }
+
     /*  Adjust the chunk header. */
     p = ((uint8_t*) p) + n;
     nn_putl ((uint8_t*) (((uint32_t*) p) - 1), NN_CHUNK_TAG);
@@ -148,7 +228,8 @@ static struct nn_chunk *nn_chunk_getptr (void *p)
 {
     uint32_t off;
 
-    nn_assert (nn_getl ((uint8_t*) p - sizeof (uint32_t)) == NN_CHUNK_TAG);
+    nn_assert (nn_getl ((uint8_t*) p - sizeof (uint32_t)) == NN_CHUNK_TAG ||
+        nn_getl ((uint8_t*) p - sizeof (uint32_t)) == NN_CHUNK_TAG_WRAPPED);
     off = nn_getl ((uint8_t*) p - 2 * sizeof (uint32_t));
 
     return (struct  nn_chunk*) ((uint8_t*) p - 2 *sizeof (uint32_t) - off -
@@ -160,3 +241,15 @@ static void nn_chunk_default_free (void *p)
     nn_free (p);
 }
 
+static void nn_chunk_wrapped_free (void *p)
+{
+    struct nn_chunk_wrapped *wrapped;
+
+    /*  Let the user deallocate the buffer, then deallocate the header. */
+    wrapped = (struct nn_chunk_wrapped*)
+        (((uint8_t*) p) + sizeof (struct nn_chunk) + 2 * sizeof (uint32_t));
+    if (wrapped->ffn)
+        wrapped->ffn (wrapped->buf, wrapped->hint);
+    nn_free (p);
+}
+
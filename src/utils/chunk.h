@@ -25,9 +25,28 @@
 
 #include <stddef.h>
 
+/*  Chunk allocation mechanisms. Default one uses the system allocator.
+    Pooled one caches deallocated chunks in per-thread free lists. */
+#define NN_CHUNK_DEFAULT 0
+#define NN_CHUNK_POOLED 1
+
 /*  Allocates the chunk using the allocation mechanism specified by 'type'. */
 void *nn_chunk_alloc (size_t size, int type);
 
+/*  Wraps an existing buffer into a chunk. The buffer is not copied. Once
+    the reference count drops to zero 'ffn' is invoked with the buffer and
+    the 'hint' as arguments. Note that the returned chunk doesn't point to
+    the buffer itself, use nn_chunk_data to get the pointer to the data. */
+void *nn_chunk_wrap (void *buf, size_t size,
+    void (*ffn) (void *buf, void *hint), void *hint);
+
+/*  Returns 1 if the chunk was created by nn_chunk_wrap, 0 otherwise. */
+int nn_chunk_iswrapped (void *p);
+
+/*  Returns pointer to the data stored in the chunk. For chunks allocated by
+    nn_chunk_alloc it is the chunk pointer itself. */
+void *nn_chunk_data (void *p);
+
 /*  Releases a reference to the chunk and once the reference count had dropped
     to zero, deallocates the chunk. */
 void nn_chunk_free (void *p);
@@ -22,6 +22,7 @@
 
 #include "chunkref.h"
 #include "err.h"
+#include "fast.h"
 
 #include <string.h>
 
@@ -30,6 +31,10 @@
 struct nn_chunkref_chunk {
     uint8_t tag;
     void *chunk;
+
+    /*  Pointer to the message data. It's cached here so that the data of
+        wrapped chunks can be accessed without inspecting the chunk. */
+    void *data;
 };
 
 /*  Check whether VSM are small enough for size to fit into the first byte
@@ -50,8 +55,9 @@ void nn_chunkref_init (struct nn_chunkref *self, size_t size)
 
     ch = (struct nn_chunkref_chunk*) self;
     ch->tag = 0xff;
-    ch->chunk = nn_chunk_alloc (size, 0);
+    ch->chunk = nn_chunk_alloc (size, NN_CHUNK_POOLED);
     alloc_assert (ch->chunk);
+    ch->data = ch->chunk;
 }
 
 void nn_chunkref_init_chunk (struct nn_chunkref *self, void *chunk)
@@ -61,6 +67,7 @@ void nn_chunkref_init_chunk (struct nn_chunkref *self, void *chunk)
     ch = (struct nn_chunkref_chunk*) self;
     ch->tag = 0xff;
     ch->chunk = chunk;
+    ch->data = nn_chunk_data (chunk);
 }
 
 void nn_chunkref_term (struct nn_chunkref *self)
@@ -81,10 +88,23 @@ void *nn_chunkref_getchunk (struct nn_chunkref *self)
     if (self->ref [0] == 0xff) {
         ch = (struct nn_chunkref_chunk*) self;
         self->ref [0] = 0;
+
+        /*  The user expects to find the data at the address of the chunk.
+            That's not the case with wrapped chunks so the data have to be
+            copied to a new chunk. */
+        if (nn_slow (ch->data != ch->chunk)) {
+            chunk = nn_chunk_alloc (nn_chunk_size (ch->chunk),
+                NN_CHUNK_POOLED);
+            alloc_assert (chunk);
+            memcpy (chunk, ch->data, nn_chunk_size (ch->chunk));
+            nn_chunk_free (ch->chunk);
+            return chunk;
+        }
+
         return ch->chunk;
     }
 
-    chunk = nn_chunk_alloc (self->ref [0], 0);
+    chunk = nn_chunk_alloc (self->ref [0], NN_CHUNK_POOLED);
     alloc_assert (chunk);
     memcpy (chunk, &self->ref [1], self->ref [0]);
     self->ref [0] = 0;
@@ -111,7 +131,7 @@ void nn_chunkref_cp (struct nn_chunkref *dst, struct nn_chunkref *src)
 void *nn_chunkref_data (struct nn_chunkref *self)
 {
     return self->ref [0] == 0xff ?
-        ((struct nn_chunkref_chunk*) self)->chunk :
+        ((struct nn_chunkref_chunk*) self)->data :
         &self->ref [1];
 }
 
@@ -129,6 +149,7 @@ void nn_chunkref_trim (struct nn_chunkref *self, size_t n)
     if (self->ref [0] == 0xff) {
         ch = (struct nn_chunkref_chunk*) self;
         ch->chunk = nn_chunk_trim (ch->chunk, n);
+        ch->data = nn_chunk_data (ch->chunk);
         return;
     }
 
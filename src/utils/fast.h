@@ -26,9 +26,21 @@
 #if defined __GNUC__ || defined __llvm__
 #define nn_fast(x) __builtin_expect ((x), 1)
 #define nn_slow(x) __builtin_expect ((x), 0)
+#define nn_prefetch(x) __builtin_prefetch (x)
 #else
 #define nn_fast(x) (x)
 #define nn_slow(x) (x)
+#define nn_prefetch(x) ((void) 0)
+#endif
+
+/*  Hint to the CPU that the thread is busy-waiting. */
+#if (defined _MSC_VER && (defined _M_IX86 || defined _M_X64))
+#include <intrin.h>
+#define nn_relax() _mm_pause ()
+#elif (defined __GNUC__ && (defined __i386__ || defined __x86_64__))
+#define nn_relax() __asm__ volatile ("pause")
+#else
+#define nn_relax() ((void) 0)
 #endif
 
 #endif
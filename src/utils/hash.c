@@ -23,117 +23,232 @@
 #include "hash.h"
 #include "fast.h"
 #include "alloc.h"
-#include "cont.h"
 #include "err.h"
 
+#include <string.h>
+
 #define NN_HASH_INITIAL_SLOTS 32
 
+/*  Number of slots of the old array to process on each insertion while the
+    table is being resized. The table grows when it's half full, so the old
+    array is guaranteed to be emptied well before the new one gets full.
+    The step is large enough for the resize to finish quickly, as the lookups
+    are slower while it's in progress. */
+#define NN_HASH_MIGRATE_STEP 32
+
 static uint32_t nn_hash_key (uint32_t key);
+static struct nn_hash_slot *nn_hash_alloc (uint32_t slots);
+static void nn_hash_put (struct nn_hash_slot *array, uint32_t slots,
+    uint32_t key, uint32_t hash, struct nn_hash_item *item);
+static int nn_hash_find (struct nn_hash_slot *array, uint32_t slots,
+    uint32_t key, uint32_t hash);
+static void nn_hash_remove (struct nn_hash_slot *array, uint32_t slots,
+    uint32_t pos);
+static void nn_hash_migrate (struct nn_hash *self, int steps);
 
 void nn_hash_init (struct nn_hash *self)
 {
-    uint32_t i;
-
     self->slots = NN_HASH_INITIAL_SLOTS;
+    self->array = nn_hash_alloc (NN_HASH_INITIAL_SLOTS);
+    self->oldslots = 0;
+    self->oldarray = NULL;
+    self->migrated = 0;
     self->items = 0;
-    self->array = nn_alloc (sizeof (struct nn_list) * NN_HASH_INITIAL_SLOTS,
-        "hash map");
-    alloc_assert (self->array);
-    for (i = 0; i != NN_HASH_INITIAL_SLOTS; ++i)
-        nn_list_init (&self->array [i]);
 }
 
 void nn_hash_term (struct nn_hash *self)
 {
-    uint32_t i;
-
-    for (i = 0; i != self->slots; ++i)
-        nn_list_term (&self->array [i]);
+    if (self->oldarray)
+        nn_free (self->oldarray);
     nn_free (self->array);
 }
 
 void nn_hash_insert (struct nn_hash *self, uint32_t key,
     struct nn_hash_item *item)
 {
-    struct nn_list_item *it;
-    uint32_t i;
-    uint32_t oldslots;
-    struct nn_list *oldarray;
-    struct nn_hash_item *hitm;
-    uint32_t newslot;
-
-    i = nn_hash_key (key) % self->slots;
+    nn_assert (!nn_hash_get (self, key));
 
-    for (it = nn_list_begin (&self->array [i]);
-          it != nn_list_end (&self->array [i]);
-          it = nn_list_next (&self->array [i], it))
-        nn_assert (nn_cont (it, struct nn_hash_item, list)->key != key);
+    /*  If the hash is getting full, start moving the items to a new
+        double-sized array of slots. If the previous resize haven't finished
+        yet, which can't happen unless the items are erased and inserted
+        in a pathological pattern, finish it first. */
+    if (nn_slow ((self->items + 1) * 2 > self->slots &&
+          self->slots < 0x80000000)) {
+        nn_hash_migrate (self, -1);
+        self->oldslots = self->slots;
+        self->oldarray = self->array;
+        self->migrated = 0;
+        self->slots *= 2;
+        self->array = nn_hash_alloc (self->slots);
+    }
 
     item->key = key;
-    nn_list_insert (&self->array [i], &item->list,
-        nn_list_end (&self->array [i]));
+    nn_hash_put (self->array, self->slots, key, nn_hash_key (key), item);
     ++self->items;
 
-    /*  If the hash is getting full, double the amount of slots and
-        re-hash all the items. */
-    if (nn_slow (self->items * 2 > self->slots && self->slots < 0x80000000)) {
-
-        /*  Allocate new double-sized array of slots. */
-        oldslots = self->slots;
-        oldarray = self->array;
-        self->slots *= 2;
-        self->array = nn_alloc (sizeof (struct nn_list) * self->slots,
-            "hash map");
-        alloc_assert (self->array);
-        for (i = 0; i != self->slots; ++i)
-            nn_list_init (&self->array [i]);
-
-        /*  Move the items from old slot array to new slot array. */
-        for (i = 0; i != oldslots; ++i) {
-            while (!nn_list_empty (&oldarray [i])) {
-                hitm = nn_cont (nn_list_begin (&oldarray [i]),
-                     struct nn_hash_item, list);
-                nn_list_erase (&oldarray [i], &hitm->list);
-                newslot = nn_hash_key (hitm->key) % self->slots;
-                nn_list_insert (&self->array [newslot], &hitm->list,
-                    nn_list_end (&self->array [newslot]));
-            }
-
-            nn_list_term (&oldarray [i]);
-        }
-
-        /*  Deallocate the old array of slots. */
-        nn_free (oldarray);
-    }
+    if (nn_slow (self->oldarray != NULL))
+        nn_hash_migrate (self, NN_HASH_MIGRATE_STEP);
 }
 
 void nn_hash_erase (struct nn_hash *self, struct nn_hash_item *item)
 {
-    uint32_t slot;
+    int pos;
+    uint32_t hash;
 
-    slot = nn_hash_key (item->key) % self->slots;
-    nn_list_erase (&self->array [slot], &item->list);
+    hash = nn_hash_key (item->key);
+    pos = nn_hash_find (self->array, self->slots, item->key, hash);
+    if (pos >= 0)
+        nn_hash_remove (self->array, self->slots, pos);
+    else {
+        nn_assert (self->oldarray);
+        pos = nn_hash_find (self->oldarray, self->oldslots, item->key, hash);
+        nn_assert (pos >= 0);
+        nn_hash_remove (self->oldarray, self->oldslots, pos);
+    }
+    --self->items;
 }
 
 struct nn_hash_item *nn_hash_get (struct nn_hash *self, uint32_t key)
 {
-    uint32_t slot;
-    struct nn_list_item *it;
-    struct nn_hash_item *item;
-
-    slot = nn_hash_key (key) % self->slots;
-
-    for (it = nn_list_begin (&self->array [slot]);
-          it != nn_list_end (&self->array [slot]);
-          it = nn_list_next (&self->array [slot], it)) {
-        item = nn_cont (it, struct nn_hash_item, list);
-        if (item->key == key)
-            return item;
+    int pos;
+    uint32_t hash;
+
+    hash = nn_hash_key (key);
+
+    /*  While resizing, if the home slot of the key in the old array was not
+        processed yet, the item is most likely still there. */
+    if (nn_slow (self->oldarray != NULL &&
+          (hash & (self->oldslots - 1)) >= self->migrated)) {
+        pos = nn_hash_find (self->oldarray, self->oldslots, key, hash);
+        if (pos >= 0)
+            return self->oldarray [pos].item;
+        pos = nn_hash_find (self->array, self->slots, key, hash);
+        return pos >= 0 ? self->array [pos].item : NULL;
     }
 
+    pos = nn_hash_find (self->array, self->slots, key, hash);
+    if (nn_fast (pos >= 0))
+        return self->array [pos].item;
+    if (nn_slow (self->oldarray != NULL)) {
+        pos = nn_hash_find (self->oldarray, self->oldslots, key, hash);
+        if (pos >= 0)
+            return self->oldarray [pos].item;
+    }
     return NULL;
 }
 
+struct nn_hash_slot *nn_hash_alloc (uint32_t slots)
+{
+    struct nn_hash_slot *array;
+
+    array = nn_alloc (sizeof (struct nn_hash_slot) * slots, "hash map");
+    alloc_assert (array);
+    memset (array, 0, sizeof (struct nn_hash_slot) * slots);
+    return array;
+}
+
+void nn_hash_put (struct nn_hash_slot *array, uint32_t slots,
+    uint32_t key, uint32_t hash, struct nn_hash_item *item)
+{
+    uint32_t pos;
+    uint32_t dist;
+    uint32_t sdist;
+    struct nn_hash_slot tmp;
+
+    /*  Walk from the home slot till an empty slot is found. If an item that
+        is closer to its home slot than the one being inserted is encountered
+        on the way, put the new item there and continue with the displaced
+        one. That keeps the probe sequences short and of similar length. */
+    pos = hash & (slots - 1);
+    dist = 0;
+    while (1) {
+        if (!array [pos].item) {
+            array [pos].key = key;
+            array [pos].hash = hash;
+            array [pos].item = item;
+            return;
+        }
+        sdist = (pos - array [pos].hash) & (slots - 1);
+        if (sdist < dist) {
+            tmp = array [pos];
+            array [pos].key = key;
+            array [pos].hash = hash;
+            array [pos].item = item;
+            key = tmp.key;
+            hash = tmp.hash;
+            item = tmp.item;
+            dist = sdist;
+        }
+        pos = (pos + 1) & (slots - 1);
+        ++dist;
+    }
+}
+
+int nn_hash_find (struct nn_hash_slot *array, uint32_t slots,
+    uint32_t key, uint32_t hash)
+{
+    /*  Returns the index of the slot containing the key or -1 if there's
+        no such key in the array. */
+
+    uint32_t pos;
+    uint32_t dist;
+
+    pos = hash & (slots - 1);
+    for (dist = 0; ; ++dist) {
+
+        /*  Given the way the items are inserted, the item can't be farther
+            from its home slot than the item stored in the slot. */
+        if (!array [pos].item ||
+              ((pos - array [pos].hash) & (slots - 1)) < dist)
+            return -1;
+        if (array [pos].key == key)
+            return (int) pos;
+        pos = (pos + 1) & (slots - 1);
+    }
+}
+
+void nn_hash_remove (struct nn_hash_slot *array, uint32_t slots, uint32_t pos)
+{
+    uint32_t next;
+
+    /*  Shift the following items that are not in their home slots one
+        position back. */
+    next = (pos + 1) & (slots - 1);
+    while (array [next].item &&
+          ((next - array [next].hash) & (slots - 1)) != 0) {
+        array [pos] = array [next];
+        pos = next;
+        next = (next + 1) & (slots - 1);
+    }
+    array [pos].item = NULL;
+}
+
+void nn_hash_migrate (struct nn_hash *self, int steps)
+{
+    /*  Moves the items from the old array to the new one. Each step either
+        moves a single item or skips an empty slot. If 'steps' is negative,
+        the whole array is processed. Removing an item shifts the following
+        ones back, but never to the slots that were already processed as
+        they are all empty. */
+
+    struct nn_hash_slot *slot;
+
+    while (self->oldarray && steps--) {
+        slot = &self->oldarray [self->migrated];
+        if (slot->item) {
+            nn_hash_put (self->array, self->slots, slot->key, slot->hash,
+                slot->item);
+            nn_hash_remove (self->oldarray, self->oldslots, self->migrated);
+            continue;
+        }
+        if (++self->migrated == self->oldslots) {
+            nn_free (self->oldarray);
+            self->oldarray = NULL;
+            self->oldslots = 0;
+        }
+    }
+}
+
 uint32_t nn_hash_key (uint32_t key)
 {
     /*  TODO: This is a randomly chosen hashing function. Give some thought
@@ -149,11 +264,10 @@ uint32_t nn_hash_key (uint32_t key)
 
 void nn_hash_item_init (struct nn_hash_item *self)
 {
-    nn_list_item_init (&self->list);
+    self->key = 0xffff;
 }
 
 void nn_hash_item_term (struct nn_hash_item *self)
 {
-    nn_list_item_term (&self->list);
 }
 
@@ -26,20 +26,41 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#include "list.h"
-
 /*  Use for initialising a hash item statically. */
-#define NN_HASH_ITEM_INITIALIZER {0xffff, NN_LIST_ITEM_INITILIZER}
+#define NN_HASH_ITEM_INITIALIZER {0xffff}
 
 struct nn_hash_item {
     uint32_t key;
-    struct nn_list_item list;
+};
+
+/*  The hash table uses open addressing with linear probing and Robin Hood
+    insertion. Slots store the key and its hash next to the item pointer
+    so that the probing doesn't have to touch the items themselves. */
+struct nn_hash_slot {
+    uint32_t key;
+    uint32_t hash;
+
+    /*  NULL if the slot is empty. */
+    struct nn_hash_item *item;
 };
 
 struct nn_hash {
+
+    /*  Array of slots. The number of slots is always a power of two. */
     uint32_t slots;
+    struct nn_hash_slot *array;
+
+    /*  When the table grows, the items are not re-hashed all at once.
+        Instead, the old array is kept and a few of its slots are moved to
+        the new array on each insertion. 'migrated' is the number of slots
+        at the beginning of the old array that are already empty. NULL if
+        there's no resize in progress. */
+    uint32_t oldslots;
+    struct nn_hash_slot *oldarray;
+    uint32_t migrated;
+
+    /*  Number of items in both arrays. */
     uint32_t items;
-    struct nn_list *array;
 };
 
 /*  Initialise the hash table. */
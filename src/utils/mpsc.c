@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include <stddef.h>
+
+#include "mpsc.h"
+#include "err.h"
+
+void nn_mpsc_init (struct nn_mpsc *self)
+{
+    nn_atomic_ptr_init (&self->head, NULL);
+}
+
+void nn_mpsc_term (struct nn_mpsc *self)
+{
+    nn_atomic_ptr_term (&self->head);
+}
+
+int nn_mpsc_push (struct nn_mpsc *self, struct nn_queue_item *item)
+{
+    struct nn_queue_item *head;
+    struct nn_queue_item *old;
+
+    nn_assert (item->next == NN_QUEUE_NOTINQUEUE);
+
+    /*  Link the item to the top of the stack. Note that once the item is
+        in the stack the consumer may grab it and modify 'item->next' so
+        it must not be accessed afterwards. */
+    head = self->head.p;
+    while (1) {
+        item->next = head;
+        old = nn_atomic_ptr_cas (&self->head, head, item);
+        if (old == head)
+            break;
+        head = old;
+    }
+
+    return head ? 0 : 1;
+}
+
+void nn_mpsc_grab (struct nn_mpsc *self, struct nn_queue *queue)
+{
+    struct nn_queue_item *item;
+    struct nn_queue_item *prev;
+    struct nn_queue_item *next;
+
+    /*  Avoid the atomic operation if the stack is empty. An item pushed
+        in the meantime will be grabbed next time. */
+    if (!self->head.p)
+        return;
+
+    /*  Take the whole stack. */
+    item = nn_atomic_ptr_swap (&self->head, NULL);
+
+    /*  The stack is ordered from the newest item to the oldest one.
+        Reverse it. */
+    prev = NULL;
+    while (item) {
+        next = item->next;
+        item->next = prev;
+        prev = item;
+        item = next;
+    }
+
+    /*  Move the items to the queue. */
+    while (prev) {
+        next = prev->next;
+        prev->next = NN_QUEUE_NOTINQUEUE;
+        nn_queue_push (queue, prev);
+        prev = next;
+    }
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_MPSC_INCLUDED
+#define NN_MPSC_INCLUDED
+
+#include "atomic.h"
+#include "queue.h"
+
+/*  Lock-free queue with multiple producers and a single consumer. Producers
+    push the items to a lock-free stack. The consumer grabs the whole stack
+    at once and restores the original order of the items. The items are the
+    same as used by nn_queue, so the grabbed items can be processed using
+    a local nn_queue object. */
+
+struct nn_mpsc {
+
+    /*  The most recently pushed item. NULL if the queue is empty. */
+    struct nn_atomic_ptr head;
+};
+
+/*  Initialise the queue. */
+void nn_mpsc_init (struct nn_mpsc *self);
+
+/*  Terminate the queue. Note that queue must be manually emptied before the
+    termination. */
+void nn_mpsc_term (struct nn_mpsc *self);
+
+/*  Inserts one element into the queue. Can be called from any thread.
+    Returns 1 if the queue was empty beforehand, 0 otherwise. */
+int nn_mpsc_push (struct nn_mpsc *self, struct nn_queue_item *item);
+
+/*  Removes all the elements from the queue and appends them to 'queue' in
+    the order they were pushed. Only one thread may call this function. */
+void nn_mpsc_grab (struct nn_mpsc *self, struct nn_queue *queue);
+
+#endif
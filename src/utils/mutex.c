@@ -40,6 +40,11 @@ void nn_mutex_lock (struct nn_mutex *self)
     EnterCriticalSection (&self->mutex);
 }
 
+int nn_mutex_trylock (struct nn_mutex *self)
+{
+    return TryEnterCriticalSection (&self->mutex) ? 1 : 0;
+}
+
 void nn_mutex_unlock (struct nn_mutex *self)
 {
     LeaveCriticalSection (&self->mutex);
@@ -71,6 +76,17 @@ void nn_mutex_lock (struct nn_mutex *self)
     errnum_assert (rc == 0, rc);
 }
 
+int nn_mutex_trylock (struct nn_mutex *self)
+{
+    int rc;
+
+    rc = pthread_mutex_trylock (&self->mutex);
+    if (rc == EBUSY)
+        return 0;
+    errnum_assert (rc == 0, rc);
+    return 1;
+}
+
 void nn_mutex_unlock (struct nn_mutex *self)
 {
     int rc;
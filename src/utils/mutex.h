@@ -47,6 +47,10 @@ void nn_mutex_term (struct nn_mutex *self);
     undefined. */
 void nn_mutex_lock (struct nn_mutex *self);
 
+/*  Try to lock the mutex without blocking. Returns 1 if the mutex was locked,
+    0 if it is held by someone else at the moment. */
+int nn_mutex_trylock (struct nn_mutex *self);
+
 /*  Unlock the mutex. Behaviour of unlocking an unlocked mutex is undefined */
 void nn_mutex_unlock (struct nn_mutex *self);
 
@@ -0,0 +1,338 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+
+#include "slab.h"
+#include "atomic.h"
+#include "alloc.h"
+#include "glock.h"
+#include "mutex.h"
+#include "fast.h"
+#include "err.h"
+
+#if defined NN_HAVE_WINDOWS
+#include "win.h"
+#else
+#include <pthread.h>
+#endif
+
+/*  Size classes are powers of two ranging from 2^NN_SLAB_MIN_SHIFT to
+    2^NN_SLAB_MAX_SHIFT bytes. The sizes include the block header. */
+#define NN_SLAB_MIN_SHIFT 6
+#define NN_SLAB_MAX_SHIFT 16
+#define NN_SLAB_CLASSES (NN_SLAB_MAX_SHIFT - NN_SLAB_MIN_SHIFT + 1)
+
+/*  Maximum number of bytes cached by a single thread in each size class.
+    Blocks freed when the cache is full are returned to the system. */
+#define NN_SLAB_CACHE_BYTES ((size_t) 128 * 1024)
+
+struct nn_slab_cache;
+
+struct nn_slab_block {
+
+    /*  The cache the block belongs to. */
+    struct nn_slab_cache *cache;
+
+    /*  Next block in the free list. */
+    struct nn_slab_block *next;
+
+    /*  Size class of the block. Size_t is used to keep the data that follow
+        the header properly aligned. */
+    size_t sizeclass;
+};
+
+struct nn_slab_class {
+
+    /*  List of free blocks. Accessed only by the owner thread. */
+    struct nn_slab_block *free;
+    size_t count;
+
+    /*  List of blocks freed by other threads. The owner thread grabs the whole
+        list at once when it runs out of free blocks. If the list grows past
+        the cache limit, the freeing thread returns it to the system instead.
+        'nremote' is an approximate count of blocks in the list. */
+    struct nn_atomic_ptr remote;
+    struct nn_atomic nremote;
+};
+
+struct nn_slab_cache {
+
+    /*  Free blocks, one list per size class. */
+    struct nn_slab_class classes [NN_SLAB_CLASSES];
+
+    /*  When the owner thread exits, the cache is put into the list of orphaned
+        caches to be adopted by a new thread. It can't be deallocated as
+        blocks allocated from it may still exist. */
+    struct nn_slab_cache *next;
+};
+
+/*  List of caches not owned by any thread. The global lock can't be used
+    to guard it as messages are allocated while the global lock is held. */
+static struct nn_mutex nn_slab_sync;
+static struct nn_slab_cache *nn_slab_orphans = NULL;
+
+/*  Thread-local storage for the pointer to the thread's own cache. */
+#if defined NN_HAVE_WINDOWS
+static volatile LONG nn_slab_initialised = 0;
+static DWORD nn_slab_key;
+static VOID WINAPI nn_slab_fls_orphan (PVOID arg);
+#else
+static pthread_once_t nn_slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t nn_slab_key;
+#endif
+
+/*  Private functions. */
+static void nn_slab_init (void);
+#if !defined NN_HAVE_WINDOWS
+static void nn_slab_init_once (void);
+#endif
+static struct nn_slab_cache *nn_slab_getcache (void);
+static struct nn_slab_cache *nn_slab_mkcache (void);
+static void nn_slab_orphan (void *arg);
+static void nn_slab_drain (struct nn_slab_class *self, size_t limit);
+static size_t nn_slab_limit (size_t sizeclass);
+
+void *nn_slab_alloc (size_t size)
+{
+    size_t sizeclass;
+    struct nn_slab_cache *cache;
+    struct nn_slab_class *cls;
+    struct nn_slab_block *block;
+
+    /*  Find the smallest size class the block fits in. */
+    size += sizeof (struct nn_slab_block);
+    if (nn_slow (size > ((size_t) 1 << NN_SLAB_MAX_SHIFT)))
+        return NULL;
+    sizeclass = 0;
+    while (((size_t) 1 << (sizeclass + NN_SLAB_MIN_SHIFT)) < size)
+        ++sizeclass;
+
+    /*  Get the cache of this thread. */
+    nn_slab_init ();
+    cache = nn_slab_getcache ();
+    if (nn_slow (!cache)) {
+        cache = nn_slab_mkcache ();
+        if (nn_slow (!cache))
+            return NULL;
+    }
+
+    /*  If there are no free blocks, try to get the blocks freed by other
+        threads. */
+    cls = &cache->classes [sizeclass];
+    if (nn_slow (!cls->free))
+        nn_slab_drain (cls, nn_slab_limit (sizeclass));
+
+    /*  Use a free block if available. Allocate a new one otherwise. */
+    block = cls->free;
+    if (nn_fast (block != NULL)) {
+        cls->free = block->next;
+        --cls->count;
+    }
+    else {
+        block = nn_alloc ((size_t) 1 << (sizeclass + NN_SLAB_MIN_SHIFT),
+            "slab block");
+        if (nn_slow (!block))
+            return NULL;
+        block->cache = cache;
+        block->sizeclass = sizeclass;
+    }
+
+    return block + 1;
+}
+
+void nn_slab_free (void *p)
+{
+    struct nn_slab_block *block;
+    struct nn_slab_class *cls;
+    struct nn_slab_block *head;
+    struct nn_slab_block *old;
+
+    block = ((struct nn_slab_block*) p) - 1;
+    cls = &block->cache->classes [block->sizeclass];
+
+    /*  If the block belongs to this thread, put it into the free list unless
+        there are already enough free blocks cached. */
+    if (nn_fast (block->cache == nn_slab_getcache ())) {
+        if (nn_slow (cls->count >= nn_slab_limit (block->sizeclass))) {
+            nn_free (block);
+            return;
+        }
+        block->next = cls->free;
+        cls->free = block;
+        ++cls->count;
+        return;
+    }
+
+    /*  The block belongs to a different thread. Push it to the owner's list
+        of remotely freed blocks. */
+    head = cls->remote.p;
+    while (1) {
+        block->next = head;
+        old = nn_atomic_ptr_cas (&cls->remote, head, block);
+        if (nn_fast (old == head))
+            break;
+        head = old;
+    }
+
+    /*  If the owner doesn't allocate from this size class any more, the list
+        would grow without bounds. Once it holds more blocks than the owner
+        would cache, return the whole list to the system. */
+    if (nn_slow (nn_atomic_inc (&cls->nremote, 1) >=
+          nn_slab_limit (block->sizeclass)))
+        nn_slab_drain (cls, 0);
+}
+
+static void nn_slab_init (void)
+{
+#if defined NN_HAVE_WINDOWS
+    if (nn_fast (nn_slab_initialised))
+        return;
+    nn_glock_lock ();
+    if (!nn_slab_initialised) {
+        /*  Fiber-local storage is used rather than TLS as, unlike TLS, it
+            invokes a callback when the thread exits. */
+        nn_slab_key = FlsAlloc (nn_slab_fls_orphan);
+        win_assert (nn_slab_key != FLS_OUT_OF_INDEXES);
+        nn_mutex_init (&nn_slab_sync);
+        nn_slab_initialised = 1;
+    }
+    nn_glock_unlock ();
+#else
+    int rc;
+
+    rc = pthread_once (&nn_slab_once, nn_slab_init_once);
+    errnum_assert (rc == 0, rc);
+#endif
+}
+
+#if !defined NN_HAVE_WINDOWS
+static void nn_slab_init_once (void)
+{
+    int rc;
+
+    nn_mutex_init (&nn_slab_sync);
+
+    /*  When a thread exits, its cache is passed to nn_slab_orphan. */
+    rc = pthread_key_create (&nn_slab_key, nn_slab_orphan);
+    errnum_assert (rc == 0, rc);
+}
+#endif
+
+static struct nn_slab_cache *nn_slab_getcache (void)
+{
+#if defined NN_HAVE_WINDOWS
+    return (struct nn_slab_cache*) FlsGetValue (nn_slab_key);
+#else
+    return (struct nn_slab_cache*) pthread_getspecific (nn_slab_key);
+#endif
+}
+
+static struct nn_slab_cache *nn_slab_mkcache (void)
+{
+    int i;
+    struct nn_slab_cache *cache;
+#if !defined NN_HAVE_WINDOWS
+    int rc;
+#endif
+
+    /*  Adopt a cache left behind by an exited thread, if any. */
+    nn_mutex_lock (&nn_slab_sync);
+    cache = nn_slab_orphans;
+    if (cache)
+        nn_slab_orphans = cache->next;
+    nn_mutex_unlock (&nn_slab_sync);
+
+    /*  Otherwise, create a new one. */
+    if (!cache) {
+        cache = nn_alloc (sizeof (struct nn_slab_cache), "slab cache");
+        if (nn_slow (!cache))
+            return NULL;
+        for (i = 0; i != NN_SLAB_CLASSES; ++i) {
+            cache->classes [i].free = NULL;
+            cache->classes [i].count = 0;
+            nn_atomic_ptr_init (&cache->classes [i].remote, NULL);
+            nn_atomic_init (&cache->classes [i].nremote, 0);
+        }
+    }
+    cache->next = NULL;
+
+#if defined NN_HAVE_WINDOWS
+    win_assert (FlsSetValue (nn_slab_key, cache));
+#else
+    rc = pthread_setspecific (nn_slab_key, cache);
+    errnum_assert (rc == 0, rc);
+#endif
+
+    return cache;
+}
+
+static void nn_slab_orphan (void *arg)
+{
+    struct nn_slab_cache *cache;
+
+    cache = (struct nn_slab_cache*) arg;
+    nn_mutex_lock (&nn_slab_sync);
+    cache->next = nn_slab_orphans;
+    nn_slab_orphans = cache;
+    nn_mutex_unlock (&nn_slab_sync);
+}
+
+#if defined NN_HAVE_WINDOWS
+static VOID WINAPI nn_slab_fls_orphan (PVOID arg)
+{
+    if (arg)
+        nn_slab_orphan (arg);
+}
+#endif
+
+static size_t nn_slab_limit (size_t sizeclass)
+{
+    return NN_SLAB_CACHE_BYTES >> (sizeclass + NN_SLAB_MIN_SHIFT);
+}
+
+/*  Takes the list of remotely freed blocks and moves up to 'limit' blocks
+    into the free list. The rest is returned to the system. With zero limit
+    this can be called from any thread, as it doesn't touch the free list. */
+static void nn_slab_drain (struct nn_slab_class *self, size_t limit)
+{
+    struct nn_slab_block *block;
+    struct nn_slab_block *next;
+    uint32_t taken;
+
+    block = nn_atomic_ptr_swap (&self->remote, NULL);
+    taken = 0;
+    while (block) {
+        next = block->next;
+        ++taken;
+        if (self->count < limit) {
+            block->next = self->free;
+            self->free = block;
+            ++self->count;
+        }
+        else
+            nn_free (block);
+        block = next;
+    }
+    if (taken)
+        nn_atomic_dec (&self->nremote, taken);
+}
+
@@ -0,0 +1,44 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+
+#ifndef NN_SLAB_INCLUDED
+#define NN_SLAB_INCLUDED
+
+#include <stddef.h>
+
+/*  Allocator of memory blocks up to 64kB in size. The blocks are grouped into
+    size classes (powers of two) and freed blocks are cached by the thread that
+    has allocated them so that subsequent allocations in the same size class
+    don't have to use the system allocator. Blocks freed by other threads are
+    returned to the owner thread's cache via a lock-free list. */
+
+/*  Allocates a memory block of at least 'size' bytes. Returns NULL if
+    the block is too large to be handled by the allocator or if there's
+    not enough memory. */
+void *nn_slab_alloc (size_t size);
+
+/*  Deallocates the block. This function can be called from any thread. */
+void nn_slab_free (void *p);
+
+#endif
+
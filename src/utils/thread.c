@@ -22,6 +22,18 @@
 
 #include "thread.h"
 
+/*  Mixes the bits of thread ID so that even IDs differing only in few bits
+    produce hashes that are well distributed. */
+static uint32_t nn_thread_mix (uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
 #ifdef NN_HAVE_WINDOWS
 #include "thread_win.inc"
 #else
@@ -25,6 +25,8 @@
 
 /*  Platform independent implementation of threading. */
 
+#include <stdint.h>
+
 typedef void (nn_thread_routine) (void*);
 
 #if defined NN_HAVE_WINDOWS
@@ -37,5 +39,10 @@ void nn_thread_init (struct nn_thread *self,
     nn_thread_routine *routine, void *arg);
 void nn_thread_term (struct nn_thread *self);
 
+/*  Returns a hash of the identity of the calling thread. It doesn't change
+    during the lifetime of the thread. Any thread can call it, not only
+    the ones created using nn_thread_init(). */
+uint32_t nn_thread_hash (void);
+
 #endif
 
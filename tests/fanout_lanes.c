@@ -0,0 +1,234 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "../src/nn.h"
+#include "../src/fanout.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/thread.c"
+
+#if defined NN_HAVE_WINDOWS
+#include "../src/utils/win.h"
+#else
+#include <sys/select.h>
+#endif
+
+/*  Tests PUSH socket with multiple send lanes used by several threads
+    at the same time. */
+
+#define LANES 4
+#define THREADS 8
+#define MESSAGES 100
+
+static const char *addrs [LANES] = {
+    "tcp://127.0.0.1:5559",
+    "tcp://127.0.0.1:5560",
+    "tcp://127.0.0.1:5561",
+    "tcp://127.0.0.1:5562"
+};
+
+static void sender (void *arg)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i != MESSAGES; ++i) {
+        rc = nn_send (*(int*) arg, "ABC", 3, 0);
+        errno_assert (rc >= 0);
+        nn_assert (rc == 3);
+    }
+}
+
+/*  Returns 1 if NN_SNDFD of the socket becomes signalled within
+    the timeout. */
+static int writeable (int s, int timeout)
+{
+    int rc;
+#if defined NN_HAVE_WINDOWS
+    SOCKET fd;
+#else
+    int fd;
+#endif
+    size_t fdsz;
+    fd_set pollset;
+    struct timeval tv;
+
+    fdsz = sizeof (fd);
+    rc = nn_getsockopt (s, NN_SOL_SOCKET, NN_SNDFD, &fd, &fdsz);
+    errno_assert (rc == 0);
+    nn_assert (fdsz == sizeof (fd));
+    FD_ZERO (&pollset);
+    FD_SET (fd, &pollset);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    rc = select ((int) fd + 1, &pollset, NULL, NULL, &tv);
+    errno_assert (rc >= 0);
+    return rc;
+}
+
+int main ()
+{
+    int rc;
+    int push;
+    int pull;
+    int pulls [LANES];
+    int push2;
+    int eids [LANES];
+    int i;
+    int opt;
+    size_t sz;
+    int received;
+    char buf [3];
+    struct nn_thread threads [THREADS];
+
+    for (i = 0; i != LANES; ++i) {
+        pulls [i] = nn_socket (AF_SP, NN_PULL);
+        errno_assert (pulls [i] != -1);
+        rc = nn_bind (pulls [i], addrs [i]);
+        errno_assert (rc >= 0);
+    }
+
+    /*  Only socket types that load-balance the messages support lanes. */
+    opt = LANES;
+    rc = nn_setsockopt (pulls [0], NN_SOL_SOCKET, NN_SNDLANES, &opt,
+        sizeof (opt));
+    nn_assert (rc == -1 && nn_errno () == ENOPROTOOPT);
+
+    push = nn_socket (AF_SP, NN_PUSH);
+    errno_assert (push != -1);
+    opt = 0;
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_SNDLANES, &opt, sizeof (opt));
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    opt = LANES;
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_SNDLANES, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    sz = sizeof (opt);
+    rc = nn_getsockopt (push, NN_SOL_SOCKET, NN_SNDLANES, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (opt));
+    nn_assert (opt == LANES);
+
+    /*  Lanes can't be changed once they were created. */
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_SNDLANES, &opt, sizeof (opt));
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+
+    /*  Options are applied to all the lanes. */
+    opt = 100;
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_LINGER, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+
+    /*  Each lane gets one of the peers. */
+    for (i = 0; i != LANES; ++i) {
+        eids [i] = nn_connect (push, addrs [i]);
+        errno_assert (eids [i] >= 0);
+    }
+
+    /*  Lanes can't be created once there are endpoints. */
+    push2 = nn_socket (AF_SP, NN_PUSH);
+    errno_assert (push2 != -1);
+    rc = nn_bind (push2, "tcp://127.0.0.1:5563");
+    errno_assert (rc >= 0);
+    opt = LANES;
+    rc = nn_setsockopt (push2, NN_SOL_SOCKET, NN_SNDLANES, &opt, sizeof (opt));
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+    rc = nn_close (push2);
+    errno_assert (rc == 0);
+
+    /*  Send from many threads at once. All the messages arrive. */
+    for (i = 0; i != THREADS; ++i)
+        nn_thread_init (&threads [i], sender, &push);
+    opt = 1000;
+    for (i = 0; i != LANES; ++i) {
+        rc = nn_setsockopt (pulls [i], NN_SOL_SOCKET, NN_RCVTIMEO, &opt,
+            sizeof (opt));
+        errno_assert (rc == 0);
+    }
+    received = 0;
+    while (received != THREADS * MESSAGES) {
+        for (i = 0; i != LANES; ++i) {
+            rc = nn_recv (pulls [i], buf, sizeof (buf), NN_DONTWAIT);
+            if (rc < 0) {
+                errno_assert (nn_errno () == EAGAIN);
+                continue;
+            }
+            nn_assert (rc == 3);
+            ++received;
+        }
+    }
+    for (i = 0; i != THREADS; ++i)
+        nn_thread_term (&threads [i]);
+
+    /*  Endpoints can be removed from any of the lanes. */
+    for (i = 0; i != LANES; ++i) {
+        rc = nn_shutdown (push, eids [i]);
+        errno_assert (rc == 0);
+    }
+    rc = nn_shutdown (push, eids [LANES - 1] + 1);
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+
+    rc = nn_close (push);
+    errno_assert (rc == 0);
+    for (i = 0; i != LANES; ++i) {
+        rc = nn_close (pulls [i]);
+        errno_assert (rc == 0);
+    }
+
+    /*  Binding is not supported with multiple lanes. With a single peer,
+        only the first lane is connected. Threads whose lane has no peers
+        fall back to the lanes that do, and NN_SNDFD reports the socket as
+        writeable if any of the lanes is. */
+    push = nn_socket (AF_SP, NN_PUSH);
+    errno_assert (push != -1);
+    opt = LANES;
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_SNDLANES, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    opt = 1000;
+    rc = nn_setsockopt (push, NN_SOL_SOCKET, NN_SNDTIMEO, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    rc = nn_bind (push, "tcp://127.0.0.1:5566");
+    nn_assert (rc == -1 && nn_errno () == ENOTSUP);
+    rc = nn_connect (push, "tcp://127.0.0.1:5566");
+    errno_assert (rc >= 0);
+    nn_assert (!writeable (push, 0));
+    rc = nn_send (push, "ABC", 3, NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EAGAIN);
+    pull = nn_socket (AF_SP, NN_PULL);
+    errno_assert (pull != -1);
+    rc = nn_bind (pull, "tcp://127.0.0.1:5566");
+    errno_assert (rc >= 0);
+    nn_assert (writeable (push, 1000));
+    for (i = 0; i != THREADS; ++i)
+        nn_thread_init (&threads [i], sender, &push);
+    for (i = 0; i != THREADS * MESSAGES; ++i) {
+        rc = nn_recv (pull, buf, sizeof (buf), 0);
+        errno_assert (rc == 3);
+    }
+    for (i = 0; i != THREADS; ++i)
+        nn_thread_term (&threads [i]);
+
+    rc = nn_close (pull);
+    errno_assert (rc == 0);
+    rc = nn_close (push);
+    errno_assert (rc == 0);
+
+    return 0;
+}
+
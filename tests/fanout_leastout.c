@@ -0,0 +1,116 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/fanout.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/sleep.c"
+
+/*  Tests PUSH socket sending to the peer with the fewest outstanding
+    messages. */
+
+#define MESSAGES 100
+
+int main ()
+{
+    int rc;
+    int push;
+    int slow;
+    int fast;
+    int opt;
+    size_t sz;
+    int i;
+    int received;
+    char buf [3];
+
+    /*  Check the options. */
+    push = nn_socket (AF_SP, NN_PUSH);
+    errno_assert (push != -1);
+    sz = sizeof (opt);
+    rc = nn_getsockopt (push, NN_PUSH, NN_PUSH_LEASTOUT, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (opt));
+    nn_assert (opt == 0);
+    opt = 2;
+    rc = nn_setsockopt (push, NN_PUSH, NN_PUSH_LEASTOUT, &opt, sizeof (opt));
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    opt = 1;
+    rc = nn_setsockopt (push, NN_PUSH, NN_PUSH_LEASTOUT, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    sz = sizeof (opt);
+    rc = nn_getsockopt (push, NN_PUSH, NN_PUSH_LEASTOUT, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (opt == 1);
+
+    slow = nn_socket (AF_SP, NN_PULL);
+    errno_assert (slow != -1);
+    fast = nn_socket (AF_SP, NN_PULL);
+    errno_assert (fast != -1);
+    opt = 1;
+    rc = nn_setsockopt (slow, NN_PULL, NN_PULL_ACK, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (fast, NN_PULL, NN_PULL_ACK, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    sz = sizeof (opt);
+    rc = nn_getsockopt (fast, NN_PULL, NN_PULL_ACK, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (opt == 1);
+    rc = nn_bind (slow, "tcp://127.0.0.1:5564");
+    errno_assert (rc >= 0);
+    rc = nn_bind (fast, "tcp://127.0.0.1:5565");
+    errno_assert (rc >= 0);
+    rc = nn_connect (push, "tcp://127.0.0.1:5564");
+    errno_assert (rc >= 0);
+    rc = nn_connect (push, "tcp://127.0.0.1:5565");
+    errno_assert (rc >= 0);
+    nn_sleep (100);
+
+    /*  The slow peer doesn't process any messages, so nearly all of them
+        should be sent to the fast one. */
+    opt = 100;
+    rc = nn_setsockopt (fast, NN_SOL_SOCKET, NN_RCVTIMEO, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    received = 0;
+    for (i = 0; i != MESSAGES; ++i) {
+        rc = nn_send (push, "ABC", 3, 0);
+        errno_assert (rc == 3);
+        rc = nn_recv (fast, buf, sizeof (buf), 0);
+        if (rc < 0) {
+            errno_assert (nn_errno () == EAGAIN);
+            continue;
+        }
+        nn_assert (rc == 3);
+        ++received;
+    }
+    nn_assert (received > MESSAGES * 9 / 10);
+
+    rc = nn_close (push);
+    errno_assert (rc == 0);
+    rc = nn_close (fast);
+    errno_assert (rc == 0);
+    rc = nn_close (slow);
+    errno_assert (rc == 0);
+
+    return 0;
+}
+
@@ -42,17 +42,24 @@ int main ()
             item5000 = item;
         nn_hash_item_init (item);
         nn_hash_insert (&hash, k, item);
+
+        /*  Check that items can be found while the table is being resized. */
+        nn_assert (nn_hash_get (&hash, k / 2)->key == k / 2);
     }
 
     /*  Find one element and check whether it is the correct one. */
     nn_assert (nn_hash_get (&hash, 5000) == item5000);
 
+    nn_assert (nn_hash_get (&hash, 10000) == NULL);
+
     /*  Remove all the elements from the hash table and terminate it. */
     for (k = 0; k != 10000; ++k) {
         item = nn_hash_get (&hash, k);
         nn_hash_erase (&hash, item);
+        nn_assert (nn_hash_get (&hash, k) == NULL);
         nn_free (item);
     }
+    nn_assert (hash.items == 0);
     nn_hash_term (&hash);
 
     return 0;
@@ -0,0 +1,139 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/pair.h"
+
+#include "../src/utils/err.c"
+
+#include <string.h>
+
+#define SOCKET_ADDRESS "tcp://127.0.0.1:5555"
+
+#define MSG_COUNT 100
+
+int main ()
+{
+    int rc;
+    int sb;
+    int sc;
+    int i;
+    int done;
+    unsigned char data [MSG_COUNT];
+    unsigned char buf [MSG_COUNT][4];
+    void *chunks [2];
+    struct nn_iovec iov [MSG_COUNT];
+    struct nn_mmsghdr hdrs [MSG_COUNT];
+
+    sb = nn_socket (AF_SP, NN_PAIR);
+    errno_assert (sb != -1);
+    rc = nn_bind (sb, SOCKET_ADDRESS);
+    errno_assert (rc >= 0);
+    sc = nn_socket (AF_SP, NN_PAIR);
+    errno_assert (sc != -1);
+    rc = nn_connect (sc, SOCKET_ADDRESS);
+    errno_assert (rc >= 0);
+
+    /*  Empty message vector. */
+    rc = nn_sendmmsg (sc, hdrs, 0, 0);
+    errno_assert (rc == 0);
+    rc = nn_recvmmsg (sb, hdrs, -1, 0);
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+
+    /*  Nothing to receive. */
+    memset (hdrs, 0, sizeof (hdrs));
+    iov [0].iov_base = buf [0];
+    iov [0].iov_len = sizeof (buf [0]);
+    hdrs [0].msg_hdr.msg_iov = iov;
+    hdrs [0].msg_hdr.msg_iovlen = 1;
+    rc = nn_recvmmsg (sb, hdrs, 1, NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EAGAIN);
+
+    /*  Send a burst of messages. Each call may send only some of them. */
+    memset (hdrs, 0, sizeof (hdrs));
+    for (i = 0; i != MSG_COUNT; ++i) {
+        data [i] = (unsigned char) i;
+        iov [i].iov_base = &data [i];
+        iov [i].iov_len = 1;
+        hdrs [i].msg_hdr.msg_iov = &iov [i];
+        hdrs [i].msg_hdr.msg_iovlen = 1;
+    }
+    for (done = 0; done != MSG_COUNT; done += rc) {
+        rc = nn_sendmmsg (sc, hdrs + done, MSG_COUNT - done, 0);
+        errno_assert (rc > 0);
+    }
+    for (i = 0; i != MSG_COUNT; ++i)
+        nn_assert (hdrs [i].msg_len == 1);
+
+    /*  Receive them in batches. */
+    memset (hdrs, 0, sizeof (hdrs));
+    for (i = 0; i != MSG_COUNT; ++i) {
+        iov [i].iov_base = buf [i];
+        iov [i].iov_len = sizeof (buf [i]);
+        hdrs [i].msg_hdr.msg_iov = &iov [i];
+        hdrs [i].msg_hdr.msg_iovlen = 1;
+    }
+    for (done = 0; done != MSG_COUNT; done += rc) {
+        rc = nn_recvmmsg (sb, hdrs + done, MSG_COUNT - done, 0);
+        errno_assert (rc > 0);
+    }
+    for (i = 0; i != MSG_COUNT; ++i) {
+        nn_assert (hdrs [i].msg_len == 1);
+        nn_assert (buf [i][0] == (unsigned char) i);
+    }
+
+    /*  Zero-copy messages. */
+    memset (hdrs, 0, sizeof (hdrs));
+    for (i = 0; i != 2; ++i) {
+        chunks [i] = nn_allocmsg (3, 0);
+        errno_assert (chunks [i]);
+        memcpy (chunks [i], i ? "DEF" : "ABC", 3);
+        iov [i].iov_base = &chunks [i];
+        iov [i].iov_len = NN_MSG;
+        hdrs [i].msg_hdr.msg_iov = &iov [i];
+        hdrs [i].msg_hdr.msg_iovlen = 1;
+    }
+    rc = nn_sendmmsg (sc, hdrs, 2, 0);
+    errno_assert (rc >= 1);
+    if (rc == 1) {
+        rc = nn_sendmmsg (sc, hdrs + 1, 1, 0);
+        errno_assert (rc == 1);
+    }
+    chunks [0] = chunks [1] = NULL;
+    for (done = 0; done != 2; done += rc) {
+        rc = nn_recvmmsg (sb, hdrs + done, 2 - done, 0);
+        errno_assert (rc > 0);
+    }
+    for (i = 0; i != 2; ++i) {
+        nn_assert (hdrs [i].msg_len == 3);
+        nn_assert (memcmp (chunks [i], i ? "DEF" : "ABC", 3) == 0);
+        rc = nn_freemsg (chunks [i]);
+        errno_assert (rc == 0);
+    }
+
+    rc = nn_close (sc);
+    errno_assert (rc == 0);
+    rc = nn_close (sb);
+    errno_assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/mutex.c"
+#include "../src/utils/atomic.c"
+#include "../src/utils/glock.c"
+#include "../src/utils/sem.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/wire.c"
+#include "../src/utils/slab.c"
+#include "../src/utils/chunk.c"
+#include "../src/utils/chunkref.c"
+#include "../src/utils/msg.c"
+#include "../src/transports/inproc/msgring.c"
+
+#include <string.h>
+
+#define MSG_COUNT 100000
+
+static struct nn_msgring ring;
+static struct nn_sem readable;
+static struct nn_sem writable;
+
+static void writer (void *arg)
+{
+    int rc;
+    int i;
+    struct nn_msg msg;
+
+    for (i = 0; i != MSG_COUNT; ++i) {
+        nn_msg_init (&msg, sizeof (i));
+        memcpy (nn_chunkref_data (&msg.body), &i, sizeof (i));
+        while (1) {
+            rc = nn_msgring_write (&ring, &msg);
+            if (rc == 0)
+                break;
+            errnum_assert (rc == -EAGAIN, -rc);
+            if (!nn_msgring_flush (&ring))
+                nn_sem_post (&readable);
+            nn_sem_wait (&writable);
+        }
+        if (i % 7 == 0 || i == MSG_COUNT - 1) {
+            if (!nn_msgring_flush (&ring))
+                nn_sem_post (&readable);
+        }
+    }
+}
+
+int main ()
+{
+    int rc;
+    int i;
+    int val;
+    struct nn_msg msg;
+    struct nn_thread thread;
+
+    /*  Full ring refuses further messages. */
+    nn_msgring_init (&ring, 4);
+    for (i = 0; i != 4; ++i) {
+        nn_msg_init (&msg, 10);
+        rc = nn_msgring_write (&ring, &msg);
+        errnum_assert (rc == 0, -rc);
+    }
+    nn_msg_init (&msg, 10);
+    rc = nn_msgring_write (&ring, &msg);
+    nn_assert (rc == -EAGAIN);
+    nn_msg_term (&msg);
+
+    /*  Messages are not visible till they are flushed. The reader is asleep
+        at the beginning so it has to be woken up. */
+    rc = nn_msgring_read (&ring, &msg);
+    nn_assert (rc == -EAGAIN);
+    nn_assert (nn_msgring_flush (&ring) == 0);
+    nn_assert (nn_msgring_flush (&ring) == 1);
+    for (i = 0; i != 4; ++i) {
+        rc = nn_msgring_read (&ring, &msg);
+        errnum_assert (rc == 0, -rc);
+        nn_assert (nn_chunkref_size (&msg.body) == 10);
+        nn_msg_term (&msg);
+    }
+    rc = nn_msgring_read (&ring, &msg);
+    nn_assert (rc == -EAGAIN);
+
+    /*  Once the reader has run out of messages the slots can be reused. */
+    for (i = 0; i != 3; ++i) {
+        nn_msg_init (&msg, 10);
+        rc = nn_msgring_write (&ring, &msg);
+        errnum_assert (rc == 0, -rc);
+    }
+    nn_assert (nn_msgring_flush (&ring) == 0);
+
+    /*  Unread messages are deallocated with the ring. */
+    nn_msgring_term (&ring);
+
+    /*  Pass messages between two threads and check they arrive in order. */
+    nn_sem_init (&readable);
+    nn_sem_init (&writable);
+    nn_msgring_init (&ring, 64);
+    nn_thread_init (&thread, writer, NULL);
+    for (i = 0; i != MSG_COUNT;) {
+        rc = nn_msgring_read (&ring, &msg);
+        if (rc == -EAGAIN) {
+            nn_sem_post (&writable);
+            nn_sem_wait (&readable);
+            continue;
+        }
+        errnum_assert (rc == 0, -rc);
+        memcpy (&val, nn_chunkref_data (&msg.body), sizeof (val));
+        nn_assert (val == i);
+        nn_msg_term (&msg);
+        ++i;
+    }
+    nn_thread_term (&thread);
+    nn_msgring_term (&ring);
+    nn_sem_term (&writable);
+    nn_sem_term (&readable);
+
+    return 0;
+}
+
@@ -0,0 +1,195 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/reqrep.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/wire.c"
+
+#include <string.h>
+
+/*  Tests REQ socket with multiple requests in progress. Replies are sent
+    from a raw REP socket so that they can be sent out of order. */
+
+#define SOCKET_ADDRESS "tcp://127.0.0.1:5557"
+
+#define WINDOW 4
+
+int main ()
+{
+    int rc;
+    int rep;
+    int req;
+    int i;
+    int opt;
+    int seen;
+    size_t sz;
+    int ids [WINDOW];
+    void *hdrs [WINDOW];
+    char bodies [WINDOW];
+    char buf [1];
+    void *hdr;
+    struct nn_iovec iov;
+    struct nn_msghdr msghdr;
+
+    rep = nn_socket (AF_SP_RAW, NN_REP);
+    errno_assert (rep != -1);
+    rc = nn_bind (rep, SOCKET_ADDRESS);
+    errno_assert (rc >= 0);
+    req = nn_socket (AF_SP, NN_REQ);
+    errno_assert (req != -1);
+
+    /*  Check the option. */
+    sz = sizeof (opt);
+    rc = nn_getsockopt (req, NN_REQ, NN_REQ_WINDOW, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (opt) && opt == 1);
+    opt = 0;
+    rc = nn_setsockopt (req, NN_REQ, NN_REQ_WINDOW, &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    opt = WINDOW;
+    rc = nn_setsockopt (req, NN_REQ, NN_REQ_WINDOW, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    sz = sizeof (opt);
+    rc = nn_getsockopt (req, NN_REQ, NN_REQ_WINDOW, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (opt == WINDOW);
+
+    rc = nn_connect (req, SOCKET_ADDRESS);
+    errno_assert (rc >= 0);
+
+    /*  No request was sent. */
+    rc = nn_recv (req, buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EFSM);
+
+    /*  Fill in the window. Further requests are not accepted. */
+    for (i = 0; i != WINDOW; ++i) {
+        buf [0] = 'A' + i;
+        rc = nn_send (req, buf, 1, 0);
+        errno_assert (rc == 1);
+        sz = sizeof (ids [i]);
+        rc = nn_getsockopt (req, NN_REQ, NN_REQ_ID, &ids [i], &sz);
+        errno_assert (rc == 0);
+        if (i > 0)
+            nn_assert (ids [i] != ids [i - 1]);
+    }
+    rc = nn_send (req, "X", 1, NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EAGAIN);
+
+    /*  The window can't be changed while the requests are in progress. */
+    opt = 2;
+    rc = nn_setsockopt (req, NN_REQ, NN_REQ_WINDOW, &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EFSM);
+
+    /*  Receive all the requests. */
+    for (i = 0; i != WINDOW; ++i) {
+        iov.iov_base = &bodies [i];
+        iov.iov_len = 1;
+        memset (&msghdr, 0, sizeof (msghdr));
+        msghdr.msg_iov = &iov;
+        msghdr.msg_iovlen = 1;
+        msghdr.msg_control = &hdrs [i];
+        msghdr.msg_controllen = NN_MSG;
+        rc = nn_recvmsg (rep, &msghdr, 0);
+        errno_assert (rc == 1);
+        nn_assert (bodies [i] == 'A' + i);
+    }
+
+    /*  Reply in reverse order. Second reply to the last request is
+        a duplicate and must be dropped. */
+    for (i = WINDOW - 1; i >= 0; --i) {
+        iov.iov_base = &bodies [i];
+        iov.iov_len = 1;
+        memset (&msghdr, 0, sizeof (msghdr));
+        msghdr.msg_iov = &iov;
+        msghdr.msg_iovlen = 1;
+        msghdr.msg_control = &hdrs [i];
+        msghdr.msg_controllen = NN_MSG;
+        if (i == WINDOW - 1) {
+
+            /*  The header consists of the peer ID and the request ID. */
+            hdr = nn_allocmsg (8, 0);
+            errno_assert (hdr);
+            memcpy (hdr, hdrs [i], 8);
+        }
+        rc = nn_sendmsg (rep, &msghdr, 0);
+        errno_assert (rc == 1);
+        if (i == WINDOW - 1) {
+            msghdr.msg_control = &hdr;
+            rc = nn_sendmsg (rep, &msghdr, 0);
+            errno_assert (rc == 1);
+        }
+    }
+
+    /*  Replies are delivered in the order they arrive and can be matched
+        with the requests using the request ID. */
+    for (i = WINDOW - 1; i >= 0; --i) {
+        iov.iov_base = buf;
+        iov.iov_len = 1;
+        memset (&msghdr, 0, sizeof (msghdr));
+        msghdr.msg_iov = &iov;
+        msghdr.msg_iovlen = 1;
+        msghdr.msg_control = &hdr;
+        msghdr.msg_controllen = NN_MSG;
+        rc = nn_recvmsg (req, &msghdr, 0);
+        errno_assert (rc == 1);
+        nn_assert (buf [0] == 'A' + i);
+        nn_assert (nn_getl (hdr) == ((uint32_t) ids [i] | 0x80000000));
+        rc = nn_freemsg (hdr);
+        errno_assert (rc == 0);
+    }
+    rc = nn_recv (req, buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EFSM);
+
+    /*  Each request is re-sent independently. */
+    opt = 100;
+    rc = nn_setsockopt (req, NN_REQ, NN_REQ_RESEND_IVL, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    rc = nn_send (req, "A", 1, 0);
+    errno_assert (rc == 1);
+    rc = nn_send (req, "B", 1, 0);
+    errno_assert (rc == 1);
+    for (i = 0; i != 2; ++i) {
+        rc = nn_recv (rep, buf, sizeof (buf), 0);
+        errno_assert (rc == 1);
+        nn_assert (buf [0] == 'A' + i);
+    }
+
+    /*  The re-sends are triggered by independent timers and may thus
+        arrive in any order. */
+    seen = 0;
+    for (i = 0; i != 2; ++i) {
+        rc = nn_recv (rep, buf, sizeof (buf), 0);
+        errno_assert (rc == 1);
+        nn_assert (buf [0] == 'A' || buf [0] == 'B');
+        nn_assert (!(seen & (1 << (buf [0] - 'A'))));
+        seen |= 1 << (buf [0] - 'A');
+    }
+
+    rc = nn_close (req);
+    errno_assert (rc == 0);
+    rc = nn_close (rep);
+    errno_assert (rc == 0);
+
+    return 0;
+}
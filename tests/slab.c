@@ -0,0 +1,82 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/mutex.c"
+#include "../src/utils/atomic.c"
+#include "../src/utils/glock.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/slab.c"
+
+#include <string.h>
+
+#define BLOCK_COUNT 1000
+
+static void *blocks [BLOCK_COUNT];
+
+static void worker (void *arg)
+{
+    int i;
+
+    /*  Free the blocks allocated by the main thread. */
+    for (i = 0; i != BLOCK_COUNT; ++i)
+        nn_slab_free (blocks [i]);
+}
+
+int main ()
+{
+    int i;
+    void *p;
+    void *q;
+    struct nn_thread thread;
+
+    /*  Blocks that are too large are refused. */
+    nn_assert (nn_slab_alloc (1024 * 1024) == NULL);
+
+    /*  Freed block is reused by the next allocation in the same size class. */
+    p = nn_slab_alloc (100);
+    nn_assert (p);
+    memset (p, 0xaa, 100);
+    nn_slab_free (p);
+    q = nn_slab_alloc (90);
+    nn_assert (q == p);
+    nn_slab_free (q);
+
+    /*  Blocks freed by a different thread are returned to the owner. */
+    for (i = 0; i != BLOCK_COUNT; ++i) {
+        blocks [i] = nn_slab_alloc (i * 50);
+        nn_assert (blocks [i]);
+        memset (blocks [i], 0xbb, i * 50);
+    }
+    nn_thread_init (&thread, worker, NULL);
+    nn_thread_term (&thread);
+    for (i = 0; i != BLOCK_COUNT; ++i) {
+        blocks [i] = nn_slab_alloc (i * 50);
+        nn_assert (blocks [i]);
+    }
+    for (i = 0; i != BLOCK_COUNT; ++i)
+        nn_slab_free (blocks [i]);
+
+    return 0;
+}
+
@@ -0,0 +1,142 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/survey.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/sleep.c"
+#include "../src/utils/wire.c"
+
+#include <string.h>
+
+/*  Tests SURVEYOR socket with multiple surveys in progress. */
+
+#define SOCKET_ADDRESS "tcp://127.0.0.1:5558"
+
+#define WINDOW 2
+
+int main ()
+{
+    int rc;
+    int surveyor;
+    int respondent;
+    int i;
+    int opt;
+    size_t sz;
+    int ids [WINDOW + 1];
+    char buf [1];
+    void *hdr;
+    struct nn_iovec iov;
+    struct nn_msghdr msghdr;
+
+    surveyor = nn_socket (AF_SP, NN_SURVEYOR);
+    errno_assert (surveyor != -1);
+    opt = 500;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_DEADLINE,
+        &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    rc = nn_bind (surveyor, SOCKET_ADDRESS);
+    errno_assert (rc >= 0);
+    respondent = nn_socket (AF_SP, NN_RESPONDENT);
+    errno_assert (respondent != -1);
+    rc = nn_connect (respondent, SOCKET_ADDRESS);
+    errno_assert (rc >= 0);
+
+    /*  Check the option. */
+    sz = sizeof (opt);
+    rc = nn_getsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_WINDOW, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (opt) && opt == 1);
+    opt = 0;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_WINDOW,
+        &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    opt = WINDOW;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_WINDOW,
+        &opt, sizeof (opt));
+    errno_assert (rc == 0);
+
+    /*  No survey was started. */
+    rc = nn_recv (surveyor, buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EFSM);
+
+    /*  Wait till the respondent is connected. Surveys sent before that would
+        be dropped. */
+    nn_sleep (100);
+
+    /*  Start more surveys than the window allows. The oldest survey is
+        cancelled. */
+    for (i = 0; i != WINDOW + 1; ++i) {
+        buf [0] = 'A' + i;
+        rc = nn_send (surveyor, buf, 1, 0);
+        errno_assert (rc == 1);
+        sz = sizeof (ids [i]);
+        rc = nn_getsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_ID,
+            &ids [i], &sz);
+        errno_assert (rc == 0);
+    }
+
+    /*  The window can't be changed while the surveys are in progress. */
+    opt = 3;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_WINDOW,
+        &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EFSM);
+
+    /*  Respond to all the surveys. */
+    for (i = 0; i != WINDOW + 1; ++i) {
+        rc = nn_recv (respondent, buf, sizeof (buf), 0);
+        errno_assert (rc == 1);
+        nn_assert (buf [0] == 'A' + i);
+        rc = nn_send (respondent, buf, 1, 0);
+        errno_assert (rc == 1);
+    }
+
+    /*  Only the responses to the surveys still in progress are delivered.
+        They can be matched with the surveys using the survey ID. */
+    for (i = 1; i != WINDOW + 1; ++i) {
+        iov.iov_base = buf;
+        iov.iov_len = 1;
+        memset (&msghdr, 0, sizeof (msghdr));
+        msghdr.msg_iov = &iov;
+        msghdr.msg_iovlen = 1;
+        msghdr.msg_control = &hdr;
+        msghdr.msg_controllen = NN_MSG;
+        rc = nn_recvmsg (surveyor, &msghdr, 0);
+        errno_assert (rc == 1);
+        nn_assert (buf [0] == 'A' + i);
+        nn_assert (nn_getl (hdr) == (uint32_t) ids [i]);
+        rc = nn_freemsg (hdr);
+        errno_assert (rc == 0);
+    }
+
+    /*  All the surveys hit the deadline. */
+    rc = nn_recv (surveyor, buf, sizeof (buf), 0);
+    nn_assert (rc < 0 && nn_errno () == EFSM);
+
+    rc = nn_close (respondent);
+    errno_assert (rc == 0);
+    rc = nn_close (surveyor);
+    errno_assert (rc == 0);
+
+    return 0;
+}
@@ -28,10 +28,23 @@
 #include "../src/utils/err.c"
 #include "../src/utils/sleep.c"
 
+#include <stdint.h>
+#include <string.h>
+
 /*  Tests TCP transport. */
 
 #define SOCKET_ADDRESS "tcp://127.0.0.1:5555"
 
+static char wrapped [100000];
+static volatile int wrapped_freed = 0;
+
+static void wrapped_free (void *buf, void *hint)
+{
+    nn_assert (buf == wrapped);
+    nn_assert (hint == &wrapped_freed);
+    wrapped_freed = 1;
+}
+
 int main ()
 {
     int rc;
@@ -41,6 +54,11 @@ int main ()
     char buf [3];
     int opt;
     size_t sz;
+    uint64_t copied;
+    uint64_t copied2;
+    uint64_t efdcalls;
+    uint64_t efdcalls2;
+    void *msg;
 
     /*  Try closing bound but unconnected socket. */
     sb = nn_socket (AF_SP, NN_PAIR);
@@ -136,6 +154,10 @@ int main ()
     }
 
     /*  Batch transfer test. */
+    sz = sizeof (efdcalls);
+    rc = nn_getsockopt (sc, NN_SOL_SOCKET, NN_EFDCALLS, &efdcalls, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (efdcalls));
     for (i = 0; i != 100; ++i) {
         rc = nn_send (sc, "0123456789012345678901234567890123456789", 40, 0);
         errno_assert (rc >= 0);
@@ -147,6 +169,74 @@ int main ()
         nn_assert (rc == 40);
     }
 
+    /*  The efds are not signalled and unsignalled for each message. */
+    rc = nn_getsockopt (sc, NN_SOL_SOCKET, NN_EFDCALLS, &efdcalls2, &sz);
+    errno_assert (rc == 0);
+    nn_assert (efdcalls2 - efdcalls < 100);
+
+    /*  Large messages received using NN_MSG are not copied, except for
+        the beginning that may have been read along with the message header. */
+    sz = sizeof (copied);
+    rc = nn_getsockopt (sb, NN_SOL_SOCKET, NN_RCVCOPIED, &copied, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (copied));
+    msg = nn_allocmsg (1000000, 0);
+    errno_assert (msg);
+    memset (msg, 'A', 1000000);
+    rc = nn_send (sc, &msg, NN_MSG, 0);
+    errno_assert (rc == 1000000);
+    rc = nn_recv (sb, &msg, NN_MSG, 0);
+    errno_assert (rc == 1000000);
+    nn_assert (((char*) msg) [999999] == 'A');
+    rc = nn_freemsg (msg);
+    errno_assert (rc == 0);
+    sz = sizeof (copied2);
+    rc = nn_getsockopt (sb, NN_SOL_SOCKET, NN_RCVCOPIED, &copied2, &sz);
+    errno_assert (rc == 0);
+    nn_assert (copied2 - copied < 100000);
+
+    /*  Send a message wrapped around user's buffer. */
+    memset (wrapped, 'B', sizeof (wrapped));
+    msg = nn_wrapmsg (wrapped, sizeof (wrapped), wrapped_free,
+        (void*) &wrapped_freed);
+    errno_assert (msg);
+    rc = nn_send (sc, &msg, NN_MSG, 0);
+    errno_assert (rc == sizeof (wrapped));
+    rc = nn_recv (sb, &msg, NN_MSG, 0);
+    errno_assert (rc == sizeof (wrapped));
+    nn_assert (((char*) msg) [sizeof (wrapped) - 1] == 'B');
+    rc = nn_freemsg (msg);
+    errno_assert (rc == 0);
+    for (i = 0; i != 100 && !wrapped_freed; ++i)
+        nn_sleep (10);
+    nn_assert (wrapped_freed);
+
+    /*  Ping-pong with busy polling. */
+    opt = -1;
+    rc = nn_setsockopt (sb, NN_SOL_SOCKET, NN_BUSY_POLL, &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    opt = 2000000;
+    rc = nn_setsockopt (sb, NN_SOL_SOCKET, NN_BUSY_POLL, &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    opt = 50;
+    rc = nn_setsockopt (sb, NN_SOL_SOCKET, NN_BUSY_POLL, &opt, sizeof (opt));
+    errno_assert (rc == 0);
+    opt = 0;
+    sz = sizeof (opt);
+    rc = nn_getsockopt (sb, NN_SOL_SOCKET, NN_BUSY_POLL, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (opt) && opt == 50);
+    for (i = 0; i != 100; ++i) {
+        rc = nn_send (sc, "ABC", 3, 0);
+        errno_assert (rc == 3);
+        rc = nn_recv (sb, buf, sizeof (buf), 0);
+        errno_assert (rc == 3);
+        rc = nn_send (sb, "DEF", 3, 0);
+        errno_assert (rc == 3);
+        rc = nn_recv (sc, buf, sizeof (buf), 0);
+        errno_assert (rc == 3);
+    }
+
     rc = nn_close (sc);
     errno_assert (rc == 0);
     rc = nn_close (sb);
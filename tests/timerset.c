@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2013 250bpm s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+
+#include "../src/utils/err.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/clock.c"
+#include "../src/utils/sleep.c"
+#include "../src/aio/timerset.c"
+
+#define TIMER_COUNT 1000
+
+int main ()
+{
+    int rc;
+    int i;
+    int count;
+    uint64_t last;
+    struct nn_timerset timerset;
+    struct nn_timerset_hndl hndls [TIMER_COUNT];
+    struct nn_timerset_hndl *hndl;
+
+    nn_timerset_init (&timerset);
+    nn_assert (nn_timerset_timeout (&timerset) == -1);
+
+    /*  Add timers in scrambled order. */
+    for (i = 0; i != TIMER_COUNT; ++i) {
+        nn_timerset_hndl_init (&hndls [i]);
+        nn_timerset_add (&timerset, (i * 7919) % 50, &hndls [i]);
+        nn_assert (nn_timerset_hndl_isactive (&hndls [i]));
+    }
+
+    /*  Remove every third of them. */
+    for (i = 0; i < TIMER_COUNT; i += 3) {
+        nn_timerset_rm (&timerset, &hndls [i]);
+        nn_assert (!nn_timerset_hndl_isactive (&hndls [i]));
+    }
+    nn_assert (nn_timerset_timeout (&timerset) <= 50);
+
+    /*  Wait till all of them expire and check they are reported in order. */
+    nn_sleep (100);
+    nn_assert (nn_timerset_timeout (&timerset) == 0);
+    count = 0;
+    last = 0;
+    while (1) {
+        rc = nn_timerset_event (&timerset, &hndl);
+        if (rc == -EAGAIN)
+            break;
+        errnum_assert (rc == 0, -rc);
+        nn_assert (hndl->timeout >= last);
+        nn_assert (!nn_timerset_hndl_isactive (hndl));
+        last = hndl->timeout;
+        ++count;
+    }
+    nn_assert (count == TIMER_COUNT - (TIMER_COUNT + 2) / 3);
+    nn_assert (nn_timerset_timeout (&timerset) == -1);
+
+    /*  Timers with the same expiry time are reported in FIFO order. */
+    nn_timerset_add (&timerset, 1000, &hndls [0]);
+    nn_timerset_add (&timerset, 0, &hndls [1]);
+    nn_timerset_add (&timerset, 0, &hndls [2]);
+    nn_timerset_add (&timerset, 0, &hndls [3]);
+    rc = nn_timerset_event (&timerset, &hndl);
+    nn_assert (rc == 0 && hndl == &hndls [1]);
+    rc = nn_timerset_event (&timerset, &hndl);
+    nn_assert (rc == 0 && hndl == &hndls [2]);
+    rc = nn_timerset_event (&timerset, &hndl);
+    nn_assert (rc == 0 && hndl == &hndls [3]);
+    rc = nn_timerset_event (&timerset, &hndl);
+    nn_assert (rc == -EAGAIN);
+    nn_assert (nn_timerset_rm (&timerset, &hndls [0]) == 1);
+
+    for (i = 0; i != TIMER_COUNT; ++i)
+        nn_timerset_hndl_term (&hndls [i]);
+    nn_timerset_term (&timerset);
+
+    return 0;
+}
+
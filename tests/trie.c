@@ -27,6 +27,10 @@
 int main ()
 {
     int rc;
+    int i;
+    int results [3];
+    const uint8_t *data [3];
+    size_t sizes [3];
     struct nn_trie trie;
 
     /*  Try matching with an empty trie. */
@@ -203,6 +207,50 @@ int main ()
     nn_assert (rc == 1);
     nn_trie_term (&trie);
 
+    /*  Match enough times for the flat copy of the trie to be used and
+        check that it's invalidated by the modifications of the trie. */
+    nn_trie_init (&trie);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "ABCDEFGHIJKLMN", 14);
+    nn_assert (rc == 1);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "ABX", 3);
+    nn_assert (rc == 1);
+    for (i = 0; i != 10; ++i) {
+        rc = nn_trie_subscribe (&trie, (const uint8_t*) "0123456789" + i, 1);
+        nn_assert (rc == 1);
+    }
+    for (i = 0; i != 2000; ++i) {
+        rc = nn_trie_match (&trie, (const uint8_t*) "ABCDEFGHIJKLMNOPQ", 17);
+        nn_assert (rc == 1);
+        rc = nn_trie_match (&trie, (const uint8_t*) "ABCDEFGHIJKLMXOPQ", 17);
+        nn_assert (rc == 0);
+        rc = nn_trie_match (&trie, (const uint8_t*) "ABXY", 4);
+        nn_assert (rc == 1);
+        rc = nn_trie_match (&trie, (const uint8_t*) "5", 1);
+        nn_assert (rc == 1);
+        rc = nn_trie_match (&trie, (const uint8_t*) "AB", 2);
+        nn_assert (rc == 0);
+    }
+    nn_assert (trie.flat_valid);
+    rc = nn_trie_unsubscribe (&trie, (const uint8_t*) "ABX", 3);
+    nn_assert (rc == 1);
+    rc = nn_trie_match (&trie, (const uint8_t*) "ABXY", 4);
+    nn_assert (rc == 0);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "AB", 2);
+    nn_assert (rc == 1);
+    rc = nn_trie_match (&trie, (const uint8_t*) "AB", 2);
+    nn_assert (rc == 1);
+
+    /*  Match several strings at once. */
+    data [0] = (const uint8_t*) "ABCDEFGHIJKLMN";
+    sizes [0] = 14;
+    data [1] = (const uint8_t*) "";
+    sizes [1] = 0;
+    data [2] = (const uint8_t*) "X";
+    sizes [2] = 1;
+    nn_trie_match_many (&trie, data, sizes, 3, results);
+    nn_assert (results [0] == 1 && results [1] == 0 && results [2] == 0);
+    nn_trie_term (&trie);
+
     return 0;
 }
 